@@ -0,0 +1,565 @@
+/*
+ *  Benchmarks of the render kernels and of the write path of the output engine.
+ *     pcmBench.out [kernels|engine] [name filter]
+ *  The kernel group measures the sample generation, shuffling, conversion and mixing loops in memory,
+ *  every SIMD variant supported by the CPU separately, and checks that all variants of the exact fixed point conversion
+ *  agree (the exit code is 1 if one doesn't). The engine group plays against the ALSA "null" device
+ *  and the "file" plugin, so the overhead of the write path is measured without being paced by a sound card.
+ *  Allocation counts are only collected by a debug build (bash buildIt.bash debug).
+ */
+
+#include "engine/pcmOutput.hpp"
+#include "engine/oscillator.hpp"
+#include "engine/sineTable.hpp"
+#include "engine/simdKernels.hpp"
+#include "engine/bitDepthConv.hpp"
+#include "engine/mixer.hpp"
+#include "engine/resampler.hpp"
+#include "engine/dspChain.hpp"
+#include "engine/frameRenderer.hpp"
+#include "engine/allocGuard.hpp"
+#include "engine/trace.hpp"
+#include "engine/channelMap.hpp"
+#include "engine/audioSource.hpp"
+#include "engine/signalCache.hpp"
+#include <math.h>
+#include <limits.h>
+#include <string.h>
+#include <array>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <functional>
+
+namespace bench
+{
+   const size_t   BLOCK_FRAMES = 1152;          /* one processing frame of the demos, 24 ms at 48 kHz */
+   const uint32_t SAMPLE_RATE = 48000;
+   const uint32_t CHANNELS = 2;
+   const double   MIN_RUN_SEC = 0.25;           /* every case is repeated at least this long */
+   const size_t   ENGINE_SECONDS = 60;          /* audio pushed through the engine per case */
+   const char*    FILE_DEVICE = "file:FILE=/tmp/pcmBench.raw,FORMAT=raw";
+
+   const char* _filter = nullptr;
+   volatile uint64_t _sink = 0;                 /* keeps the results of the loops alive */
+
+   void consume(const void* data, size_t bytes)
+   {
+      uint64_t v = 0;
+      memcpy(&v, data, std::min(bytes, sizeof(v)));
+      _sink = _sink + v;
+   }
+
+   /* calls body() - one call handles framesPerCall frames - until MIN_RUN_SEC passed, prints and returns ns/frame */
+   double run(const char* name, size_t framesPerCall, const std::function<void()>& body, size_t samplesPerFrame = CHANNELS)
+   {
+      if ((_filter != nullptr) && (strstr(name, _filter) == nullptr))
+      {
+         return 0.0;
+      }
+
+      body(); // warm-up: caches, page faults and the lazy kernel selection
+
+      const auto start = std::chrono::steady_clock::now();
+      std::chrono::duration<double> elapsed {};
+      size_t calls = 0;
+
+      do
+      {
+         body();
+         ++calls;
+         elapsed = std::chrono::steady_clock::now() - start;
+      } while (elapsed.count() < MIN_RUN_SEC);
+
+      const double frames = static_cast<double>(calls * framesPerCall);
+      const double nsPerFrame = (elapsed.count() * 1e9) / frames;
+      const double samplesPerSec = (frames * samplesPerFrame) / elapsed.count();
+
+      printf("%-40s %10.2f ns/frame %12.1f Msamples/s\n", name, nsPerFrame, samplesPerSec / 1e6);
+      return nsPerFrame;
+   }
+
+   void sineGeneration()
+   {
+      std::vector<int16_t> out(BLOCK_FRAMES);
+      const double increment = (1000.0 / SAMPLE_RATE) * 2.0 * M_PI;
+      double angle = 0.0;
+
+      run("sine libm sin()", BLOCK_FRAMES, [&]()
+      {
+         for (size_t i = 0; i < BLOCK_FRAMES; ++i)
+         {
+            out[i] = static_cast<int16_t>(SHRT_MAX * sin(angle));
+            angle += increment;
+         }
+         consume(out.data(), out.size() * sizeof(int16_t));
+      }, 1);
+
+      static constexpr auto table = audio::SineTable<int16_t, SAMPLE_RATE, 1000>::make();
+      size_t pos = 0;
+
+      run("sine 1 kHz table loop", BLOCK_FRAMES, [&]()
+      {
+         for (size_t i = 0; i < BLOCK_FRAMES; ++i)
+         {
+            out[i] = table[pos];
+            pos = (pos + 1 == table.size()) ? 0 : pos + 1;
+         }
+         consume(out.data(), out.size() * sizeof(int16_t));
+      }, 1);
+
+      audio::WavetableOscillator oscillator(1000.0, SAMPLE_RATE);
+
+      run("sine phase accumulator (oscillator)", BLOCK_FRAMES, [&]()
+      {
+         oscillator.render(out.data(), BLOCK_FRAMES);
+         consume(out.data(), out.size() * sizeof(int16_t));
+      }, 1);
+   }
+
+   void shufflingKernels()
+   {
+      std::vector<int16_t> mono(BLOCK_FRAMES, 1234);
+      std::vector<uint16_t> stereo16(BLOCK_FRAMES * CHANNELS, 1234);
+      std::vector<uint32_t> stereo32(BLOCK_FRAMES * CHANNELS, 123456);
+      std::vector<int16_t> out16(BLOCK_FRAMES * CHANNELS);
+      std::vector<int32_t> in24(BLOCK_FRAMES * CHANNELS, 0x123456);
+      const int16_t* planes[CHANNELS] { mono.data(), mono.data() };
+      const int16_t* planes8[8] { mono.data(), mono.data(), mono.data(), mono.data(),
+                                  mono.data(), mono.data(), mono.data(), mono.data() };
+      std::vector<int16_t> out8(BLOCK_FRAMES * 8);
+      char name[64];
+
+      for (auto isa : { audio::kernels::Isa::Scalar, audio::kernels::Isa::Sse2, audio::kernels::Isa::Avx2, audio::kernels::Isa::Neon })
+      {
+         const auto* k = audio::kernels::forIsa(isa);
+         if (k == nullptr)
+         {
+            continue;
+         }
+
+         snprintf(name, sizeof(name), "fan-out 1->2 s16 [%s]", k->name);
+         run(name, BLOCK_FRAMES, [&]() { k->fanOut16(mono.data(), out16.data(), BLOCK_FRAMES, CHANNELS); consume(out16.data(), 8); });
+
+         snprintf(name, sizeof(name), "interleave 2ch s16 [%s]", k->name);
+         run(name, BLOCK_FRAMES, [&]() { k->interleave16(planes, out16.data(), BLOCK_FRAMES, CHANNELS); consume(out16.data(), 8); });
+
+         snprintf(name, sizeof(name), "interleave 8ch s16 [%s]", k->name);
+         run(name, BLOCK_FRAMES, [&]() { k->interleave16(planes8, out8.data(), BLOCK_FRAMES, 8); consume(out8.data(), 8); }, 8);
+
+         snprintf(name, sizeof(name), "byte swap s16 [%s]", k->name);
+         run(name, BLOCK_FRAMES, [&]() { k->byteSwap16(stereo16.data(), stereo16.size()); consume(stereo16.data(), 8); });
+
+         snprintf(name, sizeof(name), "byte swap s32 [%s]", k->name);
+         run(name, BLOCK_FRAMES, [&]() { k->byteSwap32(stereo32.data(), stereo32.size()); consume(stereo32.data(), 8); });
+
+         snprintf(name, sizeof(name), "narrow s24 -> s16 [%s]", k->name);
+         run(name, BLOCK_FRAMES, [&]()
+         {
+            k->narrowS32ToS16(in24.data(), out16.data(), in24.size(), 8, 29204);
+            consume(out16.data(), 8);
+         });
+      }
+   }
+
+   /* the looped sine of minPcmStereoOpt rendered into the device format - kernels + swap pass vs the write loops */
+   void frameRendering()
+   {
+      static constexpr auto table = audio::SineTable<int16_t, SAMPLE_RATE, 1000>::make();
+      const uint32_t tableSize = static_cast<uint32_t>(table.size());
+      std::vector<int16_t> out16(BLOCK_FRAMES * 8);
+      std::vector<int32_t> out32(BLOCK_FRAMES * 8);
+      uint32_t pos = 0;
+
+      run("loop s16x2x1152 fan-out + swap pass", BLOCK_FRAMES, [&]()
+      {
+         for (size_t f = 0; f < BLOCK_FRAMES; f += tableSize)
+         {
+            audio::kernels::fanOut16(table.data(), out16.data() + f * CHANNELS, tableSize, CHANNELS);
+         }
+         audio::kernels::byteSwap16(reinterpret_cast<uint16_t*>(out16.data()), BLOCK_FRAMES * CHANNELS);
+         consume(out16.data(), 8);
+      });
+
+      const auto swapped16 = audio::frameRendererFor(SND_PCM_FORMAT_S16_BE, CHANNELS, BLOCK_FRAMES);
+      run("loop s16_be x2x1152 generic", BLOCK_FRAMES, [&]()
+      {
+         swapped16.renderFrames(table.data(), tableSize, pos, out16.data(), BLOCK_FRAMES, CHANNELS);
+         consume(out16.data(), 8);
+      });
+      run("loop s16_be x2x1152 specialized", BLOCK_FRAMES, [&]()
+      {
+         swapped16.renderFrame(table.data(), tableSize, pos, out16.data());
+         consume(out16.data(), 8);
+      });
+
+      const auto wide32 = audio::frameRendererFor(SND_PCM_FORMAT_S32_LE, 8, 256);
+      run("loop s32x8x256 generic", 256, [&]()
+      {
+         wide32.renderFrames(table.data(), tableSize, pos, out32.data(), 256, 8);
+         consume(out32.data(), 8);
+      }, 8);
+      run("loop s32x8x256 specialized", 256, [&]()
+      {
+         wide32.renderFrame(table.data(), tableSize, pos, out32.data());
+         consume(out32.data(), 8);
+      }, 8);
+   }
+
+   /* the fixed point narrowing is exact, so every container of the same samples and every ISA must give identical output - */
+   /* the samples of s24, s24_3le and s32 go through the direct kernel and the block path, which both round the product once */
+   bool conversionCheck()
+   {
+      const char* name = "check s24 / s24_3le / s32 -> s16 gain";
+      if ((_filter != nullptr) && (strstr(name, _filter) == nullptr))
+      {
+         return true;
+      }
+
+      const size_t samples = BLOCK_FRAMES * CHANNELS;
+      std::vector<int32_t> in24(samples);
+      std::vector<uint8_t> in24Packed(samples * 3);
+      std::vector<int32_t> in32(samples);
+      std::vector<int16_t> out24(samples), outPacked(samples), out32(samples), outKernel(samples);
+      uint32_t state = 1;
+
+      for (size_t i = 0; i < samples; ++i)
+      {
+         state = state * 1664525u + 1013904223u;
+         const auto v = (i < 4) ? ((i & 1) ? 8388607 : -8388608) : (static_cast<int32_t>(state) >> 8);  /* both ends, then noise */
+         in24[i] = v;
+         in32[i] = static_cast<int32_t>(static_cast<uint32_t>(v) << 8);
+         in24Packed[3 * i] = static_cast<uint8_t>(v);
+         in24Packed[3 * i + 1] = static_cast<uint8_t>(v >> 8);
+         in24Packed[3 * i + 2] = static_cast<uint8_t>(v >> 16);
+      }
+
+      const auto selected = audio::kernels::active().isa;
+      bool passed = true;
+
+      for (auto isa : { audio::kernels::Isa::Scalar, audio::kernels::Isa::Sse2, audio::kernels::Isa::Avx2, audio::kernels::Isa::Neon })
+      {
+         if (!audio::kernels::select(isa))
+         {
+            continue;
+         }
+
+         for (double gainDb : { 0.0, -0.01, -1.0, -6.0, -60.0, 3.0 })
+         {
+            audio::ConversionOptions options {};
+            options.gainDb = gainDb;
+            audio::BitDepthConverter(SND_PCM_FORMAT_S24, SND_PCM_FORMAT_S16, CHANNELS, options).process(in24.data(), out24.data(), BLOCK_FRAMES);
+            audio::BitDepthConverter(SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S16, CHANNELS, options).process(in24Packed.data(), outPacked.data(), BLOCK_FRAMES);
+            audio::BitDepthConverter(SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S16, CHANNELS, options).process(in32.data(), out32.data(), BLOCK_FRAMES);
+
+            // up to unity the output is the Q31 * Q15 product rounded once, which the double below computes exactly
+            const double gain = pow(10.0, gainDb / 20.0);
+            const int32_t gainQ15 = (gain >= 1.0) ? 32768 : static_cast<int32_t>(lround(gain * 32768.0));
+            audio::kernels::active().narrowS32ToS16(in24.data(), outKernel.data(), samples, 8, gainQ15);
+            size_t mismatches = 0;
+
+            for (size_t i = 0; i < samples; ++i)
+            {
+               const auto reference = std::min(32767.0, floor((double(in32[i]) * gainQ15) / 2147483648.0 + 0.5));
+               const bool exact = (gain > 1.0) || ((out24[i] == reference) && (outKernel[i] == reference));
+               mismatches += (!exact || (outPacked[i] != out24[i]) || (out32[i] != out24[i])) ? 1 : 0;
+            }
+
+            printf("%-40s %+6.2f dB %zu mismatches [%s]\n", name, gainDb, mismatches, audio::kernels::active().name);
+            passed = passed && (mismatches == 0);
+         }
+      }
+
+      audio::kernels::select(selected);
+      return passed;
+   }
+
+   void conversion()
+   {
+      std::vector<int32_t> in24(BLOCK_FRAMES * CHANNELS, 0x123456);
+      std::vector<int16_t> out16(BLOCK_FRAMES * CHANNELS);
+
+      audio::ConversionOptions options {};
+      options.gainDb = -1.0;
+      audio::BitDepthConverter plain(SND_PCM_FORMAT_S24, SND_PCM_FORMAT_S16, CHANNELS, options);
+
+      run("convert s24 -> s16 -1 dB", BLOCK_FRAMES, [&]() { plain.process(in24.data(), out16.data(), BLOCK_FRAMES); consume(out16.data(), 8); });
+
+      std::vector<float> inFloat(BLOCK_FRAMES * CHANNELS, 0.25f);
+      audio::BitDepthConverter fromFloat(SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S16, CHANNELS, options);
+
+      run("convert float -> s16 -1 dB", BLOCK_FRAMES, [&]() { fromFloat.process(inFloat.data(), out16.data(), BLOCK_FRAMES); consume(out16.data(), 8); });
+
+      options.dither = audio::Dither::Tpdf;
+      audio::BitDepthConverter tpdf(SND_PCM_FORMAT_S24, SND_PCM_FORMAT_S16, CHANNELS, options);
+
+      run("convert s24 -> s16 tpdf", BLOCK_FRAMES, [&]() { tpdf.process(in24.data(), out16.data(), BLOCK_FRAMES); consume(out16.data(), 8); });
+
+      options.noiseShaping = true;
+      audio::BitDepthConverter dithered(SND_PCM_FORMAT_S24, SND_PCM_FORMAT_S16, CHANNELS, options);
+
+      run("convert s24 -> s16 tpdf + shaping", BLOCK_FRAMES, [&]() { dithered.process(in24.data(), out16.data(), BLOCK_FRAMES); consume(out16.data(), 8); });
+   }
+
+   void resampling()
+   {
+      audio::AdaptiveResampler resampler(CHANNELS, 2 * BLOCK_FRAMES);
+      std::vector<float> in(2 * BLOCK_FRAMES * CHANNELS, 0.25f);
+      std::vector<float> out(BLOCK_FRAMES * CHANNELS);
+      resampler.setRatio(1.0001);
+
+      run("resample stereo cubic +100 ppm", BLOCK_FRAMES, [&]()
+      {
+         resampler.process(in.data(), resampler.inputFramesFor(BLOCK_FRAMES), out.data(), BLOCK_FRAMES);
+         consume(out.data(), 8);
+      });
+   }
+
+   void dspChain()
+   {
+      const auto eq = audio::dsp::BiquadCoefficients::peaking(3000.0, 1.0, -6.0, SAMPLE_RATE);
+      audio::WavetableOscillator oscillator(1000.0, SAMPLE_RATE);
+      char name[64];
+
+      // one processing frame stays in L1 either way, the one second buffer of minPcmStereoOpt does not
+      for (size_t frames : { BLOCK_FRAMES, static_cast<size_t>(SAMPLE_RATE) })
+      {
+         std::vector<float> mono(frames);
+         std::vector<int16_t> mono16(frames);
+         std::vector<int16_t> out(frames * CHANNELS);
+
+         // one full pass per step - damp, EQ, limit, truncate, fan out and swap
+         audio::dsp::GainNode gain(0.7f);
+         audio::dsp::BiquadNode<1> biquad(eq);
+         audio::dsp::LimiterNode limiter;
+
+         snprintf(name, sizeof(name), "dsp %zu frames separate passes", frames);
+         run(name, frames, [&]()
+         {
+            oscillator.render(mono.data(), frames);
+            gain.process<1>(mono.data(), frames);
+            biquad.process<1>(mono.data(), frames);
+            limiter.process<1>(mono.data(), frames);
+            audio::kernels::floatToS16(mono.data(), mono16.data(), frames, 32768.0f);
+            audio::kernels::fanOut16(mono16.data(), out.data(), frames, CHANNELS);
+            audio::kernels::byteSwap16(reinterpret_cast<uint16_t*>(out.data()), out.size());
+            consume(out.data(), 8);
+         });
+
+         auto chain = audio::makeDspChain<1, CHANNELS, int16_t>(audio::dsp::GainNode(0.7f),
+                                                                audio::dsp::BiquadNode<1>(eq),
+                                                                audio::dsp::LimiterNode());
+         chain.setByteSwap(true);
+
+         snprintf(name, sizeof(name), "dsp %zu frames fused chain", frames);
+         run(name, frames, [&]()
+         {
+            chain.process([&oscillator](float* block, size_t count) { oscillator.render(block, count); },
+                          out.data(), frames);
+            consume(out.data(), 8);
+         });
+      }
+   }
+
+   /* the cost of one trace event in the hot path - only measured in a trace build (bash buildIt.bash trace) */
+   void tracing()
+   {
+#if defined(AUDIO_TRACE)
+      AUDIO_TRACE_THREAD("bench");
+      int32_t value = 0;
+
+      run("trace instant event", 1, [&]() { AUDIO_TRACE_INSTANT("bench", ++value); }, 1);
+      run("trace scope (begin + end)", 1, [&]() { AUDIO_TRACE_SCOPE("bench"); }, 1);
+#else
+      if ((_filter == nullptr) || (strstr("trace", _filter) != nullptr))
+      {
+         printf("%-40s compiled out, build with trace\n", "trace events");
+      }
+#endif
+   }
+
+   /* 8 identification tones through the channel router (permuted as a HDA 7.1 device plays them) */
+   void channelRouting()
+   {
+      std::vector<std::unique_ptr<audio::OscillatorSource>> tones;
+      audio::ChannelRouter router(audio::layouts::SURROUND_71, SND_PCM_FORMAT_S16);
+      std::vector<int16_t> out(BLOCK_FRAMES * 8);
+
+      for (uint32_t c = 0; c < 8; ++c)
+      {
+         tones.emplace_back(new audio::OscillatorSource(440.0 + 50.0 * c, SAMPLE_RATE, 0.5));
+         router.assign({ audio::layouts::SURROUND_71.positions[c] }, tones.back().get());
+      }
+
+      audio::ChannelRoute route = audio::ChannelRoute::identity(8);
+      route.source = { 0, 1, 4, 5, 2, 3, 6, 7 };
+      router.setRoute(route);
+
+      run("channel router 7.1 s16, 8 tones", BLOCK_FRAMES, [&]()
+      {
+         router.render(out.data(), BLOCK_FRAMES);
+         consume(out.data(), 8);
+      }, 8);
+   }
+
+   /* a stream's period of a test tone: rendering it vs copying it out of a shared loop (a private memfd here) */
+   void sharedLoop()
+   {
+      audio::WavetableOscillator oscillator(247.5, SAMPLE_RATE, 0.2);
+      audio::SharedLoop loop;
+      std::vector<int16_t> out(BLOCK_FRAMES * CHANNELS);
+      uint32_t offset = 0;
+
+      run("tone period rendered (oscillator)", BLOCK_FRAMES, [&]()
+      {
+         oscillator.renderInterleaved(out.data(), BLOCK_FRAMES, CHANNELS);
+         consume(out.data(), 8);
+      });
+
+      const auto key = audio::LoopKey::sine(247.5, SAMPLE_RATE, SND_PCM_FORMAT_S16, CHANNELS, 0.2f);
+      if (loop.open(key, audio::SharedLoop::Scope::Process) == 0)
+      {
+         run("tone period copied from the shared loop", BLOCK_FRAMES, [&]()
+         {
+            loop.copy(out.data(), BLOCK_FRAMES, offset);
+            consume(out.data(), 8);
+         });
+      }
+   }
+
+   void mixing()
+   {
+      std::vector<int16_t> out(BLOCK_FRAMES * CHANNELS);
+      char name[64];
+
+      for (size_t voices : { 1, 8, 64, 256 })
+      {
+         audio::Mixer mixer(CHANNELS, SAMPLE_RATE, BLOCK_FRAMES, voices);
+         std::vector<std::unique_ptr<audio::OscillatorSource>> sources;
+
+         for (size_t v = 0; v < voices; ++v)
+         {
+            sources.emplace_back(new audio::OscillatorSource(110.0 * (1 + v % 16), SAMPLE_RATE));
+            mixer.addVoice(sources.back().get(), 0.5f);
+         }
+         mixer.setHeadroom(audio::Headroom::Auto);
+
+         snprintf(name, sizeof(name), "mix %zu voices -> s16", voices);
+         const auto ns = run(name, BLOCK_FRAMES, [&]() { mixer.mix(out.data(), BLOCK_FRAMES); consume(out.data(), 8); });
+         if (ns > 0.0)
+         {
+            printf("%-40s %10.2f ns/voice-frame\n", "", ns / voices);
+         }
+      }
+   }
+
+   /* pushes ENGINE_SECONDS of audio through an opened device, writei with a ready buffer or render() in place */
+   void engineCase(const char* name, const char* device, snd_pcm_access_t access, bool renderLive)
+   {
+      if ((_filter != nullptr) && (strstr(name, _filter) == nullptr))
+      {
+         return;
+      }
+
+      audio::PcmOutput output;
+      audio::PcmFormat format {};
+      format.device = device;
+      format.access = access;
+      format.config = audio::presets::BALANCED;
+
+      if (output.open(format) < 0)
+      {
+         printf("%-40s skipped - %s can't be opened\n", name, device);
+         return;
+      }
+
+      const auto period = output.negotiated().periodFrames;
+      const size_t totalFrames = ENGINE_SECONDS * SAMPLE_RATE;
+      std::vector<int16_t> buffer(period * CHANNELS, 1000);
+      audio::WavetableOscillator oscillator(1000.0, SAMPLE_RATE, 0.7);
+
+      const auto start = std::chrono::steady_clock::now();
+      audio::AllocationGuard guard;
+      size_t done = 0;
+
+      while (done < totalFrames)
+      {
+         snd_pcm_sframes_t frames;
+
+         if (renderLive)
+         {
+            // the minPcmStereo way: every period is generated right before it is written
+            frames = output.render(period, [&oscillator](void* area, snd_pcm_uframes_t count)
+            {
+               oscillator.renderInterleaved(static_cast<int16_t*>(area), count, CHANNELS);
+            });
+         }
+         else
+         {
+            // the minPcmStereoOpt way: a prepared buffer is written again and again
+            frames = output.write(buffer.data(), period);
+         }
+
+         if (frames < 0)
+         {
+            printf("%-40s failed\n", name);
+            return;
+         }
+         done += frames;
+      }
+
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      const auto allocations = guard.allocations();
+
+      printf("%-40s %10.2f ns/frame %10.0fx realtime, %llu allocations%s\n", name,
+             (elapsed.count() * 1e9) / done, (done / static_cast<double>(SAMPLE_RATE)) / elapsed.count(),
+             static_cast<unsigned long long>(allocations),
+#ifdef AUDIO_COUNT_ALLOCATIONS
+             "");
+#else
+             " (not counted, build with debug)");
+#endif
+      printf("%-40s ", "");
+      audio::printStats(output.stats());
+   }
+
+   void engine()
+   {
+      engineCase("engine null writei prepared buffer", "null", SND_PCM_ACCESS_RW_INTERLEAVED, false);
+      engineCase("engine null writei live render", "null", SND_PCM_ACCESS_RW_INTERLEAVED, true);
+      engineCase("engine null mmap live render", "null", SND_PCM_ACCESS_MMAP_INTERLEAVED, true);
+      engineCase("engine file writei prepared buffer", FILE_DEVICE, SND_PCM_ACCESS_RW_INTERLEAVED, false);
+      engineCase("engine file writei live render", FILE_DEVICE, SND_PCM_ACCESS_RW_INTERLEAVED, true);
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   const char* group = (argc > 1) ? argv[1] : "all";
+   bench::_filter = (argc > 2) ? argv[2] : nullptr;
+   bool passed = true;
+
+   printf("Kernels selected at runtime: %s\n", audio::kernels::active().name);
+
+   if ((strcmp(group, "all") == 0) || (strcmp(group, "kernels") == 0))
+   {
+      bench::sineGeneration();
+      bench::shufflingKernels();
+      bench::frameRendering();
+      passed = bench::conversionCheck();
+      bench::conversion();
+      bench::resampling();
+      bench::dspChain();
+      bench::channelRouting();
+      bench::sharedLoop();
+      bench::mixing();
+      bench::tracing();
+   }
+
+   if ((strcmp(group, "all") == 0) || (strcmp(group, "engine") == 0))
+   {
+      bench::engine();
+   }
+
+   return passed ? 0 : 1;
+}
@@ -1,5 +1,7 @@
 #!/bin/bash
 
+# The quick build without cmake, CMakeLists.txt adds the build types, LTO/PGO and the shared library
+
 # First install the libsound2 development package
 # So that the source files and includes are added aspecially the ones in: /usr/include/alsa
 # Running the apt installation command in case the necessary include file  is not found
@@ -13,12 +15,42 @@ else
 fi
 
 
-# 2. finally compiling the simple program
+# 2. compiling the shared output engine into a static library
 BUILD_OUPUT_DIR=./buildOutput
-if [ -f "$BUILD_OUPUT_DIR" ]; then
-    mkdir ./buildOutput
+if [ ! -d "$BUILD_OUPUT_DIR" ]; then
+    mkdir $BUILD_OUPUT_DIR
+fi
+
+CXXFLAGS="-std=c++17 -pthread -I."
+
+# "bash buildIt.bash debug" counts heap allocations and asserts there are none in the render loop
+# "bash buildIt.bash trace" keeps the optimizations and compiles the AUDIO_TRACE_* trace points in
+if [ "$1" == "debug" ]; then
+    CXXFLAGS="$CXXFLAGS -O0 -g -DAUDIO_COUNT_ALLOCATIONS"
+elif [ "$1" == "trace" ]; then
+    CXXFLAGS="$CXXFLAGS -O2 -DAUDIO_TRACE"
+else
+    CXXFLAGS="$CXXFLAGS -O2"
 fi
-echo "Compiling the most recent example program"
-g++ minPcmStereoOpt.c -lasound -lm -o buildOutput/minPcmStereoOpt.out
+ENGINE_SOURCES="engine/pcmOutput.cpp engine/pcmConfig.cpp engine/sampleFormat.cpp engine/rtThread.cpp engine/oscillator.cpp engine/simdKernels.cpp engine/bitDepthConv.cpp engine/framePool.cpp engine/allocGuard.cpp engine/mixer.cpp engine/fileSource.cpp engine/pipeline.cpp engine/pcmStats.cpp engine/fileSink.cpp engine/deviceList.cpp engine/multiOutput.cpp engine/resampler.cpp engine/pcmCapture.cpp engine/latencyProbe.cpp engine/dspChain.cpp engine/frameRenderer.cpp engine/workPool.cpp engine/streamServer.cpp engine/sourceScheduler.cpp engine/trace.cpp engine/deviceCache.cpp engine/channelMap.cpp engine/signalCache.cpp"
+
+echo "Compiling the output engine library"
+ENGINE_OBJECTS=""
+for SRC in $ENGINE_SOURCES; do
+    OBJ=$BUILD_OUPUT_DIR/$(basename ${SRC%.cpp}).o
+    g++ $CXXFLAGS -c $SRC -o $OBJ || exit 1
+    ENGINE_OBJECTS="$ENGINE_OBJECTS $OBJ"
+done
+ar rcs $BUILD_OUPUT_DIR/libpcmengine.a $ENGINE_OBJECTS
+
+
+# 3. finally compiling the example programs against the engine library
+for DEMO in minPcm minPcmStereo minPcmStereoOpt minPcmBitDepthConv minPcmFile minPcmMulti minPcmLoopback minPcmServer minPcmPlaylist minPcmChannels; do
+    echo "Compiling the $DEMO example program"
+    g++ $CXXFLAGS $DEMO.cpp -L$BUILD_OUPUT_DIR -lpcmengine -lasound -lrt -lm -o $BUILD_OUPUT_DIR/$DEMO.out || exit 1
+done
 
 
+# 4. the benchmarks of the kernels and of the write path
+echo "Compiling the pcmBench benchmark program"
+g++ $CXXFLAGS bench/pcmBench.cpp -L$BUILD_OUPUT_DIR -lpcmengine -lasound -lrt -lm -o $BUILD_OUPUT_DIR/pcmBench.out || exit 1
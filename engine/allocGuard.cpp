@@ -0,0 +1,42 @@
+#include "allocGuard.hpp"
+
+#include <stdlib.h>
+#include <new>
+
+namespace audio
+{
+   namespace
+   {
+      thread_local uint64_t _threadAllocations = 0;
+   }
+
+   uint64_t threadAllocationCount()
+   {
+      return _threadAllocations;
+   }
+
+#if defined(AUDIO_COUNT_ALLOCATIONS)
+   namespace
+   {
+      void* countedAlloc(size_t size)
+      {
+         ++_threadAllocations;
+         if (auto ptr = malloc(size ? size : 1))
+         {
+            return ptr;
+         }
+         throw std::bad_alloc();
+      }
+   }
+#endif
+}
+
+#if defined(AUDIO_COUNT_ALLOCATIONS)
+// the aligned variants keep the default implementation, the render path only uses plain new
+void* operator new(size_t size) { return audio::countedAlloc(size); }
+void* operator new[](size_t size) { return audio::countedAlloc(size); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+#endif
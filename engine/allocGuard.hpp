@@ -0,0 +1,34 @@
+/*
+ *  Debug check for the allocation-free render path.
+ *  When compiled with AUDIO_COUNT_ALLOCATIONS the global operator new counts the heap allocations
+ *  of every thread; an AllocationGuard created after start-up asserts that its thread does not allocate anymore.
+ *  Without the define the counter stays zero and the checks compile to nothing.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+
+namespace audio
+{
+   /* heap allocations done by the calling thread so far (always 0 without AUDIO_COUNT_ALLOCATIONS) */
+   uint64_t threadAllocationCount();
+
+   class AllocationGuard
+   {
+   public:
+      AllocationGuard() : _start(threadAllocationCount()) {}
+
+      /* allocations of this thread since the guard was created */
+      uint64_t allocations() const { return threadAllocationCount() - _start; }
+
+      void check() const
+      {
+         assert(allocations() == 0 && "heap allocation in the render path");
+      }
+
+   private:
+      uint64_t _start;
+   };
+}
@@ -0,0 +1,58 @@
+/*
+ *  Common interface of everything that produces audio for the mixer or the pipeline:
+ *  oscillators, file streams, ...
+ */
+
+#pragma once
+
+#include "oscillator.hpp"
+#include <stdint.h>
+#include <stddef.h>
+
+namespace audio
+{
+   class AudioSource
+   {
+   public:
+      virtual ~AudioSource() = default;
+
+      /* renders up to frames interleaved float frames (-1.0 .. 1.0) with the given channel count,       */
+      /* returns the amount of rendered frames - less than requested means that the source has finished */
+      virtual size_t render(float* out, size_t frames, uint32_t channels) = 0;
+   };
+
+   /* endless sine - the same signal in every channel */
+   class OscillatorSource : public AudioSource
+   {
+   public:
+      OscillatorSource(double frequency, uint32_t sampleRate, double amplitude = 1.0)
+         : _oscillator(frequency, sampleRate, amplitude)
+      {
+      }
+
+      WavetableOscillator& oscillator() { return _oscillator; }
+
+      size_t render(float* out, size_t frames, uint32_t channels) override
+      {
+         _oscillator.render(out, frames);
+
+         // spreading the mono samples from the back, so that nothing is overwritten before it was copied
+         if (channels > 1)
+         {
+            for (size_t f = frames; f-- > 0;)
+            {
+               const auto s = out[f];
+               for (uint32_t c = 0; c < channels; ++c)
+               {
+                  out[(f * channels) + c] = s;
+               }
+            }
+         }
+
+         return frames;
+      }
+
+   private:
+      WavetableOscillator _oscillator;
+   };
+}
@@ -0,0 +1,290 @@
+#include "bitDepthConv.hpp"
+#include "simdKernels.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace audio
+{
+   namespace
+   {
+      constexpr size_t BLOCK_SAMPLES = 256;   /* intermediate block - stays in L1 together with the in/out data */
+
+      size_t containerBytes(snd_pcm_format_t format)
+      {
+         switch (format)
+         {
+            case SND_PCM_FORMAT_S16:      return 2;
+            case SND_PCM_FORMAT_S24_3LE:  return 3;
+            case SND_PCM_FORMAT_S24:
+            case SND_PCM_FORMAT_S32:
+            case SND_PCM_FORMAT_FLOAT:    return 4;
+            default:                      return 0;
+         }
+      }
+
+      uint32_t significantBits(snd_pcm_format_t format)
+      {
+         switch (format)
+         {
+            case SND_PCM_FORMAT_S16:      return 16;
+            case SND_PCM_FORMAT_S24_3LE:
+            case SND_PCM_FORMAT_S24:      return 24;
+            default:                      return 32;
+         }
+      }
+
+      /* integer input sample left justified into the full 32 bit range */
+      inline int32_t decodeQ31(const uint8_t* in, size_t i, snd_pcm_format_t format)
+      {
+         switch (format)
+         {
+            case SND_PCM_FORMAT_S16:
+               return static_cast<int32_t>(static_cast<uint32_t>(reinterpret_cast<const int16_t*>(in)[i]) << 16);
+            case SND_PCM_FORMAT_S24:
+               return static_cast<int32_t>(reinterpret_cast<const uint32_t*>(in)[i] << 8);
+            case SND_PCM_FORMAT_S24_3LE:
+            {
+               const auto p = in + (3 * i);
+               return static_cast<int32_t>((uint32_t(p[0]) << 8) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 24));
+            }
+            default:
+               return reinterpret_cast<const int32_t*>(in)[i];
+         }
+      }
+
+      inline int32_t saturate(int64_t value, int64_t minValue, int64_t maxValue)
+      {
+         return static_cast<int32_t>((value < minValue) ? minValue : ((value > maxValue) ? maxValue : value));
+      }
+
+      /* store(i, sample) for a block of integer samples left justified to Q31 - the format is switched on once */
+      /* per block, inside the loop Format is a constant and the switch of decodeQ31 folds away                */
+      template <snd_pcm_format_t Format, typename Store>
+      void decodeBlock(const uint8_t* in, size_t count, Store store)
+      {
+         for (size_t i = 0; i < count; ++i)
+         {
+            store(i, decodeQ31(in, i, Format));
+         }
+      }
+
+      template <typename Store>
+      void decodeBlock(const uint8_t* in, size_t count, snd_pcm_format_t format, Store store)
+      {
+         switch (format)
+         {
+            case SND_PCM_FORMAT_S16:      decodeBlock<SND_PCM_FORMAT_S16>(in, count, store); break;
+            case SND_PCM_FORMAT_S24:      decodeBlock<SND_PCM_FORMAT_S24>(in, count, store); break;
+            case SND_PCM_FORMAT_S24_3LE:  decodeBlock<SND_PCM_FORMAT_S24_3LE>(in, count, store); break;
+            default:                      decodeBlock<SND_PCM_FORMAT_S32>(in, count, store); break;
+         }
+      }
+
+      /* a block of input samples in output LSB units */
+      void decodeScaled(const uint8_t* in, size_t count, snd_pcm_format_t format, float scale, float* out)
+      {
+         if (format == SND_PCM_FORMAT_FLOAT)
+         {
+            for (size_t i = 0; i < count; ++i)
+            {
+               out[i] = reinterpret_cast<const float*>(in)[i] * scale;
+            }
+            return;
+         }
+
+         decodeBlock(in, count, format, [out, scale](size_t i, int32_t sample) { out[i] = static_cast<float>(sample) * scale; });
+      }
+
+      /* xorshift32 - cheap and good enough for dither noise */
+      inline float nextUniform(uint32_t& state)
+      {
+         state ^= state << 13;
+         state ^= state >> 17;
+         state ^= state << 5;
+         return static_cast<float>(state) * (1.0f / 4294967296.0f);
+      }
+   }
+
+   bool BitDepthConverter::supportedInput(snd_pcm_format_t format)
+   {
+      return containerBytes(format) != 0;
+   }
+
+   bool BitDepthConverter::supportedOutput(snd_pcm_format_t format)
+   {
+      return (format == SND_PCM_FORMAT_S16) || (format == SND_PCM_FORMAT_S24) || (format == SND_PCM_FORMAT_S32);
+   }
+
+   BitDepthConverter::BitDepthConverter(snd_pcm_format_t from, snd_pcm_format_t to, uint32_t channels,
+                                        const ConversionOptions& options)
+      : _from(from)
+      , _to(to)
+      , _channels(channels)
+      , _options(options)
+      , _valid(supportedInput(from) && supportedOutput(to) && (channels > 0))
+      , _inBytes(containerBytes(from))
+      , _outBytes(containerBytes(to))
+   {
+      const double gain = pow(10.0, options.gainDb / 20.0);
+      const auto outBits = significantBits(to);
+
+      _gainQ15 = (gain >= 1.0) ? 32768 : static_cast<int32_t>(lround(gain * 32768.0));
+      _gainQ30 = llround(gain * 1073741824.0);
+
+      // float path: input full scale (Q31 or +-1.0 for float) to output LSB units in a single multiply
+      const double outFullScale = ldexp(1.0, outBits - 1);
+      _floatScale = static_cast<float>(gain * outFullScale / ((from == SND_PCM_FORMAT_FLOAT) ? 1.0 : 2147483648.0));
+      _outMax = static_cast<float>(outFullScale - 1.0);
+      _outMin = static_cast<float>(-outFullScale);
+
+      _shapingError.assign(channels, 0.0f);
+   }
+
+   void BitDepthConverter::process(const void* in, void* out, size_t frames)
+   {
+      if (!_valid)
+      {
+         return;
+      }
+
+      auto src = static_cast<const uint8_t*>(in);
+      auto dst = static_cast<uint8_t*>(out);
+      const auto samples = frames * _channels;
+
+      if ((_from == SND_PCM_FORMAT_FLOAT) || (_options.dither != Dither::None))
+      {
+         processFloat(src, dst, samples);
+      }
+      else
+      {
+         processFixedPoint(src, dst, samples);
+      }
+   }
+
+   void BitDepthConverter::processFixedPoint(const uint8_t* in, uint8_t* out, size_t samples)
+   {
+      // the hot case - 32 bit containers narrowed to 16 bit, straight from the input buffer
+      if ((_to == SND_PCM_FORMAT_S16) && (_gainQ30 <= (int64_t(1) << 30)) &&
+          ((_from == SND_PCM_FORMAT_S24) || (_from == SND_PCM_FORMAT_S32)))
+      {
+         kernels::narrowS32ToS16(reinterpret_cast<const int32_t*>(in), reinterpret_cast<int16_t*>(out), samples,
+                                 (_from == SND_PCM_FORMAT_S24) ? 8 : 0, _gainQ15);
+         return;
+      }
+
+      // a gain up to unity narrowed to 16 bit is left to the kernel, which rounds the product only once -
+      // the same samples give the same output through either path, whatever container they come in
+      int32_t block[BLOCK_SAMPLES];
+      const bool kernelGain = (_to == SND_PCM_FORMAT_S16) && (_gainQ30 <= (int64_t(1) << 30));
+      const bool blockGain = !kernelGain && (_gainQ30 != (int64_t(1) << 30));
+
+      for (size_t done = 0; done < samples; done += BLOCK_SAMPLES)
+      {
+         const auto count = (samples - done < BLOCK_SAMPLES) ? (samples - done) : BLOCK_SAMPLES;
+         const auto blockIn = in + (done * _inBytes);
+
+         decodeBlock(blockIn, count, _from, [&block](size_t i, int32_t sample) { block[i] = sample; });
+
+         if (blockGain)
+         {
+            for (size_t i = 0; i < count; ++i)
+            {
+               block[i] = saturate((int64_t(block[i]) * _gainQ30 + (int64_t(1) << 29)) >> 30, INT32_MIN, INT32_MAX);
+            }
+         }
+
+         const auto blockOut = out + (done * _outBytes);
+
+         switch (_to)
+         {
+            case SND_PCM_FORMAT_S16:
+               kernels::narrowS32ToS16(block, reinterpret_cast<int16_t*>(blockOut), count, 0, kernelGain ? _gainQ15 : 32768);
+               break;
+            case SND_PCM_FORMAT_S24:
+               for (size_t i = 0; i < count; ++i)
+               {
+                  reinterpret_cast<int32_t*>(blockOut)[i] = saturate(((block[i] >> 7) + 1) >> 1, -8388608, 8388607);
+               }
+               break;
+            default:
+               memcpy(blockOut, block, count * sizeof(int32_t));
+               break;
+         }
+      }
+   }
+
+   void BitDepthConverter::processFloat(const uint8_t* in, uint8_t* out, size_t samples)
+   {
+      const bool dither = (_options.dither == Dither::Tpdf);
+      const bool shaping = dither && _options.noiseShaping;
+
+      // undithered float to S16 / S32 is a single pass of the conversion kernel, the scale is its multiply
+      if (!dither && (_from == SND_PCM_FORMAT_FLOAT) && (_to != SND_PCM_FORMAT_S24))
+      {
+         auto src = reinterpret_cast<const float*>(in);
+         if (_to == SND_PCM_FORMAT_S16)
+         {
+            kernels::floatToS16(src, reinterpret_cast<int16_t*>(out), samples, _floatScale);
+         }
+         else
+         {
+            kernels::floatToS32(src, reinterpret_cast<int32_t*>(out), samples, _floatScale);
+         }
+         return;
+      }
+
+      float block[BLOCK_SAMPLES];
+      uint32_t channel = 0;
+
+      for (size_t done = 0; done < samples; done += BLOCK_SAMPLES)
+      {
+         const auto count = (samples - done < BLOCK_SAMPLES) ? (samples - done) : BLOCK_SAMPLES;
+
+         decodeScaled(in + (done * _inBytes), count, _from, _floatScale, block);
+
+         if (shaping)
+         {
+            // the only recursive part: the quantization error of a sample is fed back into the next one of its
+            // channel, which pushes the noise up in frequency - the sample is quantized here already
+            for (size_t i = 0; i < count; ++i)
+            {
+               const float value = block[i] - _shapingError[channel];
+               const float noise = nextUniform(_rng) - nextUniform(_rng);
+               const float quantized = std::min(std::max(rintf(value + noise), _outMin), _outMax);
+
+               _shapingError[channel] = quantized - value;
+               block[i] = quantized;
+               channel = (channel + 1 == _channels) ? 0 : channel + 1;
+            }
+         }
+         else if (dither)
+         {
+            for (size_t i = 0; i < count; ++i)
+            {
+               block[i] += nextUniform(_rng) - nextUniform(_rng);
+            }
+         }
+
+         // the kernels saturate to the 16 / 32 bit range, 24 bit samples are clamped before
+         if (_to == SND_PCM_FORMAT_S24)
+         {
+            for (size_t i = 0; i < count; ++i)
+            {
+               block[i] = std::min(std::max(block[i], _outMin), _outMax);
+            }
+         }
+
+         const auto blockOut = out + (done * _outBytes);
+         if (_to == SND_PCM_FORMAT_S16)
+         {
+            kernels::floatToS16(block, reinterpret_cast<int16_t*>(blockOut), count, 1.0f);
+         }
+         else
+         {
+            kernels::floatToS32(block, reinterpret_cast<int32_t*>(blockOut), count, 1.0f);
+         }
+      }
+   }
+}
@@ -0,0 +1,70 @@
+/*
+ *  Batch sample format / bit depth conversion.
+ *  Converts whole periods between S16, S24 (in a 32 bit container), S24_3LE, S32 and FLOAT
+ *  (inputs) and S16, S24, S32 (outputs), all in the host byte order.
+ *  The gain is folded into the conversion as a multiply-shift, results are saturated to the output range.
+ *  Integer sources without dithering take a fixed-point path - S24/S32 to S16, the case of feeding
+ *  24 bit studio material to a 16 bit DAC, runs on SIMD kernels. Float sources and dithered
+ *  conversions (TPDF, optionally with first order noise shaping) go through a float block path:
+ *  decoded and scaled a block at a time, rounded and saturated by the floatToS16 / floatToS32 kernels.
+ *  The dither noise comes from one serial generator and the shaping feeds every error into the next
+ *  sample of its channel, those two stay scalar loops over the block.
+ */
+
+#pragma once
+
+#include <alsa/asoundlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace audio
+{
+   enum class Dither
+   {
+      None,
+      Tpdf          /* triangular noise of +-1 LSB of the output format */
+   };
+
+   struct ConversionOptions
+   {
+      double gainDb = 0.0;             /* applied during the conversion, e.g. -1.0 to leave headroom */
+      Dither dither = Dither::None;
+      bool   noiseShaping = false;     /* first order error feedback, only together with dithering */
+   };
+
+   class BitDepthConverter
+   {
+   public:
+      BitDepthConverter(snd_pcm_format_t from, snd_pcm_format_t to, uint32_t channels, const ConversionOptions& options = {});
+
+      /* false when one of the formats is not supported */
+      bool valid() const { return _valid; }
+
+      /* converts interleaved frames, in and out may not overlap */
+      void process(const void* in, void* out, size_t frames);
+
+      static bool supportedInput(snd_pcm_format_t format);
+      static bool supportedOutput(snd_pcm_format_t format);
+
+   private:
+      void processFixedPoint(const uint8_t* in, uint8_t* out, size_t samples);
+      void processFloat(const uint8_t* in, uint8_t* out, size_t samples);
+
+      snd_pcm_format_t _from;
+      snd_pcm_format_t _to;
+      uint32_t         _channels;
+      ConversionOptions _options;
+      bool             _valid;
+      size_t           _inBytes;
+      size_t           _outBytes;
+
+      int32_t          _gainQ15;       /* fixed point path gain, 32768 is unity */
+      int64_t          _gainQ30;
+      float            _floatScale;    /* input to output LSB scale with the gain folded in */
+      float            _outMax;
+      float            _outMin;
+      uint32_t         _rng = 0x1234567u;
+      std::vector<float> _shapingError {};   /* last quantization error for each channel */
+   };
+}
@@ -0,0 +1,300 @@
+#include "channelMap.hpp"
+#include "simdKernels.hpp"
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace audio
+{
+   namespace
+   {
+      const ChannelLayout* const ALL_LAYOUTS[] { &layouts::STEREO, &layouts::QUAD, &layouts::SURROUND_51, &layouts::SURROUND_71 };
+
+      int layoutChannel(const ChannelLayout& layout, unsigned int position)
+      {
+         for (uint32_t c = 0; c < layout.channels; ++c)
+         {
+            if (layout.positions[c] == position)
+            {
+               return static_cast<int>(c);
+            }
+         }
+         return -1;
+      }
+
+      bool holdsLayout(const snd_pcm_chmap_t& map, const ChannelLayout& layout)
+      {
+         if (map.channels != layout.channels)
+         {
+            return false;
+         }
+
+         for (uint32_t c = 0; c < layout.channels; ++c)
+         {
+            const auto end = map.pos + map.channels;
+            if (std::find_if(map.pos, end, [&](unsigned int p) { return (p & SND_CHMAP_POSITION_MASK) == layout.positions[c]; }) == end)
+            {
+               return false;
+            }
+         }
+         return true;
+      }
+
+      const char* positionName(unsigned int position)
+      {
+         const char* name = snd_pcm_chmap_name(static_cast<snd_pcm_chmap_position>(position));
+         return (name != nullptr) ? name : "?";
+      }
+   }
+
+   const ChannelLayout* findLayout(const char* name)
+   {
+      if (name == nullptr)
+      {
+         return nullptr;
+      }
+
+      for (auto layout : ALL_LAYOUTS)
+      {
+         if (strncmp(layout->name, name, strlen(name)) == 0)
+         {
+            return layout;
+         }
+      }
+
+      return nullptr;
+   }
+
+   ChannelRoute ChannelRoute::identity(uint32_t channels)
+   {
+      ChannelRoute route;
+      route.channels = std::min(channels, MAX_MAPPED_CHANNELS);
+      // the slots past the channels are never read, filling all of them keeps the loop bound a constant
+      for (size_t d = 0; d < route.source.size(); ++d)
+      {
+         route.source[d] = static_cast<int8_t>(d);
+      }
+      return route;
+   }
+
+   bool ChannelRoute::isIdentity() const
+   {
+      for (uint32_t d = 0; d < channels; ++d)
+      {
+         if (source[d] != static_cast<int8_t>(d))
+         {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   int applyChannelMap(snd_pcm_t* handle, const ChannelLayout& layout, ChannelRoute& route)
+   {
+      route = ChannelRoute::identity(layout.channels);
+
+      if (handle == nullptr)
+      {
+         return 0;
+      }
+
+      // snd_pcm_chmap_t ends with a flexible array of the positions
+      unsigned int wanted[1 + MAX_MAPPED_CHANNELS];
+      wanted[0] = layout.channels;
+      std::copy(layout.positions, layout.positions + layout.channels, wanted + 1);
+
+      // drivers with a variable map take the layout as it is, the others offer fixed (or pairwise swappable)
+      // maps - one holding all the speakers of the layout is as good, the route puts them in place
+      if (snd_pcm_set_chmap(handle, reinterpret_cast<snd_pcm_chmap_t*>(wanted)) < 0)
+      {
+         snd_pcm_chmap_query_t** maps = snd_pcm_query_chmaps(handle);
+         for (auto map = maps; (map != nullptr) && (*map != nullptr); ++map)
+         {
+            if (holdsLayout((*map)->map, layout) && (snd_pcm_set_chmap(handle, &(*map)->map) == 0))
+            {
+               break;
+            }
+         }
+         snd_pcm_free_chmaps(maps);
+      }
+
+      snd_pcm_chmap_t* current = snd_pcm_get_chmap(handle);
+      if (current == nullptr)
+      {
+         printf("The device reports no channel map, assuming the %s order\n", layout.name);
+         return 0;
+      }
+
+      if (current->channels != layout.channels)
+      {
+         printf("The device plays %u channels, the %s layout has %u\n", current->channels, layout.name, layout.channels);
+         free(current);
+         return -EINVAL;
+      }
+
+      ChannelRoute mapped;
+      mapped.channels = layout.channels;
+      uint32_t known = 0;
+      for (uint32_t d = 0; d < current->channels; ++d)
+      {
+         const int channel = layoutChannel(layout, current->pos[d] & SND_CHMAP_POSITION_MASK);
+         mapped.source[d] = static_cast<int8_t>(channel);
+         known += (channel >= 0) ? 1 : 0;
+      }
+      free(current);
+
+      // drivers that only report unknown positions say nothing about the order
+      if (known == 0)
+      {
+         printf("The device channel map has no known positions, assuming the %s order\n", layout.name);
+         return 0;
+      }
+
+      for (uint32_t c = 0; c < layout.channels; ++c)
+      {
+         if (std::find(mapped.source.begin(), mapped.source.begin() + mapped.channels, static_cast<int8_t>(c)) ==
+             mapped.source.begin() + mapped.channels)
+         {
+            printf("The device has no %s speaker, that channel is dropped\n", positionName(layout.positions[c]));
+         }
+      }
+
+      route = mapped;
+      return 0;
+   }
+
+   void printRoute(const ChannelLayout& layout, const ChannelRoute& route)
+   {
+      printf("Channel map (%s, %s):", layout.name, route.isIdentity() ? "as rendered" : "permuted");
+      for (uint32_t d = 0; d < route.channels; ++d)
+      {
+         printf(" %s", (route.source[d] == ChannelRoute::SILENT) ? "--" : positionName(layout.positions[route.source[d]]));
+      }
+      printf("\n");
+   }
+
+   ChannelRouter::ChannelRouter(const ChannelLayout& layout, snd_pcm_format_t format)
+      : _layout(layout)
+   {
+      _layout.channels = std::min(layout.channels, MAX_MAPPED_CHANNELS);
+      _sampleBytes = (format == SND_PCM_FORMAT_S16) ? 2 : (format == SND_PCM_FORMAT_S32) ? 4 : 0;
+      _groups.reserve(_layout.channels);
+      _groupOf.fill(-1);
+      _gain.fill(1.0f);
+      _planes.resize(_layout.channels * BLOCK_FRAMES * _sampleBytes);
+      _silence.resize(BLOCK_FRAMES * _sampleBytes);
+
+      setRoute(ChannelRoute::identity(_layout.channels));
+   }
+
+   int ChannelRouter::channelOf(unsigned int position) const
+   {
+      return layoutChannel(_layout, position);
+   }
+
+   int ChannelRouter::assign(std::initializer_list<unsigned int> positions, AudioSource* source, float gain)
+   {
+      for (auto position : positions)
+      {
+         const int channel = channelOf(position);
+         if ((channel < 0) || (_groupOf[channel] >= 0))
+         {
+            printf("Speaker %s is not part of the %s layout or already has a source\n", positionName(position), _layout.name);
+            return -EINVAL;
+         }
+      }
+
+      _groups.push_back(Group { source, std::vector<float>(BLOCK_FRAMES) });
+      for (auto position : positions)
+      {
+         const int channel = channelOf(position);
+         _groupOf[channel] = static_cast<int>(_groups.size() - 1);
+         _gain[channel] = gain;
+      }
+
+      setRoute(_route);
+      return 0;
+   }
+
+   void ChannelRouter::setGain(unsigned int position, float gain)
+   {
+      const int channel = channelOf(position);
+      if (channel >= 0)
+      {
+         _gain[channel] = gain;
+      }
+   }
+
+   void ChannelRouter::setRoute(const ChannelRoute& route)
+   {
+      _route = (route.channels == _layout.channels) ? route : ChannelRoute::identity(_layout.channels);
+
+      // channels without a source point to the silent block as well, so the blocks are interleaved as they are
+      for (uint32_t d = 0; d < _route.channels; ++d)
+      {
+         const int channel = _route.source[d];
+         const bool audible = (channel != ChannelRoute::SILENT) && (_groupOf[channel] >= 0);
+         const uint8_t* block = audible ? &_planes[channel * BLOCK_FRAMES * _sampleBytes] : _silence.data();
+
+         _devicePlanes16[d] = reinterpret_cast<const int16_t*>(block);
+         _devicePlanes32[d] = reinterpret_cast<const int32_t*>(block);
+      }
+   }
+
+   size_t ChannelRouter::render(void* out, size_t frames)
+   {
+      if (!isValid())
+      {
+         return 0;
+      }
+
+      auto dst = static_cast<uint8_t*>(out);
+      for (size_t done = 0; done < frames; )
+      {
+         const size_t count = std::min(BLOCK_FRAMES, frames - done);
+
+         for (auto& group : _groups)
+         {
+            const size_t rendered = group.source->render(group.block.data(), count, 1);
+            std::fill(group.block.begin() + rendered, group.block.begin() + count, 0.0f);
+         }
+
+         // the gain is the scale of the float -> integer conversion, one kernel call per speaker
+         for (uint32_t c = 0; c < _layout.channels; ++c)
+         {
+            if (_groupOf[c] < 0)
+            {
+               continue;
+            }
+
+            const float* block = _groups[_groupOf[c]].block.data();
+            void* plane = &_planes[c * BLOCK_FRAMES * _sampleBytes];
+            if (_sampleBytes == 2)
+            {
+               kernels::floatToS16(block, static_cast<int16_t*>(plane), count, _gain[c] * 32767.0f);
+            }
+            else
+            {
+               kernels::floatToS32(block, static_cast<int32_t*>(plane), count, _gain[c] * 2147483647.0f);
+            }
+         }
+
+         // the permuted plane pointers put every speaker into its device slot
+         if (_sampleBytes == 2)
+         {
+            kernels::interleave16(_devicePlanes16.data(), reinterpret_cast<int16_t*>(dst), count, _route.channels);
+         }
+         else
+         {
+            kernels::interleave32(_devicePlanes32.data(), reinterpret_cast<int32_t*>(dst), count, _route.channels);
+         }
+
+         dst += count * _route.channels * _sampleBytes;
+         done += count;
+      }
+
+      return frames;
+   }
+}
@@ -0,0 +1,113 @@
+/*
+ *  Channel map aware multichannel output: every speaker (or group of speakers) of a layout has its own
+ *  source and gain instead of one mono signal copied to all the channels.
+ *  applyChannelMap() asks the device for the layout (snd_pcm_set_chmap, or one of the maps listed by
+ *  snd_pcm_query_chmaps) and reads back the order it really plays the channels in. That order becomes
+ *  a permutation of the plane pointers handed to the SIMD interleaver, so the routing costs nothing
+ *  per sample - the renderer has no branch on the channel position at all.
+ */
+
+#pragma once
+
+#include "audioSource.hpp"
+#include <alsa/asoundlib.h>
+#include <array>
+#include <initializer_list>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace audio
+{
+   constexpr uint32_t MAX_MAPPED_CHANNELS = 8;
+
+   struct ChannelLayout
+   {
+      const char*  name;
+      uint32_t     channels;
+      unsigned int positions[MAX_MAPPED_CHANNELS];   /* SND_CHMAP_* in the order of the rendered channels */
+   };
+
+   namespace layouts
+   {
+      const ChannelLayout STEREO { "stereo", 2, { SND_CHMAP_FL, SND_CHMAP_FR } };
+      const ChannelLayout QUAD { "quad", 4, { SND_CHMAP_FL, SND_CHMAP_FR, SND_CHMAP_RL, SND_CHMAP_RR } };
+      const ChannelLayout SURROUND_51 { "5.1", 6, { SND_CHMAP_FL, SND_CHMAP_FR, SND_CHMAP_FC, SND_CHMAP_LFE,
+                                                     SND_CHMAP_RL, SND_CHMAP_RR } };
+      const ChannelLayout SURROUND_71 { "7.1", 8, { SND_CHMAP_FL, SND_CHMAP_FR, SND_CHMAP_FC, SND_CHMAP_LFE,
+                                                     SND_CHMAP_RL, SND_CHMAP_RR, SND_CHMAP_SL, SND_CHMAP_SR } };
+   }
+
+   /* the layout which name starts with the given string (e.g. "5.1") or nullptr */
+   const ChannelLayout* findLayout(const char* name);
+
+   /* the device order: the layout channel each interleaved device channel plays, SILENT when none */
+   struct ChannelRoute
+   {
+      static constexpr int8_t SILENT = -1;
+
+      uint32_t channels = 0;
+      std::array<int8_t, MAX_MAPPED_CHANNELS> source {};
+
+      /* the device plays the channels in the layout order */
+      static ChannelRoute identity(uint32_t channels);
+
+      bool isIdentity() const;
+   };
+
+   /* requests the layout on the open pcm and fills the route from the channel map the device reports       */
+   /* nullptr (offline rendering) and devices without channel maps get the identity - the ALSA order of      */
+   /* the layouts above, which is the WAVE_FORMAT_EXTENSIBLE order as well. Returns 0 or a negative ALSA error */
+   int applyChannelMap(snd_pcm_t* handle, const ChannelLayout& layout, ChannelRoute& route);
+
+   /* "FL FR FC ..." of the route in the device order */
+   void printRoute(const ChannelLayout& layout, const ChannelRoute& route);
+
+   class ChannelRouter
+   {
+   public:
+      static constexpr size_t BLOCK_FRAMES = 256;   /* the sources render and get converted in blocks of this size */
+
+      /* format is the host byte order S16 or S32 the interleaved frames are rendered in */
+      ChannelRouter(const ChannelLayout& layout, snd_pcm_format_t format);
+
+      ChannelRouter(const ChannelRouter&) = delete;
+      ChannelRouter& operator=(const ChannelRouter&) = delete;
+
+      /* one mono source (rendered once per block) for the given speaker positions, each with its own gain */
+      /* returns 0, -EINVAL when a position isn't part of the layout or already has a source */
+      int assign(std::initializer_list<unsigned int> positions, AudioSource* source, float gain = 1.0f);
+
+      /* gain of one speaker position - to be called from the render thread or before it starts */
+      void setGain(unsigned int position, float gain);
+
+      /* the device order from applyChannelMap, precomputes the plane pointers of the interleaver */
+      void setRoute(const ChannelRoute& route);
+
+      /* renders the interleaved frames in the device order - channels without a source stay silent */
+      /* returns frames as the sources are endless or pad their end with silence                      */
+      size_t render(void* out, size_t frames);
+
+      bool isValid() const { return _sampleBytes != 0; }
+
+   private:
+      struct Group
+      {
+         AudioSource* source;
+         std::vector<float> block;      /* the mono render of the source */
+      };
+
+      int channelOf(unsigned int position) const;
+
+      ChannelLayout _layout;
+      size_t _sampleBytes = 0;          /* 2 or 4, 0 when the format isn't supported */
+      std::vector<Group> _groups {};
+      std::array<int, MAX_MAPPED_CHANNELS> _groupOf {};            /* layout channel -> group, -1 without a source */
+      std::array<float, MAX_MAPPED_CHANNELS> _gain {};
+      std::vector<uint8_t> _planes {};                             /* one converted block per layout channel */
+      std::vector<uint8_t> _silence {};
+      ChannelRoute _route {};
+      std::array<const int16_t*, MAX_MAPPED_CHANNELS> _devicePlanes16 {};   /* the blocks in the device order, */
+      std::array<const int32_t*, MAX_MAPPED_CHANNELS> _devicePlanes32 {};   /* the permutation itself          */
+   };
+}
@@ -0,0 +1,375 @@
+#include "deviceCache.hpp"
+#include "pcmOutput.hpp"
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace audio
+{
+   namespace
+   {
+      const char* const CACHE_HEADER = "# alsa-sound-playground device cache v2";
+      const char* const NO_CARD = "-";
+
+      std::string defaultPath()
+      {
+         const char* base = getenv("XDG_CACHE_HOME");
+         std::string dir;
+
+         if ((base != nullptr) && (*base != '\0'))
+         {
+            dir = base;
+         }
+         else if (((base = getenv("HOME")) != nullptr) && (*base != '\0'))
+         {
+            dir = std::string(base) + "/.cache";
+         }
+         else
+         {
+            dir = "/tmp";
+         }
+
+         return dir + "/alsa-sound-playground/devices";
+      }
+
+      /* creates the missing directories of the path, like mkdir -p of its dirname */
+      int makeParentDirs(const std::string& path)
+      {
+         for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1))
+         {
+            if ((mkdir(path.substr(0, pos).c_str(), 0755) < 0) && (errno != EEXIST))
+            {
+               return -errno;
+            }
+         }
+         return 0;
+      }
+
+      bool cardPresent(const CachedDevice& entry)
+      {
+         return (entry.cardId == NO_CARD) || (findCard(entry.cardId) >= 0);
+      }
+   }
+
+   bool CachedDevice::matches(const std::string& stableDevice, const PcmFormat& format) const
+   {
+      return (device == stableDevice) &&
+             (requestedFormat == format.format) &&
+             (requestedAccess == format.access) &&
+             (negotiated.sampleRate == format.sampleRate) &&
+             (negotiated.channels == format.channels) &&
+             (requestedPeriodFrames == format.config.periodFrames) &&
+             (requestedPeriods == format.config.periods);
+   }
+
+   DeviceCache::DeviceCache(const char* path)
+      : _path((path != nullptr) ? path : defaultPath())
+   {
+   }
+
+   int DeviceCache::load()
+   {
+      _entries.clear();
+      _dirty = false;
+
+      FILE* file = fopen(_path.c_str(), "r");
+      if (file == nullptr)
+      {
+         return (errno == ENOENT) ? 0 : -errno;
+      }
+
+      char line[512];
+
+      // the entries of another version (v1 was keyed by the card number) are dropped, not misread
+      if ((fgets(line, sizeof(line), file) == nullptr) || (strncmp(line, CACHE_HEADER, strlen(CACHE_HEADER)) != 0))
+      {
+         fclose(file);
+         return 0;
+      }
+
+      while (fgets(line, sizeof(line), file) != nullptr)
+      {
+         if (line[0] == '#')
+         {
+            continue;
+         }
+
+         CachedDevice entry {};
+         char id[64];
+         int reqFormat, reqAccess, format, access;
+         unsigned long periodFrames, bufferFrames;
+         unsigned long long lastUsed;
+         int deviceOffset = 0;
+
+         const int fields = sscanf(line, "%63s %d %d %u %u %u %u %d %d %lu %u %lu %llu %n",
+                                   id, &reqFormat, &reqAccess,
+                                   &entry.negotiated.sampleRate, &entry.negotiated.channels,
+                                   &entry.requestedPeriodFrames, &entry.requestedPeriods,
+                                   &format, &access, &periodFrames, &entry.negotiated.periods, &bufferFrames,
+                                   &lastUsed, &deviceOffset);
+         if ((fields != 13) || (deviceOffset == 0))
+         {
+            continue; // a damaged line only costs a negotiation
+         }
+
+         entry.cardId = id;
+         entry.device = line + deviceOffset;
+         entry.device.erase(entry.device.find_last_not_of("\r\n") + 1);
+         entry.requestedFormat = static_cast<snd_pcm_format_t>(reqFormat);
+         entry.requestedAccess = static_cast<snd_pcm_access_t>(reqAccess);
+         entry.negotiated.format = static_cast<snd_pcm_format_t>(format);
+         entry.negotiated.access = static_cast<snd_pcm_access_t>(access);
+         entry.negotiated.periodFrames = periodFrames;
+         entry.negotiated.bufferFrames = bufferFrames;
+         entry.lastUsed = lastUsed;
+
+         if (!entry.device.empty() && (_entries.size() < MAX_ENTRIES))
+         {
+            _entries.push_back(std::move(entry));
+         }
+      }
+
+      fclose(file);
+      return static_cast<int>(_entries.size());
+   }
+
+   int DeviceCache::save()
+   {
+      int err;
+
+      if (!_dirty)
+      {
+         return 0;
+      }
+
+      if ((err = makeParentDirs(_path)) < 0)
+      {
+         printf("Cannot create the directory of %s: %s\n", _path.c_str(), strerror(-err));
+         return err;
+      }
+
+      const std::string tmpPath = _path + ".tmp";
+      FILE* file = fopen(tmpPath.c_str(), "w");
+      if (file == nullptr)
+      {
+         err = -errno;
+         printf("Cannot write %s: %s\n", tmpPath.c_str(), strerror(-err));
+         return err;
+      }
+
+      fprintf(file, "%s\n", CACHE_HEADER);
+      for (const auto& entry : _entries)
+      {
+         fprintf(file, "%s %d %d %u %u %u %u %d %d %lu %u %lu %llu %s\n",
+                 entry.cardId.c_str(),
+                 static_cast<int>(entry.requestedFormat), static_cast<int>(entry.requestedAccess),
+                 entry.negotiated.sampleRate, entry.negotiated.channels,
+                 entry.requestedPeriodFrames, entry.requestedPeriods,
+                 static_cast<int>(entry.negotiated.format), static_cast<int>(entry.negotiated.access),
+                 static_cast<unsigned long>(entry.negotiated.periodFrames), entry.negotiated.periods,
+                 static_cast<unsigned long>(entry.negotiated.bufferFrames),
+                 static_cast<unsigned long long>(entry.lastUsed), entry.device.c_str());
+      }
+
+      if ((fclose(file) != 0) || (rename(tmpPath.c_str(), _path.c_str()) < 0))
+      {
+         err = -errno;
+         printf("Cannot write %s: %s\n", _path.c_str(), strerror(-err));
+         unlink(tmpPath.c_str());
+         return err;
+      }
+
+      _dirty = false;
+      return 0;
+   }
+
+   const CachedDevice* DeviceCache::find(const PcmFormat& format) const
+   {
+      const std::string device = stableDeviceName(format.device);
+
+      for (const auto& entry : _entries)
+      {
+         if (entry.matches(device, format))
+         {
+            return cardPresent(entry) ? &entry : nullptr;
+         }
+      }
+      return nullptr;
+   }
+
+   void DeviceCache::remember(const PcmFormat& format, snd_pcm_t* handle, const NegotiatedParams& negotiated)
+   {
+      const int cardIndex = cardIndexOf(handle);
+      const std::string id = (cardIndex < 0) ? NO_CARD : cardId(cardIndex);
+      if (id.empty())
+      {
+         return; // without /proc/asound the card could never be checked again
+      }
+
+      const std::string device = stableDeviceName(format.device);
+      auto entry = std::find_if(_entries.begin(), _entries.end(),
+                                [&](const CachedDevice& e) { return e.matches(device, format); });
+      if (entry == _entries.end())
+      {
+         if (_entries.size() == MAX_ENTRIES)
+         {
+            _entries.erase(std::min_element(_entries.begin(), _entries.end(),
+                           [](const CachedDevice& a, const CachedDevice& b) { return a.lastUsed < b.lastUsed; }));
+         }
+         _entries.emplace_back();
+         entry = _entries.end() - 1;
+      }
+
+      entry->cardId = id;
+      entry->device = device;
+      entry->requestedFormat = format.format;
+      entry->requestedAccess = format.access;
+      entry->requestedPeriodFrames = format.config.periodFrames;
+      entry->requestedPeriods = format.config.periods;
+      entry->negotiated = negotiated;
+      entry->lastUsed = static_cast<uint64_t>(time(nullptr));
+      _dirty = true;
+   }
+
+   void DeviceCache::forget(const PcmFormat& format)
+   {
+      const std::string device = stableDeviceName(format.device);
+      auto entry = std::find_if(_entries.begin(), _entries.end(),
+                                [&](const CachedDevice& e) { return e.matches(device, format); });
+      if (entry != _entries.end())
+      {
+         _entries.erase(entry);
+         _dirty = true;
+      }
+   }
+
+   std::vector<const CachedDevice*> DeviceCache::lastGood() const
+   {
+      std::vector<const CachedDevice*> entries;
+      std::vector<const CachedDevice*> devices;
+
+      for (const auto& entry : _entries)
+      {
+         entries.push_back(&entry);
+      }
+      std::sort(entries.begin(), entries.end(),
+                [](const CachedDevice* a, const CachedDevice* b) { return a->lastUsed > b->lastUsed; });
+
+      // one entry per device - the one of the request used last
+      for (auto entry : entries)
+      {
+         const bool listed = std::any_of(devices.begin(), devices.end(),
+                                         [&](const CachedDevice* d) { return d->device == entry->device; });
+         if (!listed && cardPresent(*entry))
+         {
+            devices.push_back(entry);
+         }
+      }
+      return devices;
+   }
+
+   std::string cardId(int cardIndex)
+   {
+      char path[64];
+      char id[64];
+
+      snprintf(path, sizeof(path), "/proc/asound/card%d/id", cardIndex);
+      FILE* file = (cardIndex >= 0) ? fopen(path, "r") : nullptr;
+      if (file == nullptr)
+      {
+         return "";
+      }
+
+      const bool read = (fscanf(file, "%63s", id) == 1);
+      fclose(file);
+      return read ? id : "";
+   }
+
+   int findCard(const std::string& id)
+   {
+      FILE* file = fopen("/proc/asound/cards", "r");
+      if (file == nullptr)
+      {
+         return -1;
+      }
+
+      // " 0 [PCH            ]: HDA-Intel - HDA Intel PCH" - the second line of a card has no number
+      char line[256];
+      int found = -1;
+      while ((found < 0) && (fgets(line, sizeof(line), file) != nullptr))
+      {
+         int index;
+         char cardName[64];
+         if ((sscanf(line, " %d [%63[^] ]", &index, cardName) == 2) && (id == cardName))
+         {
+            found = index;
+         }
+      }
+
+      fclose(file);
+      return found;
+   }
+
+   std::string stableDeviceName(const char* device)
+   {
+      // only the hw plugins take the card as their first (CARD) argument, followed by DEV and SUBDEV
+      const char* const CARD_PLUGINS[] { "hw:", "plughw:" };
+      const char* const POSITIONAL_ARGS[] { "CARD=", "DEV=", "SUBDEV=" };
+      const std::string name = (device != nullptr) ? device : "";
+
+      for (auto plugin : CARD_PLUGINS)
+      {
+         const size_t length = strlen(plugin);
+         if (name.compare(0, length, plugin) != 0)
+         {
+            continue;
+         }
+
+         const char* number = name.c_str() + length;
+         number += (strncmp(number, "CARD=", 5) == 0) ? 5 : 0;
+
+         char* end;
+         const long card = strtol(number, &end, 10);
+         const std::string id = ((end != number) && ((*end == '\0') || (*end == ','))) ? cardId(static_cast<int>(card)) : "";
+         if (id.empty())
+         {
+            return name; // already named by the ID, or not a card present
+         }
+
+         std::string stable = std::string(plugin) + "CARD=" + id;
+         size_t arg = 1;
+         for (const char* next = end; *next == ','; ++arg)
+         {
+            const char* value = next + 1;
+            next = strchr(value, ',');
+            const std::string token(value, (next != nullptr) ? static_cast<size_t>(next - value) : strlen(value));
+            stable += ",";
+            stable += ((token.find('=') == std::string::npos) && (arg < 3)) ? POSITIONAL_ARGS[arg] + token : token;
+            if (next == nullptr)
+            {
+               break;
+            }
+         }
+         return stable;
+      }
+
+      return name;
+   }
+
+   int cardIndexOf(snd_pcm_t* handle)
+   {
+      snd_pcm_info_t* info;
+
+      snd_pcm_info_alloca(&info);
+      if (snd_pcm_info(handle, info) < 0)
+      {
+         return -1;
+      }
+      return snd_pcm_info_get_card(info);
+   }
+}
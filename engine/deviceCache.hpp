@@ -0,0 +1,87 @@
+/*
+ *  Start-up cache of the devices which were opened successfully before, keyed by the card ID.
+ *  Opening a device the usual way probes the sample formats and searches the period and buffer sizes;
+ *  with a cached entry the formerly negotiated parameters are set right away (applyKnownHwParams).
+ *  The card ID ("PCH", "USB", ... in /proc/asound/cards) stays the same when the card numbers change
+ *  between boots or after a hot plug: "hw:1,0" is stored as "hw:CARD=PCH,DEV=0", so the entry (and the
+ *  name the last good device is reopened with) follows the card to its new number.
+ *  The devices are only enumerated as the last fallback, when neither the requested nor a cached one opens.
+ */
+
+#pragma once
+
+#include "pcmConfig.hpp"
+#include <alsa/asoundlib.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace audio
+{
+   struct PcmFormat;
+
+   struct CachedDevice
+   {
+      std::string      cardId;            /* ID of the card the device ran on, "-" for devices without a card (null, pulse...) */
+      std::string      device;            /* the name the device was opened with, stableDeviceName() of it */
+      snd_pcm_format_t requestedFormat = SND_PCM_FORMAT_UNKNOWN;      /* the request the parameters were negotiated for */
+      snd_pcm_access_t requestedAccess = SND_PCM_ACCESS_RW_INTERLEAVED;
+      uint32_t         requestedPeriodFrames = 0;
+      uint32_t         requestedPeriods = 0;
+      NegotiatedParams negotiated {};     /* the rate and the channels are part of the request as well */
+      uint64_t         lastUsed = 0;      /* seconds since the epoch, orders the last good devices */
+
+      /* stableDevice is stableDeviceName(format.device) */
+      bool matches(const std::string& stableDevice, const PcmFormat& format) const;
+   };
+
+   class DeviceCache
+   {
+   public:
+      static constexpr size_t MAX_ENTRIES = 16;   /* the least recently used entries are dropped beyond that */
+
+      /* nullptr stores the cache in $XDG_CACHE_HOME (or ~/.cache) /alsa-sound-playground/devices */
+      explicit DeviceCache(const char* path = nullptr);
+
+      /* reads the cache file, a missing one is an empty cache - returns the amount of entries or a negative errno */
+      int load();
+
+      /* writes the entries when they changed (through a temporary file, so a killed process leaves the old one) */
+      /* returns 0 or a negative errno */
+      int save();
+
+      /* the entry of format.device and the request which card is still present (under any number), or nullptr */
+      const CachedDevice* find(const PcmFormat& format) const;
+
+      /* stores the negotiated parameters of the opened handle as the last good ones of its card */
+      void remember(const PcmFormat& format, snd_pcm_t* handle, const NegotiatedParams& negotiated);
+
+      /* drops the entry of the device and the request, e.g. after the driver rejected the cached parameters */
+      void forget(const PcmFormat& format);
+
+      /* the devices of the cards still present, the most recently used first */
+      std::vector<const CachedDevice*> lastGood() const;
+
+      const std::string& path() const { return _path; }
+      size_t size() const { return _entries.size(); }
+
+   private:
+      std::string _path {};
+      std::vector<CachedDevice> _entries {};
+      bool _dirty = false;
+   };
+
+   /* the ID of the given card number from /proc/asound/cardN/id - cheaper than opening its control device */
+   /* an empty string when there is no such card */
+   std::string cardId(int cardIndex);
+
+   /* the number the card with the given ID has now (from /proc/asound/cards), -1 when it is not present */
+   int findCard(const std::string& id);
+
+   /* the device name with a card number replaced by the card ID ("plughw:1,0" -> "plughw:CARD=PCH,DEV=0"), */
+   /* names without one (default, pulse, dmix...) or of cards not present are returned as they are         */
+   std::string stableDeviceName(const char* device);
+
+   /* the card number the opened pcm runs on, -1 for devices without a card */
+   int cardIndexOf(snd_pcm_t* handle);
+}
@@ -0,0 +1,57 @@
+#include "deviceList.hpp"
+
+#include <alsa/asoundlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace audio
+{
+   namespace
+   {
+      /* the hint strings are allocated for the caller, NULL when the hint has no such field */
+      std::string takeHint(const void* hint, const char* id)
+      {
+         char* value = snd_device_name_get_hint(hint, id);
+         std::string res = (value != nullptr) ? value : "";
+         free(value);
+         return res;
+      }
+   }
+
+   std::vector<DeviceInfo> listDevices(const char* iface, bool playbackOnly)
+   {
+      std::vector<DeviceInfo> devices;
+      void** hints = nullptr;
+
+      auto err = snd_device_name_hint(-1, iface, &hints);
+      if (err != 0)
+      {
+         printf("Cannot get the device names: %s\n", snd_strerror(err));
+         return devices;
+      }
+
+      for (void** n = hints; *n != nullptr; ++n)
+      {
+         DeviceInfo info { takeHint(*n, "NAME"), takeHint(*n, "DESC"), takeHint(*n, "IOID") };
+
+         if (!playbackOnly || (info.ioid != "Input"))
+         {
+            devices.push_back(std::move(info));
+         }
+      }
+
+      snd_device_name_free_hint(hints);
+      return devices;
+   }
+
+   void printDevices(const std::vector<DeviceInfo>& devices)
+   {
+      for (const auto& device : devices)
+      {
+         printf("Name of device: %s\n", device.name.c_str());
+         printf("Description of device: %s\n", device.description.c_str());
+         printf("I/O type of device: %s\n", device.ioid.empty() ? "Input/Output" : device.ioid.c_str());
+         printf("\n");
+      }
+   }
+}
@@ -0,0 +1,23 @@
+/*
+ *  Enumeration of the ALSA devices through the device name hints (the ones "aplay -L" shows).
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace audio
+{
+   struct DeviceInfo
+   {
+      std::string name;          /* the string to pass as PcmFormat::device */
+      std::string description;
+      std::string ioid;          /* "Input", "Output" or empty for duplex devices */
+   };
+
+   /* the devices of the given interface ("pcm", "rawmidi", ...), capture-only ones are skipped with playbackOnly */
+   std::vector<DeviceInfo> listDevices(const char* iface = "pcm", bool playbackOnly = true);
+
+   void printDevices(const std::vector<DeviceInfo>& devices);
+}
@@ -0,0 +1,80 @@
+#include "dspChain.hpp"
+
+namespace audio
+{
+   namespace dsp
+   {
+      namespace
+      {
+         BiquadCoefficients normalized(double b0, double b1, double b2, double a0, double a1, double a2)
+         {
+            BiquadCoefficients k;
+            k.b0 = static_cast<float>(b0 / a0);
+            k.b1 = static_cast<float>(b1 / a0);
+            k.b2 = static_cast<float>(b2 / a0);
+            k.a1 = static_cast<float>(a1 / a0);
+            k.a2 = static_cast<float>(a2 / a0);
+            return k;
+         }
+
+         inline double omega(double frequency, uint32_t sampleRate)
+         {
+            return 2.0 * M_PI * frequency / sampleRate;
+         }
+      }
+
+      BiquadCoefficients BiquadCoefficients::lowPass(double frequency, double q, uint32_t sampleRate)
+      {
+         const double w = omega(frequency, sampleRate);
+         const double alpha = sin(w) / (2.0 * q);
+         const double cosw = cos(w);
+
+         return normalized((1.0 - cosw) / 2.0, 1.0 - cosw, (1.0 - cosw) / 2.0, 1.0 + alpha, -2.0 * cosw, 1.0 - alpha);
+      }
+
+      BiquadCoefficients BiquadCoefficients::highPass(double frequency, double q, uint32_t sampleRate)
+      {
+         const double w = omega(frequency, sampleRate);
+         const double alpha = sin(w) / (2.0 * q);
+         const double cosw = cos(w);
+
+         return normalized((1.0 + cosw) / 2.0, -(1.0 + cosw), (1.0 + cosw) / 2.0, 1.0 + alpha, -2.0 * cosw, 1.0 - alpha);
+      }
+
+      BiquadCoefficients BiquadCoefficients::peaking(double frequency, double q, double gainDb, uint32_t sampleRate)
+      {
+         const double a = pow(10.0, gainDb / 40.0);
+         const double w = omega(frequency, sampleRate);
+         const double alpha = sin(w) / (2.0 * q);
+         const double cosw = cos(w);
+
+         return normalized(1.0 + alpha * a, -2.0 * cosw, 1.0 - alpha * a, 1.0 + alpha / a, -2.0 * cosw, 1.0 - alpha / a);
+      }
+
+      BiquadCoefficients BiquadCoefficients::lowShelf(double frequency, double q, double gainDb, uint32_t sampleRate)
+      {
+         const double a = pow(10.0, gainDb / 40.0);
+         const double w = omega(frequency, sampleRate);
+         const double alpha = sin(w) / (2.0 * q);
+         const double cosw = cos(w);
+         const double root = 2.0 * sqrt(a) * alpha;
+
+         return normalized(a * ((a + 1.0) - (a - 1.0) * cosw + root), 2.0 * a * ((a - 1.0) - (a + 1.0) * cosw),
+                           a * ((a + 1.0) - (a - 1.0) * cosw - root), (a + 1.0) + (a - 1.0) * cosw + root,
+                           -2.0 * ((a - 1.0) + (a + 1.0) * cosw), (a + 1.0) + (a - 1.0) * cosw - root);
+      }
+
+      BiquadCoefficients BiquadCoefficients::highShelf(double frequency, double q, double gainDb, uint32_t sampleRate)
+      {
+         const double a = pow(10.0, gainDb / 40.0);
+         const double w = omega(frequency, sampleRate);
+         const double alpha = sin(w) / (2.0 * q);
+         const double cosw = cos(w);
+         const double root = 2.0 * sqrt(a) * alpha;
+
+         return normalized(a * ((a + 1.0) + (a - 1.0) * cosw + root), -2.0 * a * ((a - 1.0) + (a + 1.0) * cosw),
+                           a * ((a + 1.0) + (a - 1.0) * cosw - root), (a + 1.0) - (a - 1.0) * cosw + root,
+                           2.0 * ((a - 1.0) - (a + 1.0) * cosw), (a + 1.0) - (a - 1.0) * cosw - root);
+      }
+   }
+}
@@ -0,0 +1,260 @@
+/*
+ *  A block based DSP chain: gain, biquad EQ and limiter nodes followed by the format converter and interleaver.
+ *  Instead of one full pass over the period per step (dampening, then truncation, then endian swap, then channel
+ *  duplication) the period is cut into BLOCK_FRAMES sized blocks and every node runs over a block while it is
+ *  still in L1; the last stage converts, swaps and fans the block out straight into the output buffer.
+ *  The nodes are template arguments and the channel counts and the sample type compile time constants,
+ *  so the per-frame loops of the whole chain are inlined into one function, unrolled and vectorized.
+ */
+
+#pragma once
+
+#include "simdKernels.hpp"
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <tuple>
+#include <utility>
+
+namespace audio
+{
+   namespace dsp
+   {
+      /* transposed direct form II coefficients, normalized to a0 = 1 */
+      struct BiquadCoefficients
+      {
+         float b0 = 1.0f;
+         float b1 = 0.0f;
+         float b2 = 0.0f;
+         float a1 = 0.0f;
+         float a2 = 0.0f;
+
+         /* the filters of the RBJ audio EQ cookbook, frequency in Hz */
+         static BiquadCoefficients lowPass(double frequency, double q, uint32_t sampleRate);
+         static BiquadCoefficients highPass(double frequency, double q, uint32_t sampleRate);
+         static BiquadCoefficients peaking(double frequency, double q, double gainDb, uint32_t sampleRate);
+         static BiquadCoefficients lowShelf(double frequency, double q, double gainDb, uint32_t sampleRate);
+         static BiquadCoefficients highShelf(double frequency, double q, double gainDb, uint32_t sampleRate);
+      };
+
+      /* linear gain, a change is ramped over one block so that it doesn't click */
+      class GainNode
+      {
+      public:
+         explicit GainNode(float gain = 1.0f) : _gain(gain), _target(gain) {}
+
+         void setGain(float gain) { _target = gain; }
+         float gain() const { return _target; }
+
+         template <uint32_t Channels>
+         void process(float* block, size_t frames)
+         {
+            if (_gain == _target)
+            {
+               for (size_t i = 0; i < frames * Channels; ++i)
+               {
+                  block[i] *= _gain;
+               }
+               return;
+            }
+
+            const float step = (_target - _gain) / frames;
+
+            for (size_t f = 0; f < frames; ++f)
+            {
+               const float gain = _gain + step * f;
+               for (uint32_t c = 0; c < Channels; ++c)
+               {
+                  block[f * Channels + c] *= gain;
+               }
+            }
+            _gain = _target;
+         }
+
+      private:
+         float _gain;
+         float _target;
+      };
+
+      /* one biquad section with its own state for each of the Channels */
+      template <uint32_t Channels>
+      class BiquadNode
+      {
+      public:
+         explicit BiquadNode(const BiquadCoefficients& coefficients = {}) : _k(coefficients) {}
+
+         /* takes effect with the next block, the state is kept so that a slowly moving EQ stays smooth */
+         void setCoefficients(const BiquadCoefficients& coefficients) { _k = coefficients; }
+         void reset() { _z1.fill(0.0f); _z2.fill(0.0f); }
+
+         template <uint32_t BlockChannels>
+         void process(float* block, size_t frames)
+         {
+            static_assert(BlockChannels == Channels, "the biquad state doesn't match the channels of the chain");
+
+            for (size_t f = 0; f < frames; ++f)
+            {
+               for (uint32_t c = 0; c < Channels; ++c)
+               {
+                  const float x = block[f * Channels + c];
+                  const float y = _k.b0 * x + _z1[c];
+                  _z1[c] = _k.b1 * x - _k.a1 * y + _z2[c];
+                  _z2[c] = _k.b2 * x - _k.a2 * y;
+                  block[f * Channels + c] = y;
+               }
+            }
+
+            // a decaying recursion ends up in denormals, which are very slow on x86
+            for (uint32_t c = 0; c < Channels; ++c)
+            {
+               _z1[c] = (fabsf(_z1[c]) < 1e-20f) ? 0.0f : _z1[c];
+               _z2[c] = (fabsf(_z2[c]) < 1e-20f) ? 0.0f : _z2[c];
+            }
+         }
+
+      private:
+         BiquadCoefficients _k;
+         std::array<float, Channels> _z1 {};
+         std::array<float, Channels> _z2 {};
+      };
+
+      /* the soft knee of the mixer: linear up to the knee, then bent smoothly towards full scale */
+      class LimiterNode
+      {
+      public:
+         explicit LimiterNode(float knee = 0.9f) : _knee(knee) {}
+
+         template <uint32_t Channels>
+         void process(float* block, size_t frames)
+         {
+            const auto range = 1.0f - _knee;
+
+            // without a branch, so that the loop vectorizes
+            for (size_t i = 0; i < frames * Channels; ++i)
+            {
+               const auto level = fabsf(block[i]);
+               const auto t = std::max(level - _knee, 0.0f) / range;
+               const auto limited = copysignf(_knee + (range * t / (1.0f + t)), block[i]);
+               block[i] = (level > _knee) ? limited : block[i];
+            }
+         }
+
+      private:
+         float _knee;
+      };
+
+      /* saturating conversion of a block through the SIMD kernels and the byte swap of the output sample types */
+      template <typename TSample>
+      struct SampleTraits;
+
+      template <>
+      struct SampleTraits<int16_t>
+      {
+         static void convert(const float* in, int16_t* out, size_t count) { kernels::floatToS16(in, out, count, 32768.0f); }
+         static int16_t swap(int16_t sample) { return static_cast<int16_t>(__builtin_bswap16(static_cast<uint16_t>(sample))); }
+      };
+
+      template <>
+      struct SampleTraits<int32_t>
+      {
+         static void convert(const float* in, int32_t* out, size_t count) { kernels::floatToS32(in, out, count, 2147483648.0f); }
+         static int32_t swap(int32_t sample) { return static_cast<int32_t>(__builtin_bswap32(static_cast<uint32_t>(sample))); }
+      };
+
+      template <>
+      struct SampleTraits<float>
+      {
+         static void convert(const float* in, float* out, size_t count) { memcpy(out, in, count * sizeof(float)); }
+         static float swap(float sample)
+         {
+            uint32_t bits;
+            memcpy(&bits, &sample, sizeof(bits));
+            bits = __builtin_bswap32(bits);
+            memcpy(&sample, &bits, sizeof(bits));
+            return sample;
+         }
+      };
+   }
+
+   /* renderFn(float* block, size_t frames) fills InChannels interleaved float frames, the nodes process them in      */
+   /* place in the given order and the converter writes OutChannels interleaved TSample frames; a mono chain is       */
+   /* duplicated to every output channel, otherwise output channel c takes input channel c % InChannels             */
+   template <uint32_t InChannels, uint32_t OutChannels, typename TSample, typename... TNodes>
+   class DspChain
+   {
+   public:
+      static constexpr size_t BLOCK_FRAMES = 128;   /* 1 kB of stereo floats - every node finds the block in L1 */
+
+      explicit DspChain(TNodes... nodes) : _nodes(std::move(nodes)...) {}
+
+      /* the I-th node, e.g. to change a gain or the EQ while playing (from the render thread) */
+      template <size_t I>
+      auto& node() { return std::get<I>(_nodes); }
+
+      /* swaps the output into the opposite byte order, for devices which only take that (see needsByteSwap) */
+      void setByteSwap(bool swap) { _swap = swap; }
+
+      template <typename TRender>
+      void process(TRender&& renderFn, TSample* out, size_t frames)
+      {
+         for (size_t done = 0; done < frames;)
+         {
+            const size_t count = std::min(BLOCK_FRAMES, frames - done);
+
+            renderFn(_block.data(), count);
+            runNodes(count, std::index_sequence_for<TNodes...> {});
+
+            if (_swap)
+               writeOut<true>(out + done * OutChannels, count);
+            else
+               writeOut<false>(out + done * OutChannels, count);
+
+            done += count;
+         }
+      }
+
+   private:
+      template <size_t... I>
+      void runNodes(size_t frames, std::index_sequence<I...>)
+      {
+         (std::get<I>(_nodes).template process<InChannels>(_block.data(), frames), ...);
+      }
+
+      template <bool Swap>
+      void writeOut(TSample* out, size_t frames)
+      {
+         // converted in the block first, then only integers are shuffled
+         if ((InChannels == OutChannels) && !Swap)
+         {
+            dsp::SampleTraits<TSample>::convert(_block.data(), out, frames * InChannels);
+            return;
+         }
+
+         dsp::SampleTraits<TSample>::convert(_block.data(), _converted.data(), frames * InChannels);
+
+         for (size_t f = 0; f < frames; ++f)
+         {
+            for (uint32_t c = 0; c < OutChannels; ++c)
+            {
+               const auto sample = _converted[f * InChannels + (c % InChannels)];
+               out[f * OutChannels + c] = Swap ? dsp::SampleTraits<TSample>::swap(sample) : sample;
+            }
+         }
+      }
+
+      alignas(64) std::array<float, BLOCK_FRAMES * InChannels> _block {};
+      alignas(64) std::array<TSample, BLOCK_FRAMES * InChannels> _converted {};
+      std::tuple<TNodes...> _nodes;
+      bool _swap = false;
+   };
+
+   /* e.g. auto chain = makeDspChain<1, 2, int16_t>(dsp::GainNode(0.5f), dsp::BiquadNode<1>(eq), dsp::LimiterNode()); */
+   template <uint32_t InChannels, uint32_t OutChannels, typename TSample, typename... TNodes>
+   DspChain<InChannels, OutChannels, TSample, TNodes...> makeDspChain(TNodes... nodes)
+   {
+      return DspChain<InChannels, OutChannels, TSample, TNodes...>(std::move(nodes)...);
+   }
+}
@@ -0,0 +1,194 @@
+#include "fileSink.hpp"
+
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+
+namespace audio
+{
+   namespace
+   {
+      const uint16_t WAVE_FORMAT_PCM = 0x0001;
+      const uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+      const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+      const size_t   WAV_HEADER_BYTES = 44;              /* RIFF, a 16 byte fmt chunk and the data chunk header */
+      const size_t   WAV_EXTENSIBLE_HEADER_BYTES = 68;   /* the same with the 40 byte WAVE_FORMAT_EXTENSIBLE fmt */
+
+      /* the tail of KSDATAFORMAT_SUBTYPE_PCM / _IEEE_FLOAT after the format tag in its first two bytes */
+      const uint8_t SUBFORMAT_GUID_TAIL[14] { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+
+      void putLe(uint8_t* p, uint32_t value, size_t bytes)
+      {
+         for (size_t b = 0; b < bytes; ++b)
+         {
+            p[b] = static_cast<uint8_t>(value >> (8 * b));
+         }
+      }
+
+      bool wavFormat(snd_pcm_format_t format)
+      {
+         return (format == SND_PCM_FORMAT_S16_LE) || (format == SND_PCM_FORMAT_S24_3LE) ||
+                (format == SND_PCM_FORMAT_S32_LE) || (format == SND_PCM_FORMAT_FLOAT_LE);
+      }
+
+      /* dwChannelMask of the layouts in channelMap.hpp - their ALSA channel order is the WAVE order, */
+      /* so FL FR FC LFE BL BR SL SR map to the bits 0x1 0x2 0x4 0x8 0x10 0x20 0x200 0x400          */
+      uint32_t channelMask(uint32_t channels)
+      {
+         switch (channels)
+         {
+            case 1:  return 0x004;
+            case 2:  return 0x003;
+            case 4:  return 0x033;
+            case 6:  return 0x03F;
+            case 8:  return 0x63F;
+            default: return 0;      /* no speaker assignment */
+         }
+      }
+   }
+
+   FileSink::~FileSink()
+   {
+      close();
+   }
+
+   FileContainer FileSink::containerFor(const char* path)
+   {
+      const auto length = strlen(path);
+      return ((length >= 4) && (strcasecmp(path + length - 4, ".wav") == 0)) ? FileContainer::Wav : FileContainer::Raw;
+   }
+
+   int FileSink::open(const char* path, snd_pcm_format_t format, uint32_t sampleRate, uint32_t channels, FileContainer container)
+   {
+      close();
+
+      const auto width = snd_pcm_format_physical_width(format);
+      if ((width <= 0) || (channels == 0) || ((container == FileContainer::Wav) && !wavFormat(format)))
+      {
+         printf("Cannot write %s samples to %s\n", snd_pcm_format_name(format), path);
+         return -EINVAL;
+      }
+
+      _file = fopen(path, "wb");
+      if (_file == nullptr)
+      {
+         const int err = -errno;
+         printf("Cannot create the file %s: %s\n", path, strerror(-err));
+         return err;
+      }
+
+      // one big buffer - the render loop turns into a few large write() calls
+      _buffer.reset(new char[WRITE_BUFFER_BYTES]);
+      setvbuf(_file, _buffer.get(), _IOFBF, WRITE_BUFFER_BYTES);
+
+      _container = container;
+      _format = format;
+      _sampleRate = sampleRate;
+      _channels = channels;
+      _frameBytes = (static_cast<size_t>(width) / 8) * channels;
+      _frames = 0;
+
+      if (container == FileContainer::Wav)
+      {
+         return writeWavHeader();
+      }
+
+      return 0;
+   }
+
+   int FileSink::writeWavHeader()
+   {
+      // more than 2 channels or more than 16 bits need WAVE_FORMAT_EXTENSIBLE for the speaker mask and the valid bits
+      const auto sampleBytes = static_cast<uint32_t>(_frameBytes / _channels);
+      const bool extensible = (_channels > 2) || (sampleBytes > 2);
+      const size_t headerBytes = extensible ? WAV_EXTENSIBLE_HEADER_BYTES : WAV_HEADER_BYTES;
+      const uint16_t formatTag = (_format == SND_PCM_FORMAT_FLOAT_LE) ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+
+      // sizes above 4 GB can't be expressed, the data chunk is then marked as running to the end of the file;
+      // an odd sized data chunk is followed by a pad byte (close() writes it), which the RIFF size counts
+      const uint64_t dataBytes = _frames * _frameBytes;
+      const uint32_t dataSize = (dataBytes > 0xFFFFFFFFu - headerBytes - 1) ? 0xFFFFFFFFu : static_cast<uint32_t>(dataBytes);
+      const uint32_t riffSize = (dataSize == 0xFFFFFFFFu) ? 0xFFFFFFFFu : dataSize + (dataSize & 1) + headerBytes - 8;
+
+      uint8_t header[WAV_EXTENSIBLE_HEADER_BYTES];
+      memcpy(header, "RIFF", 4);
+      putLe(header + 4, riffSize, 4);
+      memcpy(header + 8, "WAVEfmt ", 8);
+      putLe(header + 16, extensible ? 40 : 16, 4);
+      putLe(header + 20, extensible ? WAVE_FORMAT_EXTENSIBLE : formatTag, 2);
+      putLe(header + 22, _channels, 2);
+      putLe(header + 24, _sampleRate, 4);
+      putLe(header + 28, _sampleRate * static_cast<uint32_t>(_frameBytes), 4);
+      putLe(header + 32, static_cast<uint32_t>(_frameBytes), 2);
+      putLe(header + 34, sampleBytes * 8, 2);
+
+      if (extensible)
+      {
+         putLe(header + 36, 22, 2);                    /* cbSize */
+         putLe(header + 38, sampleBytes * 8, 2);       /* wValidBitsPerSample - every container bit is used */
+         putLe(header + 40, channelMask(_channels), 4);
+         putLe(header + 44, formatTag, 2);
+         memcpy(header + 46, SUBFORMAT_GUID_TAIL, sizeof(SUBFORMAT_GUID_TAIL));
+      }
+
+      memcpy(header + headerBytes - 8, "data", 4);
+      putLe(header + headerBytes - 4, dataSize, 4);
+
+      if (fwrite(header, headerBytes, 1, _file) != 1)
+      {
+         printf("Cannot write the WAV header: %s\n", strerror(errno));
+         return -EIO;
+      }
+
+      return 0;
+   }
+
+   int FileSink::write(const void* frames, size_t count)
+   {
+      if (_file == nullptr)
+      {
+         return -EBADF;
+      }
+
+      if (fwrite(frames, _frameBytes, count, _file) != count)
+      {
+         printf("Cannot write to the render file: %s\n", strerror(errno));
+         return -EIO;
+      }
+
+      _frames += count;
+      return 0;
+   }
+
+   int FileSink::close()
+   {
+      if (_file == nullptr)
+      {
+         return 0;
+      }
+
+      int err = 0;
+
+      if (_container == FileContainer::Wav)
+      {
+         // RIFF chunks are word aligned - S24_3LE with an odd channel count can end on an odd byte
+         const bool pad = ((_frames * _frameBytes) & 1) != 0;
+
+         if ((pad && (fputc(0, _file) == EOF)) || (fseek(_file, 0, SEEK_SET) != 0) || (writeWavHeader() < 0))
+         {
+            err = -EIO;
+         }
+      }
+
+      // a failed header write is the first error, fclose only reports when everything before went fine
+      const int closeErr = (fclose(_file) == 0) ? 0 : -errno;
+      if (err == 0)
+      {
+         err = closeErr;
+      }
+
+      _file = nullptr;
+      _buffer.reset();
+      return err;
+   }
+}
@@ -0,0 +1,60 @@
+/*
+ *  WAV / raw PCM file writer - the sink of the offline render mode of PcmOutput.
+ *  Frames are appended through a large stdio buffer; the WAV header is written up front and its sizes
+ *  are patched on close, so a render of any length needs no second pass.
+ */
+
+#pragma once
+
+#include <alsa/asoundlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <memory>
+
+namespace audio
+{
+   enum class FileContainer
+   {
+      Wav,      /* S16_LE, S24_3LE, S32_LE or FLOAT_LE samples with a RIFF header (WAVE_FORMAT_EXTENSIBLE above 2 channels or 16 bits) */
+      Raw       /* the bare samples in any format */
+   };
+
+   class FileSink
+   {
+   public:
+      static constexpr size_t WRITE_BUFFER_BYTES = 1024 * 1024;
+
+      FileSink() = default;
+      ~FileSink();
+      FileSink(const FileSink&) = delete;
+      FileSink& operator=(const FileSink&) = delete;
+
+      /* a ".wav" path (case insensitive) selects the WAV container, anything else is raw */
+      static FileContainer containerFor(const char* path);
+
+      /* creates (truncates) the file, returns 0 or a negative errno code */
+      int open(const char* path, snd_pcm_format_t format, uint32_t sampleRate, uint32_t channels, FileContainer container);
+
+      /* appends interleaved frames, returns 0 or a negative errno code */
+      int write(const void* frames, size_t count);
+
+      /* completes the WAV header and closes the file */
+      int close();
+
+      bool isOpen() const { return _file != nullptr; }
+      uint64_t framesWritten() const { return _frames; }
+
+   private:
+      int writeWavHeader();
+
+      FILE*            _file = nullptr;
+      std::unique_ptr<char[]> _buffer {};
+      FileContainer    _container = FileContainer::Raw;
+      snd_pcm_format_t _format = SND_PCM_FORMAT_UNKNOWN;
+      uint32_t         _sampleRate = 0;
+      uint32_t         _channels = 0;
+      size_t           _frameBytes = 0;
+      uint64_t         _frames = 0;
+   };
+}
@@ -0,0 +1,418 @@
+#include "fileSource.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+namespace audio
+{
+   namespace
+   {
+      const uint16_t WAVE_FORMAT_PCM = 0x0001;
+      const uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+      const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+      uint32_t readLe(const uint8_t* p, size_t bytes)
+      {
+         uint32_t v = 0;
+         for (size_t b = bytes; b-- > 0;)
+         {
+            v = (v << 8) | p[b];
+         }
+         return v;
+      }
+
+      uint32_t readBe(const uint8_t* p, size_t bytes)
+      {
+         uint32_t v = 0;
+         for (size_t b = 0; b < bytes; ++b)
+         {
+            v = (v << 8) | p[b];
+         }
+         return v;
+      }
+
+      uint64_t readLe64(const uint8_t* p)
+      {
+         return static_cast<uint64_t>(readLe(p, 4)) | (static_cast<uint64_t>(readLe(p + 4, 4)) << 32);
+      }
+
+      size_t pageSize()
+      {
+         static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+         return size;
+      }
+
+      size_t pageDown(size_t offset) { return offset & ~(pageSize() - 1); }
+
+      /* one sample of any of the supported file formats as -1.0 .. 1.0 */
+      float sampleToFloat(const uint8_t* p, snd_pcm_format_t format)
+      {
+         switch (format)
+         {
+            case SND_PCM_FORMAT_S16_LE:  return static_cast<int16_t>(readLe(p, 2)) / 32768.0f;
+            case SND_PCM_FORMAT_S16_BE:  return static_cast<int16_t>(readBe(p, 2)) / 32768.0f;
+            case SND_PCM_FORMAT_S24_3LE: return static_cast<int32_t>(readLe(p, 3) << 8) / 2147483648.0f;
+            case SND_PCM_FORMAT_S24_3BE: return static_cast<int32_t>(readBe(p, 3) << 8) / 2147483648.0f;
+            case SND_PCM_FORMAT_S24_LE:  return static_cast<int32_t>(readLe(p, 4) << 8) / 2147483648.0f;
+            case SND_PCM_FORMAT_S24_BE:  return static_cast<int32_t>(readBe(p, 4) << 8) / 2147483648.0f;
+            case SND_PCM_FORMAT_S32_LE:  return static_cast<int32_t>(readLe(p, 4)) / 2147483648.0f;
+            case SND_PCM_FORMAT_S32_BE:  return static_cast<int32_t>(readBe(p, 4)) / 2147483648.0f;
+            case SND_PCM_FORMAT_FLOAT_LE:
+            case SND_PCM_FORMAT_FLOAT_BE:
+            {
+               const auto bits = (format == SND_PCM_FORMAT_FLOAT_LE) ? readLe(p, 4) : readBe(p, 4);
+               float v;
+               memcpy(&v, &bits, sizeof(v));
+               return v;
+            }
+            default:
+               return 0.0f;
+         }
+      }
+
+      bool floatRenderable(snd_pcm_format_t format)
+      {
+         switch (format)
+         {
+            case SND_PCM_FORMAT_S16_LE: case SND_PCM_FORMAT_S16_BE:
+            case SND_PCM_FORMAT_S24_3LE: case SND_PCM_FORMAT_S24_3BE:
+            case SND_PCM_FORMAT_S24_LE: case SND_PCM_FORMAT_S24_BE:
+            case SND_PCM_FORMAT_S32_LE: case SND_PCM_FORMAT_S32_BE:
+            case SND_PCM_FORMAT_FLOAT_LE: case SND_PCM_FORMAT_FLOAT_BE:
+               return true;
+            default:
+               return false;
+         }
+      }
+   }
+
+   FileSource::~FileSource()
+   {
+      close();
+   }
+
+   int FileSource::mapFile(const char* path)
+   {
+      close();
+
+      _fd = ::open(path, O_RDONLY | O_CLOEXEC);
+      if (_fd < 0)
+      {
+         printf("Cannot open the file %s: %s\n", path, strerror(errno));
+         return -errno;
+      }
+
+      struct stat st;
+      if ((fstat(_fd, &st) < 0) || (st.st_size == 0))
+      {
+         printf("Cannot stat the file %s or it is empty\n", path);
+         close();
+         return -EINVAL;
+      }
+
+      void* map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, _fd, 0);
+      if (map == MAP_FAILED)
+      {
+         const auto err = -errno;
+         printf("Cannot map the file %s: %s\n", path, strerror(errno));
+         close();
+         return err;
+      }
+
+      _map = static_cast<uint8_t*>(map);
+      _mapSize = static_cast<size_t>(st.st_size);
+
+      // the kernel reads ahead more aggressively and frees the played pages sooner
+      madvise(_map, _mapSize, MADV_SEQUENTIAL);
+      return 0;
+   }
+
+   int FileSource::openWav(const char* path)
+   {
+      auto err = mapFile(path);
+      if (err < 0)
+      {
+         return err;
+      }
+
+      err = parseWav();
+      if (err < 0)
+      {
+         printf("%s is not a supported WAV file\n", path);
+         close();
+         return err;
+      }
+
+      seek(0);
+      return 0;
+   }
+
+   int FileSource::openRaw(const char* path, const FileInfo& info)
+   {
+      const auto width = snd_pcm_format_physical_width(info.format);
+      if ((width <= 0) || (info.channels == 0) || !floatRenderable(info.format))
+      {
+         printf("Unsupported raw format %s\n", snd_pcm_format_name(info.format));
+         return -EINVAL;
+      }
+
+      auto err = mapFile(path);
+      if (err < 0)
+      {
+         return err;
+      }
+
+      _info = info;
+      _frameBytes = (static_cast<size_t>(width) / 8) * info.channels;
+      _info.frames = _mapSize / _frameBytes;
+      _data = _map;
+
+      seek(0);
+      return 0;
+   }
+
+   int FileSource::parseWav()
+   {
+      if ((_mapSize < 12) || ((memcmp(_map, "RIFF", 4) != 0) && (memcmp(_map, "RF64", 4) != 0)) || (memcmp(_map + 8, "WAVE", 4) != 0))
+      {
+         return -EINVAL;
+      }
+
+      uint64_t ds64DataSize = 0;     /* RF64 keeps the real sizes of files above 4 GB in the ds64 chunk */
+      uint16_t formatTag = 0;
+      uint32_t blockAlign = 0;
+      size_t offset = 12;
+
+      while (offset + 8 <= _mapSize)
+      {
+         const auto* chunk = _map + offset;
+         const auto* body = chunk + 8;
+         uint64_t size = readLe(chunk + 4, 4);
+
+         if ((memcmp(chunk, "ds64", 4) == 0) && (size >= 24) && (offset + 8 + 24 <= _mapSize))
+         {
+            ds64DataSize = readLe64(body + 8);
+         }
+         else if ((memcmp(chunk, "fmt ", 4) == 0) && (size >= 16) && (offset + 8 + size <= _mapSize))
+         {
+            formatTag = static_cast<uint16_t>(readLe(body, 2));
+            _info.channels = readLe(body + 2, 2);
+            _info.sampleRate = readLe(body + 4, 4);
+            blockAlign = readLe(body + 12, 2);
+
+            if ((formatTag == WAVE_FORMAT_EXTENSIBLE) && (size >= 40))
+            {
+               formatTag = static_cast<uint16_t>(readLe(body + 24, 2));   /* first two bytes of the sub format GUID */
+            }
+         }
+         else if (memcmp(chunk, "data", 4) == 0)
+         {
+            if ((size == 0xFFFFFFFFu) && (ds64DataSize != 0))
+            {
+               size = ds64DataSize;
+            }
+
+            // captures which were cut short (or never had the size patched) play up to the end of the file
+            _data = body;
+            size = std::min<uint64_t>(size, _mapSize - (offset + 8));
+            _info.frames = ((_info.channels != 0) && (blockAlign != 0)) ? static_cast<size_t>(size / blockAlign) : 0;
+            break;
+         }
+
+         offset += 8 + size + (size & 1);    /* chunks are padded to an even size */
+      }
+
+      if ((_data == nullptr) || (_info.channels == 0) || (blockAlign % _info.channels != 0))
+      {
+         return -EINVAL;
+      }
+
+      // the samples are little endian and left justified, so 24 bit in a 32 bit container is simply S32
+      const auto container = blockAlign / _info.channels;
+      if ((formatTag == WAVE_FORMAT_PCM) && (container == 2))
+      {
+         _info.format = SND_PCM_FORMAT_S16_LE;
+      }
+      else if ((formatTag == WAVE_FORMAT_PCM) && (container == 3))
+      {
+         _info.format = SND_PCM_FORMAT_S24_3LE;
+      }
+      else if ((formatTag == WAVE_FORMAT_PCM) && (container == 4))
+      {
+         _info.format = SND_PCM_FORMAT_S32_LE;
+      }
+      else if ((formatTag == WAVE_FORMAT_IEEE_FLOAT) && (container == 4))
+      {
+         _info.format = SND_PCM_FORMAT_FLOAT_LE;
+      }
+      else
+      {
+         return -EINVAL;
+      }
+
+      _frameBytes = blockAlign;
+      return 0;
+   }
+
+   void FileSource::close()
+   {
+      if (_map != nullptr)
+      {
+         munmap(_map, _mapSize);
+      }
+
+      if (_fd >= 0)
+      {
+         ::close(_fd);
+      }
+
+      _fd = -1;
+      _map = nullptr;
+      _mapSize = 0;
+      _data = nullptr;
+      _info = FileInfo {};
+      _frameBytes = 0;
+      _position = 0;
+      _outputFormat = SND_PCM_FORMAT_UNKNOWN;
+      _converter.reset();
+   }
+
+   void FileSource::seek(size_t frame)
+   {
+      _position = std::min(frame, _info.frames);
+
+      const auto byteOffset = pageDown(static_cast<size_t>(_data - _map) + (_position * _frameBytes));
+      _prefetchedUpTo = byteOffset;
+      _droppedUpTo = byteOffset;
+      readAhead();
+   }
+
+   void FileSource::readAhead()
+   {
+      if (_map == nullptr)
+      {
+         return;
+      }
+
+      const auto current = static_cast<size_t>(_data - _map) + (_position * _frameBytes);
+
+      // the next window is requested once half of the previous one was played
+      if ((current + (READ_AHEAD_BYTES / 2) >= _prefetchedUpTo) && (_prefetchedUpTo < _mapSize))
+      {
+         const auto end = std::min(_mapSize, pageDown(current) + READ_AHEAD_BYTES);
+         madvise(_map + _prefetchedUpTo, end - _prefetchedUpTo, MADV_WILLNEED);
+         _prefetchedUpTo = end;
+      }
+
+      // the pages behind the position are not needed anymore, the mapping is private and read-only so they can be dropped
+      const auto played = pageDown(current);
+      if (played >= _droppedUpTo + READ_AHEAD_BYTES)
+      {
+         madvise(_map + _droppedUpTo, played - _droppedUpTo, MADV_DONTNEED);
+         _droppedUpTo = played;
+      }
+   }
+
+   int FileSource::setOutputFormat(snd_pcm_format_t format, const ConversionOptions& options)
+   {
+      _outputFormat = format;
+      _converter.reset();
+
+      if (format == _info.format)
+      {
+         return 0;
+      }
+
+      if (!BitDepthConverter::supportedInput(_info.format) || !BitDepthConverter::supportedOutput(format))
+      {
+         printf("Cannot convert %s to %s\n", snd_pcm_format_name(_info.format), snd_pcm_format_name(format));
+         return -EINVAL;
+      }
+
+      _converter.reset(new BitDepthConverter(_info.format, format, _info.channels, options));
+      return 0;
+   }
+
+   const void* FileSource::peek(size_t& frames) const
+   {
+      frames = std::min(frames, remaining());
+      return _data + (_position * _frameBytes);
+   }
+
+   void FileSource::advance(size_t frames)
+   {
+      _position += std::min(frames, remaining());
+
+      if ((_position == _info.frames) && _loop)
+      {
+         seek(0);
+      }
+      else
+      {
+         readAhead();
+      }
+   }
+
+   size_t FileSource::readInto(void* out, size_t frames)
+   {
+      const auto outFormat = (_outputFormat == SND_PCM_FORMAT_UNKNOWN) ? _info.format : _outputFormat;
+      const auto outFrameBytes = needsConversion() ? (snd_pcm_format_physical_width(outFormat) / 8) * _info.channels : _frameBytes;
+      auto* dest = static_cast<uint8_t*>(out);
+      size_t done = 0;
+
+      while ((done < frames) && (remaining() > 0))
+      {
+         auto chunk = frames - done;
+         const auto* src = peek(chunk);
+
+         if (needsConversion())
+         {
+            _converter->process(src, dest, chunk);
+         }
+         else
+         {
+            memcpy(dest, src, chunk * _frameBytes);
+         }
+
+         dest += chunk * outFrameBytes;
+         done += chunk;
+         advance(chunk);
+      }
+
+      return done;
+   }
+
+   size_t FileSource::render(float* out, size_t frames, uint32_t channels)
+   {
+      const auto sampleBytes = _frameBytes / std::max<uint32_t>(_info.channels, 1);
+      size_t done = 0;
+
+      while ((done < frames) && (remaining() > 0))
+      {
+         auto chunk = frames - done;
+         const auto* src = static_cast<const uint8_t*>(peek(chunk));
+
+         for (size_t f = 0; f < chunk; ++f, src += _frameBytes)
+         {
+            auto* frame = out + ((done + f) * channels);
+            for (uint32_t c = 0; c < channels; ++c)
+            {
+               // mono is spread over every channel, surplus output channels stay silent
+               const auto srcChannel = (_info.channels == 1) ? 0 : c;
+               frame[c] = (srcChannel < _info.channels) ? sampleToFloat(src + (srcChannel * sampleBytes), _info.format) : 0.0f;
+            }
+         }
+
+         done += chunk;
+         advance(chunk);
+      }
+
+      return done;
+   }
+}
@@ -0,0 +1,90 @@
+/*
+ *  WAV / raw PCM file source.
+ *  The file is memory mapped read-only and the header parsed once, afterwards periods are handed out
+ *  straight from the mapping - either as a pointer for snd_pcm_writei (no copy in user space) or copied,
+ *  and only when the formats differ converted, into a render area such as the mmap area of the device.
+ *  The mapping is advised MADV_SEQUENTIAL and the next window is prefetched (MADV_WILLNEED) while already
+ *  played pages are dropped, so multi-GB captures play with a small resident set.
+ *  Supports PCM / float WAV (including WAVE_FORMAT_EXTENSIBLE and RF64) and headerless raw files.
+ */
+
+#pragma once
+
+#include "audioSource.hpp"
+#include "bitDepthConv.hpp"
+#include <alsa/asoundlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+
+namespace audio
+{
+   struct FileInfo
+   {
+      snd_pcm_format_t format = SND_PCM_FORMAT_UNKNOWN;   /* exact format of the samples in the file */
+      uint32_t sampleRate = 0;
+      uint32_t channels = 0;
+      size_t   frames = 0;
+   };
+
+   class FileSource : public AudioSource
+   {
+   public:
+      static constexpr size_t READ_AHEAD_BYTES = 2 * 1024 * 1024;   /* prefetched window in front of the position */
+
+      FileSource() = default;
+      ~FileSource();
+      FileSource(const FileSource&) = delete;
+      FileSource& operator=(const FileSource&) = delete;
+
+      /* parses the WAV header, returns a negative errno code on failure */
+      int openWav(const char* path);
+
+      /* a headerless file, the whole file is sample data described by info (frames is computed) */
+      int openRaw(const char* path, const FileInfo& info);
+
+      void close();
+      bool isOpen() const { return _map != nullptr; }
+
+      const FileInfo& info() const { return _info; }
+      size_t frameBytes() const { return _frameBytes; }
+      size_t position() const { return _position; }
+      size_t remaining() const { return _info.frames - _position; }
+
+      /* restarts at the beginning when the end is reached instead of finishing */
+      void setLoop(bool loop) { _loop = loop; }
+      void seek(size_t frame);
+
+      /* the format readInto() has to produce - a converter is only set up when it differs from the file */
+      int setOutputFormat(snd_pcm_format_t format, const ConversionOptions& options = {});
+      bool needsConversion() const { return _converter != nullptr; }
+
+      /* zero copy access: up to frames contiguous frames of the file at the position, then advance() */
+      const void* peek(size_t& frames) const;
+      void advance(size_t frames);
+
+      /* copies (or converts) up to frames into out, returns the amount of frames - less only at the end */
+      size_t readInto(void* out, size_t frames);
+
+      /* float rendering for the mixer, mono files are spread over all the channels */
+      size_t render(float* out, size_t frames, uint32_t channels) override;
+
+   private:
+      int mapFile(const char* path);
+      int parseWav();
+      void readAhead();
+
+      int      _fd = -1;
+      uint8_t* _map = nullptr;
+      size_t   _mapSize = 0;
+      const uint8_t* _data = nullptr;   /* first sample frame inside the mapping */
+      FileInfo _info {};
+      size_t   _frameBytes = 0;
+      size_t   _position = 0;
+      size_t   _prefetchedUpTo = 0;     /* byte offset up to which the read-ahead was issued */
+      size_t   _droppedUpTo = 0;        /* byte offset below which the pages were released */
+      bool     _loop = false;
+      snd_pcm_format_t _outputFormat = SND_PCM_FORMAT_UNKNOWN;
+      std::unique_ptr<BitDepthConverter> _converter {};
+   };
+}
@@ -0,0 +1,54 @@
+#include "framePool.hpp"
+
+#include <errno.h>
+#include <string.h>
+
+namespace audio
+{
+   int FramePool::init(uint32_t bufferCount, size_t frames, size_t frameBytes)
+   {
+      if ((bufferCount == 0) || (bufferCount > MAX_BUFFERS) || (frames == 0) || (frameBytes == 0))
+      {
+         return -EINVAL;
+      }
+
+      _frames = frames;
+      _bufferBytes = ((frames * frameBytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE) * CACHE_LINE_SIZE;
+      _count = bufferCount;
+      _slab.reset(new (std::align_val_t(CACHE_LINE_SIZE)) uint8_t[_bufferBytes * bufferCount]);
+
+      // touching every page now keeps the page faults out of the render path
+      memset(_slab.get(), 0, _bufferBytes * bufferCount);
+
+      _freeMask.store((bufferCount == MAX_BUFFERS) ? ~uint64_t(0) : ((uint64_t(1) << bufferCount) - 1), std::memory_order_release);
+
+      return 0;
+   }
+
+   FramePool::Buffer FramePool::acquire()
+   {
+      auto mask = _freeMask.load(std::memory_order_acquire);
+
+      while (mask != 0)
+      {
+         const auto index = static_cast<uint32_t>(__builtin_ctzll(mask));
+
+         if (_freeMask.compare_exchange_weak(mask, mask & ~(uint64_t(1) << index), std::memory_order_acq_rel))
+         {
+            return Buffer(this, _slab.get() + (index * _bufferBytes), index);
+         }
+      }
+
+      return Buffer();
+   }
+
+   void FramePool::release(uint32_t index)
+   {
+      _freeMask.fetch_or(uint64_t(1) << index, std::memory_order_release);
+   }
+
+   uint32_t FramePool::available() const
+   {
+      return static_cast<uint32_t>(__builtin_popcountll(_freeMask.load(std::memory_order_relaxed)));
+   }
+}
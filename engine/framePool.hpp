@@ -0,0 +1,101 @@
+/*
+ *  Preallocated pool of fixed size period buffers for the render path.
+ *  All buffers live in one cache line aligned slab that is allocated (and touched) once at start-up;
+ *  afterwards buffers are only borrowed and returned, so rendering never goes to the heap.
+ *  The pool is lock-free, a buffer may be returned from another thread than the one which borrowed it.
+ */
+
+#pragma once
+
+#include "spscRing.hpp"   // CACHE_LINE_SIZE
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+
+namespace audio
+{
+   class FramePool
+   {
+   public:
+      static constexpr uint32_t MAX_BUFFERS = 64;   /* one bit of the free mask per buffer */
+
+      /* a borrowed buffer - goes back to the pool when destroyed */
+      class Buffer
+      {
+      public:
+         Buffer() = default;
+         Buffer(Buffer&& other) noexcept { *this = std::move(other); }
+         Buffer& operator=(Buffer&& other) noexcept
+         {
+            reset();
+            _pool = other._pool;
+            _data = other._data;
+            _index = other._index;
+            other._pool = nullptr;
+            other._data = nullptr;
+            return *this;
+         }
+         ~Buffer() { reset(); }
+
+         Buffer(const Buffer&) = delete;
+         Buffer& operator=(const Buffer&) = delete;
+
+         explicit operator bool() const { return _data != nullptr; }
+         void* data() const { return _data; }
+
+         template <typename T>
+         T* as() const { return static_cast<T*>(_data); }
+
+         /* returns the buffer to its pool before the destruction */
+         void reset()
+         {
+            if (_pool != nullptr)
+            {
+               _pool->release(_index);
+               _pool = nullptr;
+               _data = nullptr;
+            }
+         }
+
+      private:
+         friend class FramePool;
+         Buffer(FramePool* pool, void* data, uint32_t index) : _pool(pool), _data(data), _index(index) {}
+
+         FramePool* _pool = nullptr;
+         void*      _data = nullptr;
+         uint32_t   _index = 0;
+      };
+
+      FramePool() = default;
+      FramePool(uint32_t bufferCount, size_t frames, size_t frameBytes) { init(bufferCount, frames, frameBytes); }
+
+      FramePool(const FramePool&) = delete;
+      FramePool& operator=(const FramePool&) = delete;
+
+      /* (re)allocates the slab - must not be called while buffers are borrowed, returns 0 or -EINVAL */
+      int init(uint32_t bufferCount, size_t frames, size_t frameBytes);
+
+      /* an empty Buffer when all of them are borrowed */
+      Buffer acquire();
+
+      size_t frames() const { return _frames; }
+      size_t bufferBytes() const { return _bufferBytes; }
+      uint32_t bufferCount() const { return _count; }
+      uint32_t available() const;
+
+   private:
+      struct AlignedDelete
+      {
+         void operator()(uint8_t* ptr) const { operator delete[](ptr, std::align_val_t(CACHE_LINE_SIZE)); }
+      };
+
+      void release(uint32_t index);
+
+      std::unique_ptr<uint8_t[], AlignedDelete> _slab {};
+      size_t   _frames = 0;
+      size_t   _bufferBytes = 0;   /* rounded up to whole cache lines */
+      uint32_t _count = 0;
+      std::atomic<uint64_t> _freeMask { 0 };
+   };
+}
@@ -0,0 +1,85 @@
+#include "frameRenderer.hpp"
+
+namespace audio
+{
+   namespace
+   {
+      using RenderFrameFn = void (*)(const int16_t*, uint32_t, uint32_t&, void*);
+      using RenderFramesFn = void (*)(const int16_t*, uint32_t, uint32_t&, void*, size_t, uint32_t);
+
+      struct Specialization
+      {
+         snd_pcm_format_t format;
+         uint32_t         channels;
+         uint32_t         frameSize;
+         RenderFrameFn    render;
+      };
+
+      struct GenericLoop
+      {
+         snd_pcm_format_t format;
+         RenderFramesFn   render;
+      };
+
+#define FRAME_SPECIALIZATIONS(FORMAT) \
+         { FORMAT, 1, 256, &renderLoopFrame<FORMAT, 1, 256> }, \
+         { FORMAT, 1, 1152, &renderLoopFrame<FORMAT, 1, 1152> }, \
+         { FORMAT, 2, 256, &renderLoopFrame<FORMAT, 2, 256> }, \
+         { FORMAT, 2, 1152, &renderLoopFrame<FORMAT, 2, 1152> }, \
+         { FORMAT, 6, 256, &renderLoopFrame<FORMAT, 6, 256> }, \
+         { FORMAT, 6, 1152, &renderLoopFrame<FORMAT, 6, 1152> }, \
+         { FORMAT, 8, 256, &renderLoopFrame<FORMAT, 8, 256> }, \
+         { FORMAT, 8, 1152, &renderLoopFrame<FORMAT, 8, 1152> }
+
+      const Specialization SPECIALIZATIONS[] =
+      {
+         FRAME_SPECIALIZATIONS(SND_PCM_FORMAT_S16_LE),
+         FRAME_SPECIALIZATIONS(SND_PCM_FORMAT_S16_BE),
+         FRAME_SPECIALIZATIONS(SND_PCM_FORMAT_S24_LE),
+         FRAME_SPECIALIZATIONS(SND_PCM_FORMAT_S24_BE),
+         FRAME_SPECIALIZATIONS(SND_PCM_FORMAT_S32_LE),
+         FRAME_SPECIALIZATIONS(SND_PCM_FORMAT_S32_BE),
+         FRAME_SPECIALIZATIONS(SND_PCM_FORMAT_FLOAT_LE),
+      };
+
+#undef FRAME_SPECIALIZATIONS
+
+      const GenericLoop GENERIC_LOOPS[] =
+      {
+         { SND_PCM_FORMAT_S16_LE, &renderLoop<SND_PCM_FORMAT_S16_LE> },
+         { SND_PCM_FORMAT_S16_BE, &renderLoop<SND_PCM_FORMAT_S16_BE> },
+         { SND_PCM_FORMAT_S24_LE, &renderLoop<SND_PCM_FORMAT_S24_LE> },
+         { SND_PCM_FORMAT_S24_BE, &renderLoop<SND_PCM_FORMAT_S24_BE> },
+         { SND_PCM_FORMAT_S32_LE, &renderLoop<SND_PCM_FORMAT_S32_LE> },
+         { SND_PCM_FORMAT_S32_BE, &renderLoop<SND_PCM_FORMAT_S32_BE> },
+         { SND_PCM_FORMAT_FLOAT_LE, &renderLoop<SND_PCM_FORMAT_FLOAT_LE> },
+      };
+   }
+
+   FrameRenderer frameRendererFor(snd_pcm_format_t format, uint32_t channels, uint32_t frameSize)
+   {
+      FrameRenderer renderer {};
+      renderer.format = format;
+      renderer.channels = channels;
+      renderer.frameSize = frameSize;
+
+      for (const auto& loop : GENERIC_LOOPS)
+      {
+         if (loop.format == format)
+         {
+            renderer.renderFrames = loop.render;
+         }
+      }
+
+      for (const auto& specialization : SPECIALIZATIONS)
+      {
+         if ((specialization.format == format) && (specialization.channels == channels) &&
+             (specialization.frameSize == frameSize))
+         {
+            renderer.renderFrame = specialization.render;
+         }
+      }
+
+      return renderer;
+   }
+}
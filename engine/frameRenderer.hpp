@@ -0,0 +1,178 @@
+/*
+ *  The write loop of a looped mono signal (e.g. the compile time sine table) specialized at compile time
+ *  for the sample format, the channel count and the processing frame size.
+ *  The format is the one negotiated with the device, byte order included, so the conversion, the fan-out
+ *  and the swap to the device order are a single pass with a constant channel count. A frame within the loop
+ *  is a single loop of FrameSize frames, a frame of whole loops converts one loop and replicates it.
+ *  frameRendererFor() picks the specialization once after the hw params are known and falls back to the
+ *  same loop with runtime bounds for the combinations that are not in the table.
+ */
+
+#pragma once
+
+#include <alsa/asoundlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <type_traits>
+
+namespace audio
+{
+   /* the container type of a format, its byte order and how a 16 bit sample is scaled into it */
+   template <snd_pcm_format_t Format>
+   struct PcmSample;
+
+   template <typename TContainer, bool BigEndian, int Shift>
+   struct IntegerPcmSample
+   {
+      using Type = TContainer;
+
+      static Type fromS16(int16_t sample)
+      {
+         using Unsigned = typename std::make_unsigned<Type>::type;
+         auto value = static_cast<Unsigned>(static_cast<Type>(sample) * (Type(1) << Shift));
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+         constexpr bool swap = !BigEndian;
+#else
+         constexpr bool swap = BigEndian;
+#endif
+         if (swap)
+         {
+            value = (sizeof(Type) == 2) ? static_cast<Unsigned>(__builtin_bswap16(static_cast<uint16_t>(value)))
+                                        : static_cast<Unsigned>(__builtin_bswap32(static_cast<uint32_t>(value)));
+         }
+         return static_cast<Type>(value);
+      }
+   };
+
+   template <> struct PcmSample<SND_PCM_FORMAT_S16_LE> : IntegerPcmSample<int16_t, false, 0> {};
+   template <> struct PcmSample<SND_PCM_FORMAT_S16_BE> : IntegerPcmSample<int16_t, true, 0> {};
+   template <> struct PcmSample<SND_PCM_FORMAT_S24_LE> : IntegerPcmSample<int32_t, false, 8> {};   /* 24 bit in the low bits of 32 */
+   template <> struct PcmSample<SND_PCM_FORMAT_S24_BE> : IntegerPcmSample<int32_t, true, 8> {};
+   template <> struct PcmSample<SND_PCM_FORMAT_S32_LE> : IntegerPcmSample<int32_t, false, 16> {};
+   template <> struct PcmSample<SND_PCM_FORMAT_S32_BE> : IntegerPcmSample<int32_t, true, 16> {};
+
+   template <>
+   struct PcmSample<SND_PCM_FORMAT_FLOAT_LE>
+   {
+      using Type = float;
+
+      static Type fromS16(int16_t sample)
+      {
+         float value = sample * (1.0f / 32768.0f);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+         uint32_t bits;
+         memcpy(&bits, &value, sizeof(bits));
+         bits = __builtin_bswap32(bits);
+         memcpy(&value, &bits, sizeof(bits));
+#endif
+         return value;
+      }
+   };
+
+   /* renders frames of the looped signal into out, pos is the position in the loop and is carried on */
+   /* the compiler unrolls the channel loop when channels is a constant and vectorizes the frame loop    */
+   template <snd_pcm_format_t Format>
+   inline void renderLoop(const int16_t* loop, uint32_t loopSize, uint32_t& pos, void* out, size_t frames, uint32_t channels)
+   {
+      using Sample = PcmSample<Format>;
+      auto dst = static_cast<typename Sample::Type*>(out);
+
+      while (frames > 0)
+      {
+         // up to the end of the loop, so that the inner loop has no wrap-around test
+         const size_t chunk = std::min<size_t>(frames, loopSize - pos);
+         const int16_t* src = loop + pos;
+
+         for (size_t f = 0; f < chunk; ++f)
+         {
+            const auto sample = Sample::fromS16(src[f]);
+            for (uint32_t c = 0; c < channels; ++c)
+            {
+               dst[f * channels + c] = sample;
+            }
+         }
+
+         dst += chunk * channels;
+         frames -= chunk;
+         pos = (pos + chunk == loopSize) ? 0u : static_cast<uint32_t>(pos + chunk);
+      }
+   }
+
+   /* one processing frame of a fixed size, channel count and format                                      */
+   /* a frame within the loop is a single loop of FrameSize frames; a frame of whole loops (the 48 sample    */
+   /* 1 kHz sine in 1152 frames) converts one loop and replicates it - only the other cases wrap per chunk */
+   template <snd_pcm_format_t Format, uint32_t Channels, uint32_t FrameSize>
+   void renderLoopFrame(const int16_t* loop, uint32_t loopSize, uint32_t& pos, void* out)
+   {
+      using Sample = PcmSample<Format>;
+      using Type = typename Sample::Type;
+      auto dst = static_cast<Type*>(out);
+
+      // the wrap test is hoisted out of the frame, the loop below has a constant trip count
+      if (pos + FrameSize <= loopSize)
+      {
+         const int16_t* src = loop + pos;
+         for (uint32_t f = 0; f < FrameSize; ++f)
+         {
+            const auto sample = Sample::fromS16(src[f]);
+            for (uint32_t c = 0; c < Channels; ++c)
+            {
+               dst[f * Channels + c] = sample;
+            }
+         }
+         pos = (pos + FrameSize == loopSize) ? 0u : pos + FrameSize;
+         return;
+      }
+
+      // the frame repeats with the loop period and ends where it started: one period, then the frame doubles
+      if ((FrameSize % loopSize) == 0)
+      {
+         constexpr size_t FRAME_SAMPLES = size_t(FrameSize) * Channels;
+
+         renderLoop<Format>(loop, loopSize, pos, dst, loopSize, Channels);
+         for (size_t done = size_t(loopSize) * Channels; done < FRAME_SAMPLES; )
+         {
+            const size_t count = std::min(done, FRAME_SAMPLES - done);
+            memcpy(dst + done, dst, count * sizeof(Type));
+            done += count;
+         }
+         return;
+      }
+
+      renderLoop<Format>(loop, loopSize, pos, out, FrameSize, Channels);
+   }
+
+   struct FrameRenderer
+   {
+      snd_pcm_format_t format = SND_PCM_FORMAT_UNKNOWN;
+      uint32_t         channels = 0;
+      uint32_t         frameSize = 0;
+
+      /* the specialization for exactly frameSize frames, nullptr when the table doesn't have this combination */
+      void (*renderFrame)(const int16_t* loop, uint32_t loopSize, uint32_t& pos, void* out) = nullptr;
+
+      /* the same loop with runtime bounds, nullptr when the format is not supported at all */
+      void (*renderFrames)(const int16_t* loop, uint32_t loopSize, uint32_t& pos, void* out, size_t frames,
+                           uint32_t channels) = nullptr;
+
+      bool isSpecialized() const { return renderFrame != nullptr; }
+      bool isValid() const { return renderFrames != nullptr; }
+
+      /* a whole processing frame goes through the specialization, a partial one (mmap area wraps) through the generic loop */
+      void render(const int16_t* loop, uint32_t loopSize, uint32_t& pos, void* out, size_t frames) const
+      {
+         if ((frames == frameSize) && (renderFrame != nullptr))
+            renderFrame(loop, loopSize, pos, out);
+         else
+            renderFrames(loop, loopSize, pos, out, frames, channels);
+      }
+   };
+
+   /* looks up the renderer for the negotiated format, call once after PcmOutput::open()     */
+   /* the specializations cover S16 / S24 / S32 (both byte orders) and FLOAT_LE for 1, 2, 6   */
+   /* and 8 channels with 256 and 1152 frame periods                                          */
+   FrameRenderer frameRendererFor(snd_pcm_format_t format, uint32_t channels, uint32_t frameSize);
+}
@@ -0,0 +1,301 @@
+#include "latencyProbe.hpp"
+#include "sampleFormat.hpp"
+#include "oscillator.hpp"
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+namespace audio
+{
+   namespace
+   {
+      constexpr uint32_t NOISE_BURST_FRAMES = 1024;   /* 21 ms at 48 kHz */
+      constexpr double   SINE_FREQUENCY = 1000.0;
+      constexpr uint32_t SINE_BURST_MS = 20;          /* 20 periods of the sine, Hann windowed */
+
+      inline float nextUniform(uint32_t& state)
+      {
+         state ^= state << 13;
+         state ^= state >> 17;
+         state ^= state << 5;
+         return static_cast<float>(state) * (1.0f / 4294967296.0f);
+      }
+
+      std::vector<float> makeProbe(const ProbeSettings& settings, uint32_t sampleRate)
+      {
+         std::vector<float> probe;
+
+         switch (settings.signal)
+         {
+            case ProbeSignal::Impulse:
+               probe.assign(1, settings.amplitude);
+               break;
+
+            case ProbeSignal::Noise:
+            {
+               uint32_t rng = 0x1234567u;
+               probe.resize(NOISE_BURST_FRAMES);
+               for (auto& sample : probe)
+               {
+                  sample = settings.amplitude * (2.0f * nextUniform(rng) - 1.0f);
+               }
+               break;
+            }
+
+            case ProbeSignal::Sine:
+            {
+               WavetableOscillator oscillator(SINE_FREQUENCY, sampleRate, settings.amplitude);
+               probe.resize((sampleRate * SINE_BURST_MS) / 1000);
+               oscillator.render(probe.data(), probe.size());
+
+               // the window keeps the burst from clicking and gives the correlation a single highest peak
+               for (size_t i = 0; i < probe.size(); ++i)
+               {
+                  probe[i] *= 0.5f - 0.5f * cosf((2.0f * static_cast<float>(M_PI) * i) / (probe.size() - 1));
+               }
+               break;
+            }
+         }
+
+         return probe;
+      }
+
+      /* returns the lag of the strongest normalized correlation of the probe within [begin, end), or -1 */
+      int64_t findProbe(const std::vector<float>& probe, const std::vector<float>& captured, size_t begin,
+                        size_t end, float threshold)
+      {
+         const size_t length = probe.size();
+         end = std::min(end, captured.size());
+         if (end < begin + length)
+         {
+            return -1;
+         }
+
+         double probeEnergy = 0.0;
+         for (auto sample : probe)
+         {
+            probeEnergy += static_cast<double>(sample) * sample;
+         }
+
+         // against the energy of the whole search range: 1.0 when the probe is all that came back,
+         // a window just as long as the probe would rate any lone noise sample perfect for a single impulse
+         double rangeEnergy = 0.0;
+         for (size_t i = begin; i < end; ++i)
+         {
+            rangeEnergy += static_cast<double>(captured[i]) * captured[i];
+         }
+
+         if (rangeEnergy <= 0.0)
+         {
+            return -1;
+         }
+
+         double best = 0.0;
+         int64_t bestLag = -1;
+
+         for (size_t start = begin; start + length <= end; ++start)
+         {
+            const float* window = captured.data() + start;
+            float sum = 0.0f;
+            for (size_t k = 0; k < length; ++k)
+            {
+               sum += probe[k] * window[k];
+            }
+
+            // the magnitude - an inverting path (or amplifier) is still a valid round trip
+            if (fabsf(sum) > best)
+            {
+               best = fabsf(sum);
+               bestLag = static_cast<int64_t>(start - begin);
+            }
+         }
+
+         best /= sqrt(probeEnergy * rangeEnergy);
+         return (best >= threshold) ? bestLag : -1;
+      }
+   }
+
+   int measureRoundTrip(PcmOutput& playback, PcmCapture& capture, const ProbeSettings& settings, ProbeResult& result)
+   {
+      const auto& out = playback.negotiated();
+      const auto& in = capture.negotiated();
+
+      result = ProbeResult {};
+
+      if (!playback.isOpen() || playback.isOffline() || !capture.isOpen())
+      {
+         printf("The round trip needs an open playback and capture device\n");
+         return -EBADFD;
+      }
+
+      const bool captureSwapped = (in.format == byteSwappedFormat(SND_PCM_FORMAT_S16));
+      if ((out.format != SND_PCM_FORMAT_S16 && !playback.needsByteSwap()) ||
+          (in.format != SND_PCM_FORMAT_S16 && !captureSwapped))
+      {
+         printf("The round trip is measured with S16 samples only\n");
+         return -EINVAL;
+      }
+
+      if (in.sampleRate != out.sampleRate)
+      {
+         printf("Playback (%u Hz) and capture (%u Hz) need the same rate\n", out.sampleRate, in.sampleRate);
+         return -EINVAL;
+      }
+
+      const auto probe = makeProbe(settings, out.sampleRate);
+      const size_t interval = std::max<size_t>((static_cast<size_t>(out.sampleRate) * settings.intervalMs) / 1000,
+                                               probe.size() * 2);
+      // the first interval fills the ring buffer before the start, one more interval catches the last burst
+      const size_t totalFrames = interval * (settings.bursts + 2);
+      const uint32_t outChannels = playback.format().channels;
+      const uint32_t inChannels = capture.format().channels;
+
+      std::vector<int16_t> period(out.periodFrames * outChannels);
+      std::vector<int16_t> readBuffer(in.periodFrames * inChannels);
+      std::vector<float> captured;
+      std::vector<size_t> sentAt(settings.bursts, 0);   /* capture frame at the moment a burst was written */
+      captured.reserve(totalFrames + in.bufferFrames);
+
+      result.linked = (capture.link(playback) == 0);
+      result.sent = settings.bursts;
+      result.bufferedMs = out.bufferLatencyMs();
+
+      // unlinked the capture runs first, the time base stays the capture clock either way
+      if (!result.linked && (capture.start() < 0))
+      {
+         return -EIO;
+      }
+
+      auto drainCapture = [&]() -> int
+      {
+         for (;;)
+         {
+            auto frames = capture.read(readBuffer.data(), in.periodFrames);
+            if (frames <= 0)
+            {
+               return static_cast<int>(frames);
+            }
+
+            if (captureSwapped)
+            {
+               byteSwap16(reinterpret_cast<uint16_t*>(readBuffer.data()), frames * inChannels);
+            }
+
+            // the first channel is enough, a loopback cable carries one signal anyway
+            for (snd_pcm_sframes_t f = 0; f < frames; ++f)
+            {
+               captured.push_back(readBuffer[f * inChannels] * (1.0f / 32768.0f));
+            }
+         }
+      };
+
+      int err = 0;
+      for (size_t written = 0; (written < totalFrames) && (err >= 0); written += out.periodFrames)
+      {
+         // "now" in capture frames - whatever is written now comes back after the queue plus the analog loop
+         const size_t now = captured.size() + std::max<snd_pcm_sframes_t>(capture.availFrames(), 0);
+
+         for (size_t f = 0; f < out.periodFrames; ++f)
+         {
+            const size_t frame = written + f;
+            const size_t burst = frame / interval;
+            const size_t offset = frame % interval;
+            float value = 0.0f;
+
+            if ((burst >= 1) && (burst <= settings.bursts) && (offset < probe.size()))
+            {
+               value = probe[offset];
+               if (offset == 0)
+               {
+                  sentAt[burst - 1] = now + f;
+               }
+            }
+
+            std::fill_n(&period[f * outChannels], outChannels, static_cast<int16_t>(lrintf(value * 32767.0f)));
+         }
+
+         playback.toDeviceOrder(period.data(), out.periodFrames);
+         if (playback.write(period.data(), out.periodFrames) < 0)
+         {
+            err = -EIO;
+            break;
+         }
+
+         err = drainCapture();
+      }
+
+      // the capture trails the playback by the round trip, wait until it has seen the end
+      for (int tries = 0; (err >= 0) && (captured.size() < totalFrames) && (tries < 1000); ++tries)
+      {
+         snd_pcm_wait(capture.handle(), 10);
+         err = drainCapture();
+      }
+
+      result.overruns = capture.overrunCount();
+
+      snd_pcm_drop(playback.handle());
+      capture.drop();
+      capture.unlink();
+
+      if (err < 0)
+      {
+         return err;
+      }
+
+      std::vector<double> lagsMs;
+      for (auto begin : sentAt)
+      {
+         auto lag = findProbe(probe, captured, begin, begin + interval, settings.threshold);
+         if (lag >= 0)
+         {
+            lagsMs.push_back((1000.0 * lag) / out.sampleRate);
+         }
+      }
+
+      result.received = static_cast<uint32_t>(lagsMs.size());
+      if (lagsMs.empty())
+      {
+         return 0;
+      }
+
+      double sum = 0.0;
+      for (auto lag : lagsMs)
+      {
+         sum += lag;
+      }
+      result.meanMs = sum / lagsMs.size();
+
+      double variance = 0.0;
+      for (auto lag : lagsMs)
+      {
+         variance += (lag - result.meanMs) * (lag - result.meanMs);
+      }
+      result.jitterMs = sqrt(variance / lagsMs.size());
+
+      auto range = std::minmax_element(lagsMs.begin(), lagsMs.end());
+      result.minMs = *range.first;
+      result.maxMs = *range.second;
+
+      return 0;
+   }
+
+   void printProbeResult(const char* name, const ProbeResult& result)
+   {
+      printf("%-20s buffered %7.2f ms", name, result.bufferedMs);
+
+      if (result.received == 0)
+      {
+         printf(" | no probe came back (%u sent) - is the output looped back to the input?\n", result.sent);
+         return;
+      }
+
+      printf(" | round trip %7.2f ms (min %.2f max %.2f) jitter %.3f ms | %u/%u received%s",
+             result.meanMs, result.minMs, result.maxMs, result.jitterMs, result.received, result.sent,
+             result.linked ? "" : ", unlinked start");
+      if (result.overruns > 0)
+      {
+         printf(", %llu overruns", static_cast<unsigned long long>(result.overruns));
+      }
+      printf("\n");
+   }
+}
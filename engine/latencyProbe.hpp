@@ -0,0 +1,52 @@
+/*
+ *  Round-trip latency measurement over a full-duplex loopback.
+ *  A known probe signal is played through a PcmOutput while a PcmCapture linked to it (snd_pcm_link) records,
+ *  so both are started by one trigger and run from one clock. The capture position at the moment a burst is written
+ *  is its send time; the capture is cross-correlated with the probe and the lag of the correlation peak is the true
+ *  write -> input latency: the queued playback buffer, the converters and whatever cable or loopback device closes
+ *  the loop. A duplex application adds one capture period on top. Repeating the probe gives the jitter.
+ */
+
+#pragma once
+
+#include "pcmOutput.hpp"
+#include "pcmCapture.hpp"
+#include <stdint.h>
+
+namespace audio
+{
+   enum class ProbeSignal
+   {
+      Impulse,   /* a single full scale sample - exact but easily lost in noise */
+      Noise,     /* a short white noise burst - a sharp correlation peak even through a noisy analog path */
+      Sine       /* bursts of the 1 kHz demo sine - the peak may be off by whole 1 ms periods on a bad loop */
+   };
+
+   struct ProbeSettings
+   {
+      ProbeSignal signal = ProbeSignal::Noise;
+      uint32_t    bursts = 16;            /* amount of measurements */
+      uint32_t    intervalMs = 250;       /* time between two bursts, also the longest round trip that can be found */
+      float       amplitude = 0.5f;       /* peak level of the probe (1.0 is full scale) */
+      float       threshold = 0.3f;       /* normalized correlation a burst needs to count as received */
+   };
+
+   struct ProbeResult
+   {
+      uint32_t sent = 0;
+      uint32_t received = 0;
+      bool     linked = false;            /* false: the streams were started one after the other */
+      double   minMs = 0.0;
+      double   maxMs = 0.0;
+      double   meanMs = 0.0;
+      double   jitterMs = 0.0;            /* standard deviation of the round trip */
+      double   bufferedMs = 0.0;          /* what the configuration claims: the full playback buffer */
+      uint64_t overruns = 0;
+   };
+
+   /* plays the probe until every burst had time to come back, returns 0 or a negative error code           */
+   /* both streams have to be open with the same rate, the format has to be S16; the capture is linked here  */
+   int measureRoundTrip(PcmOutput& playback, PcmCapture& capture, const ProbeSettings& settings, ProbeResult& result);
+
+   void printProbeResult(const char* name, const ProbeResult& result);
+}
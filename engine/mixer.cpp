@@ -0,0 +1,156 @@
+#include "mixer.hpp"
+#include "simdKernels.hpp"
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace audio
+{
+   Mixer::Mixer(uint32_t channels, uint32_t sampleRate, size_t blockFrames, size_t maxVoices) :
+      _channels(channels),
+      _sampleRate(sampleRate),
+      _blockFrames(blockFrames),
+      _voices(new Voice[maxVoices]),
+      _maxVoices(maxVoices),
+      _voiceBuffer(blockFrames * channels),
+      _accumulator(blockFrames * channels)
+   {
+   }
+
+   float Mixer::dbToGain(double db)
+   {
+      return static_cast<float>(pow(10.0, db / 20.0));
+   }
+
+   int Mixer::addVoice(AudioSource* source, float gain)
+   {
+      for (size_t v = 0; v < _maxVoices; ++v)
+      {
+         if (_voices[v].source == nullptr)
+         {
+            // starts from silence - the first block fades the voice in instead of clicking
+            _voices[v].source = source;
+            _voices[v].target.store(gain, std::memory_order_relaxed);
+            _voices[v].current = 0.0f;
+            ++_activeVoices;
+            return static_cast<int>(v);
+         }
+      }
+
+      return -ENOSPC;
+   }
+
+   void Mixer::removeVoice(int voice)
+   {
+      if ((voice >= 0) && (static_cast<size_t>(voice) < _maxVoices) && (_voices[voice].source != nullptr))
+      {
+         _voices[voice].source = nullptr;
+         --_activeVoices;
+      }
+   }
+
+   void Mixer::setGain(int voice, float gain)
+   {
+      if ((voice >= 0) && (static_cast<size_t>(voice) < _maxVoices))
+      {
+         _voices[voice].target.store(gain, std::memory_order_relaxed);
+      }
+   }
+
+   void Mixer::mixBlock(float* acc, size_t frames)
+   {
+      const auto samples = frames * _channels;
+      memset(acc, 0, samples * sizeof(float));
+
+      auto master = _masterGain.load(std::memory_order_relaxed);
+      if ((_headroom == Headroom::Auto) && (_activeVoices > 1))
+      {
+         master /= sqrtf(static_cast<float>(_activeVoices));
+      }
+
+      // one pole smoothing evaluated once per block, inside the block the gain is ramped linearly
+      const auto smoothing = static_cast<float>(1.0 - exp(-static_cast<double>(frames) / (GAIN_SMOOTHING_MS * _sampleRate / 1000.0)));
+
+      for (size_t v = 0; v < _maxVoices; ++v)
+      {
+         auto& voice = _voices[v];
+         if (voice.source == nullptr)
+         {
+            continue;
+         }
+
+         auto rendered = voice.source->render(_voiceBuffer.data(), frames, _channels);
+
+         const auto target = voice.target.load(std::memory_order_relaxed) * master;
+         auto next = voice.current + ((target - voice.current) * smoothing);
+         if (fabsf(target - next) < 1e-5f)
+         {
+            next = target;
+         }
+
+         const auto step = (next - voice.current) / static_cast<float>(samples);
+         kernels::accumulateRamp(acc, _voiceBuffer.data(), rendered * _channels, voice.current, step);
+         voice.current = next;
+
+         if (rendered < frames)
+         {
+            removeVoice(static_cast<int>(v));
+         }
+      }
+
+      if (_limiter)
+      {
+         limit(acc, samples);
+      }
+   }
+
+   void Mixer::limit(float* acc, size_t samples) const
+   {
+      // above the knee the level is bent towards full scale: knee + (1 - knee) * t / (1 + t)
+      const auto range = 1.0f - LIMITER_KNEE;
+
+      for (size_t i = 0; i < samples; ++i)
+      {
+         const auto level = fabsf(acc[i]);
+         if (level > LIMITER_KNEE)
+         {
+            const auto t = (level - LIMITER_KNEE) / range;
+            acc[i] = copysignf(LIMITER_KNEE + (range * t / (1.0f + t)), acc[i]);
+         }
+      }
+   }
+
+   void Mixer::mix(float* out, size_t frames)
+   {
+      for (size_t done = 0; done < frames;)
+      {
+         const auto count = std::min(_blockFrames, frames - done);
+         mixBlock(out + (done * _channels), count);
+         done += count;
+      }
+   }
+
+   void Mixer::mix(int16_t* out, size_t frames)
+   {
+      for (size_t done = 0; done < frames;)
+      {
+         const auto count = std::min(_blockFrames, frames - done);
+         mixBlock(_accumulator.data(), count);
+         kernels::floatToS16(_accumulator.data(), out + (done * _channels), count * _channels, 32767.0f);
+         done += count;
+      }
+   }
+
+   void Mixer::mix(int32_t* out, size_t frames)
+   {
+      for (size_t done = 0; done < frames;)
+      {
+         const auto count = std::min(_blockFrames, frames - done);
+         mixBlock(_accumulator.data(), count);
+         kernels::floatToS32(_accumulator.data(), out + (done * _channels), count * _channels, 2147483647.0f);
+         done += count;
+      }
+   }
+}
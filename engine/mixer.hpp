@@ -0,0 +1,78 @@
+/*
+ *  Multi-voice mixer.
+ *  Sums any number of AudioSource voices into a float accumulator. The per-voice gain (with the
+ *  master gain folded in) is smoothed and ramped inside the accumulation pass, so every voice costs one
+ *  render and one fused multiply-add over the block. The result is saturated - optionally after a soft
+ *  limiter - to the output format in one final pass.
+ */
+
+#pragma once
+
+#include "audioSource.hpp"
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace audio
+{
+   enum class Headroom
+   {
+      None,         /* only the master gain is applied - the voice gains have to leave the headroom */
+      Auto          /* the master gain is additionally divided by sqrt(active voices) */
+   };
+
+   class Mixer
+   {
+   public:
+      static constexpr double GAIN_SMOOTHING_MS = 10.0;   /* time constant of the gain changes */
+      static constexpr float  LIMITER_KNEE = 0.9f;        /* the soft limiter is transparent below this level */
+
+      /* the block size bounds the internal scratch buffers, longer mix() calls are split into blocks */
+      Mixer(uint32_t channels, uint32_t sampleRate, size_t blockFrames, size_t maxVoices = 64);
+
+      /* returns the voice index or -ENOSPC - adding and removing voices must not race with mix() */
+      int addVoice(AudioSource* source, float gain = 1.0f);
+      void removeVoice(int voice);
+
+      /* the gain setters can be called from any thread, the change is smoothed by the mixing thread */
+      void setGain(int voice, float gain);
+      void setMasterGain(float gain) { _masterGain.store(gain, std::memory_order_relaxed); }
+      void setHeadroom(Headroom headroom) { _headroom = headroom; }
+      void setLimiter(bool enabled) { _limiter = enabled; }
+
+      size_t activeVoices() const { return _activeVoices; }
+      uint32_t channels() const { return _channels; }
+
+      /* interleaved output - a voice whose source has finished is removed */
+      void mix(float* out, size_t frames);
+      void mix(int16_t* out, size_t frames);
+      void mix(int32_t* out, size_t frames);
+
+      static float dbToGain(double db);
+
+   private:
+      struct Voice
+      {
+         AudioSource*       source = nullptr;
+         std::atomic<float> target { 0.0f };
+         float              current = 0.0f;
+      };
+
+      void mixBlock(float* acc, size_t frames);
+      void limit(float* acc, size_t samples) const;
+
+      uint32_t _channels;
+      uint32_t _sampleRate;
+      size_t   _blockFrames;
+      std::unique_ptr<Voice[]> _voices;
+      size_t   _maxVoices;
+      size_t   _activeVoices = 0;
+      std::atomic<float> _masterGain { 1.0f };
+      Headroom _headroom = Headroom::None;
+      bool     _limiter = false;
+      std::vector<float> _voiceBuffer;    /* one block of the voice being mixed */
+      std::vector<float> _accumulator;    /* one block of the sum, used by the integer outputs */
+   };
+}
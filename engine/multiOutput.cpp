@@ -0,0 +1,344 @@
+#include "multiOutput.hpp"
+#include "simdKernels.hpp"
+
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace audio
+{
+   namespace
+   {
+      bool resamplable(snd_pcm_format_t format)
+      {
+         return (format == SND_PCM_FORMAT_S16) || (format == SND_PCM_FORMAT_S32) || (format == SND_PCM_FORMAT_FLOAT);
+      }
+
+      void toFloat(const uint8_t* in, float* out, size_t samples, snd_pcm_format_t format)
+      {
+         if (format == SND_PCM_FORMAT_S16)
+         {
+            const auto* s = reinterpret_cast<const int16_t*>(in);
+            for (size_t i = 0; i < samples; ++i)
+            {
+               out[i] = s[i] * (1.0f / 32768.0f);
+            }
+         }
+         else if (format == SND_PCM_FORMAT_S32)
+         {
+            const auto* s = reinterpret_cast<const int32_t*>(in);
+            for (size_t i = 0; i < samples; ++i)
+            {
+               out[i] = static_cast<float>(s[i]) * (1.0f / 2147483648.0f);
+            }
+         }
+         else
+         {
+            memcpy(out, in, samples * sizeof(float));
+         }
+      }
+
+      void fromFloat(const float* in, uint8_t* out, size_t samples, snd_pcm_format_t format)
+      {
+         if (format == SND_PCM_FORMAT_S16)
+         {
+            kernels::floatToS16(in, reinterpret_cast<int16_t*>(out), samples, 32767.0f);
+         }
+         else if (format == SND_PCM_FORMAT_S32)
+         {
+            kernels::floatToS32(in, reinterpret_cast<int32_t*>(out), samples, 2147483647.0f);
+         }
+         else
+         {
+            memcpy(out, in, samples * sizeof(float));
+         }
+      }
+   }
+
+   MultiOutput::MultiOutput(const MultiOutputSettings& settings) :
+      _settings(settings),
+      _depthFrames(settings.blockFrames * settings.depthBlocks)
+   {
+   }
+
+   MultiOutput::~MultiOutput()
+   {
+      stop();
+   }
+
+   int MultiOutput::addDevice(const PcmFormat& format)
+   {
+      if (format.format == SND_PCM_FORMAT_UNKNOWN)
+      {
+         printf("%s: the devices share one rendered signal, its format has to be given\n", format.device);
+         return -EINVAL;
+      }
+
+      if (!_devices.empty())
+      {
+         const auto& first = _devices.front()->output.format();
+         if ((format.format != first.format) || (format.sampleRate != first.sampleRate) || (format.channels != first.channels))
+         {
+            printf("%s: every device has to play the format, rate and channels of %s\n", format.device, first.device);
+            return -EINVAL;
+         }
+      }
+
+      // the ring has to take a whole block on top of the device buffer, the rest is up to the device config
+      const auto frameBytes = (snd_pcm_format_physical_width(format.format) / 8) * format.channels;
+      std::unique_ptr<Device> device(new Device(_depthFrames + _settings.blockFrames, static_cast<uint32_t>(frameBytes)));
+
+      auto err = device->output.open(format);
+      if (err < 0)
+      {
+         return err;
+      }
+
+      printNegotiated(format.device, device->output.negotiated());
+      _frameBytes = device->output.frameBytes();
+      const auto period = device->output.negotiated().periodFrames;
+      device->silence.assign(period * _frameBytes, 0);
+
+      // a file sink runs on no clock of its own, there is nothing to compensate
+      if (_settings.compensateDrift && resamplable(format.format) && !device->output.isOffline())
+      {
+         const auto maxInput = (2 * period) + 4;   /* far more than the +-0.5 % the controller may ask for */
+         device->resampler.reset(new AdaptiveResampler(format.channels, maxInput));
+         device->input.resize(maxInput * format.channels);
+         device->resampled.resize(period * format.channels);
+         device->staging.resize(period * _frameBytes);
+      }
+      _devices.push_back(std::move(device));
+      return 0;
+   }
+
+   void MultiOutput::distribute(Device& device)
+   {
+      // a device which can't take the whole block loses it - waiting for it would stall every other device
+      if (device.ring.writable() < _settings.blockFrames)
+      {
+         device.dropped.store(device.dropped.load(std::memory_order_relaxed) + _settings.blockFrames, std::memory_order_relaxed);
+         return;
+      }
+
+      size_t done = 0;
+      while (done < _settings.blockFrames)
+      {
+         auto span = device.ring.writeSpan();
+         const auto count = std::min(span.frames, _settings.blockFrames - done);
+
+         memcpy(span.data, _block.data() + (done * _frameBytes), count * _frameBytes);
+         if (!device.resampler)
+         {
+            device.output.toDeviceOrder(span.data, count);   // every device may want its own byte order
+         }
+         device.ring.commitWrite(count);
+         done += count;
+      }
+   }
+
+   bool MultiOutput::renderBlock()
+   {
+      const auto rendered = _rendered.load(std::memory_order_relaxed);
+      if (rendered >= _frameLimit.load(std::memory_order_relaxed))
+      {
+         _renderDone.store(true, std::memory_order_release);
+         return false;
+      }
+
+      // paced by the device which has the least queued - the others are ahead and simply keep their reserve
+      size_t leastQueued = SIZE_MAX;
+      for (const auto& device : _devices)
+      {
+         leastQueued = std::min(leastQueued, device->ring.readable());
+      }
+
+      if (leastQueued >= _depthFrames)
+      {
+         const auto& config = _devices.front()->output.negotiated();
+         if (_devices.front()->output.isOffline())
+         {
+            std::this_thread::yield();
+            return true;
+         }
+
+         std::this_thread::sleep_for(std::chrono::microseconds((_settings.blockFrames * 250000) / config.sampleRate));
+         return true;
+      }
+
+      _render(_block.data(), _settings.blockFrames);
+
+      for (auto& device : _devices)
+      {
+         distribute(*device);
+      }
+
+      _rendered.store(rendered + _settings.blockFrames, std::memory_order_relaxed);
+      return true;
+   }
+
+   bool MultiOutput::runResampledDevice(Device& device)
+   {
+      auto& output = device.output;
+      const auto& negotiated = output.negotiated();
+      const auto period = negotiated.periodFrames;
+      const auto format = output.format().format;
+      const auto channels = negotiated.channels;
+      const auto needed = device.resampler->inputFramesFor(period);
+      snd_pcm_sframes_t res;
+
+      if (device.ring.readable() >= needed)
+      {
+         // the ring keeps the host byte order, the swap (if any) comes after the resampling
+         size_t done = 0;
+         while (done < needed)
+         {
+            auto span = device.ring.readSpan();
+            const auto count = std::min(span.frames, needed - done);
+            toFloat(span.data, device.input.data() + (done * channels), count * channels, format);
+            device.ring.commitRead(count);
+            done += count;
+         }
+
+         device.resampler->process(device.input.data(), needed, device.resampled.data(), period);
+         fromFloat(device.resampled.data(), device.staging.data(), period * channels, format);
+         output.toDeviceOrder(device.staging.data(), period);
+         res = output.write(device.staging.data(), period);
+      }
+      else if (_renderDone.load(std::memory_order_acquire))
+      {
+         return false;   // the rest is shorter than a period
+      }
+      else
+      {
+         device.starved.store(device.starved.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+         res = output.write(device.silence.data(), period);
+      }
+
+      if (res < 0)
+      {
+         return false;
+      }
+
+      // measured right after the write - always at the same phase of the period, so the jitter stays small
+      const auto delay = output.delayFrames();
+      if (delay >= 0)
+      {
+         const auto ratio = device.drift.update(static_cast<double>(delay + device.ring.readable()));
+         device.resampler->setRatio(ratio);
+         device.driftPpm.store(device.drift.deviationPpm(), std::memory_order_relaxed);
+      }
+
+      return output.waitForPeriod() >= 0;
+   }
+
+   bool MultiOutput::runDevice(Device& device)
+   {
+      if (device.resampler)
+      {
+         return runResampledDevice(device);
+      }
+
+      auto& output = device.output;
+      const auto period = output.negotiated().periodFrames;
+      auto span = device.ring.readSpan();
+      snd_pcm_sframes_t res;
+
+      if (span.frames > 0)
+      {
+         res = output.write(span.data, std::min<size_t>(span.frames, period));
+         if (res > 0)
+         {
+            device.ring.commitRead(res);
+         }
+      }
+      else if (_renderDone.load(std::memory_order_acquire))
+      {
+         return false;   // everything rendered was played
+      }
+      else if (output.isOffline())
+      {
+         std::this_thread::yield();   // a file has no deadline, it waits for the render instead of getting silence
+         return true;
+      }
+      else
+      {
+         device.starved.store(device.starved.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+         res = output.write(device.silence.data(), period);
+      }
+
+      return (res >= 0) && (output.waitForPeriod() >= 0);
+   }
+
+   int MultiOutput::start(RenderFn render)
+   {
+      if (_devices.empty())
+      {
+         return -ENODEV;
+      }
+
+      _render = std::move(render);
+      _block.assign(_settings.blockFrames * _frameBytes, 0);
+      _renderDone.store(false, std::memory_order_relaxed);
+
+      // priming - every device starts with a full ring
+      while ((_devices.front()->ring.readable() < _depthFrames) && renderBlock())
+      {
+      }
+
+      auto deviceSettings = _settings.deviceThreads;
+      deviceSettings.name = "multi output device";
+      for (auto& device : _devices)
+      {
+         auto* d = device.get();
+         d->thread.start(deviceSettings, [this, d]() { return runDevice(*d); });
+      }
+
+      auto renderSettings = _settings.renderThread;
+      renderSettings.name = "multi output render";
+      _renderThread.start(renderSettings, [this]() { return renderBlock(); });
+      return 0;
+   }
+
+   bool MultiOutput::finished() const
+   {
+      if (!_renderDone.load(std::memory_order_acquire))
+      {
+         return false;
+      }
+
+      return std::none_of(_devices.begin(), _devices.end(), [](const std::unique_ptr<Device>& d) { return d->thread.running(); });
+   }
+
+   void MultiOutput::stop()
+   {
+      _renderThread.stop();
+      _renderThread.join();
+      _renderDone.store(true, std::memory_order_release);
+
+      for (auto& device : _devices)
+      {
+         device->thread.stop();
+         device->thread.join();
+         if (device->output.isOpen())
+         {
+            device->output.drain();
+            device->output.close();
+         }
+      }
+   }
+
+   void MultiOutput::printReport() const
+   {
+      printf("Rendered %llu frames\n", static_cast<unsigned long long>(renderedFrames()));
+
+      for (size_t d = 0; d < _devices.size(); ++d)
+      {
+         printf("%s: dropped %llu frames, %llu periods of silence, drift %+.1f ppm | ", _devices[d]->output.format().device,
+                static_cast<unsigned long long>(droppedFrames(d)), static_cast<unsigned long long>(starvedPeriods(d)), driftPpm(d));
+         printStats(_devices[d]->output.stats());
+      }
+   }
+}
@@ -0,0 +1,106 @@
+/*
+ *  One signal played on several devices at once (HDMI + USB DAC + loopback, a rack of outputs, ...).
+ *  The signal is rendered once per block and copied into a ring of every device; each device has its
+ *  own writer thread with its own period size and pacing. The render follows the device which is the
+ *  furthest behind on its ring but still keeps up - a device whose ring is full (stalled, unplugged,
+ *  a slower clock) drops the block and counts it, it never holds back the others.
+ *  With drift compensation every device resamples its ring by the ratio a DriftController derives from
+ *  the ring fill plus snd_pcm_delay, so crystals running apart never drop a block or starve.
+ */
+
+#pragma once
+
+#include "pcmOutput.hpp"
+#include "resampler.hpp"
+#include "rtThread.hpp"
+#include "spscRing.hpp"
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace audio
+{
+   struct MultiOutputSettings
+   {
+      size_t     blockFrames = 1152;       /* frames rendered per call of the render function */
+      size_t     depthBlocks = 4;          /* ring bound of every device, in blocks */
+      bool       compensateDrift = true;   /* per device resampling steered by its fill level (S16 / S32 / FLOAT, not offline) */
+      RtSettings renderThread {};
+      RtSettings deviceThreads {};
+   };
+
+   class MultiOutput
+   {
+   public:
+      /* out receives frames interleaved frames in the host byte order format of the devices */
+      using RenderFn = std::function<void(void* out, size_t frames)>;
+
+      explicit MultiOutput(const MultiOutputSettings& settings = {});
+      ~MultiOutput();
+
+      MultiOutput(const MultiOutput&) = delete;
+      MultiOutput& operator=(const MultiOutput&) = delete;
+
+      /* opens one more device - format, rate and channels have to match the first one, the buffer config may differ */
+      int addDevice(const PcmFormat& format);
+
+      size_t deviceCount() const { return _devices.size(); }
+      const PcmOutput& device(size_t index) const { return _devices[index]->output; }
+
+      /* renders the rings full, then starts the writer threads and the render thread */
+      int start(RenderFn render);
+
+      /* the render thread stops after the given amount of frames, the devices play what is queued */
+      void stopAfter(uint64_t frames) { _frameLimit.store(frames, std::memory_order_relaxed); }
+      bool finished() const;
+
+      /* stops every thread and drains the devices */
+      void stop();
+
+      uint64_t renderedFrames() const { return _rendered.load(std::memory_order_relaxed); }
+      uint64_t droppedFrames(size_t index) const { return _devices[index]->dropped.load(std::memory_order_relaxed); }
+      uint64_t starvedPeriods(size_t index) const { return _devices[index]->starved.load(std::memory_order_relaxed); }
+      double driftPpm(size_t index) const { return _devices[index]->driftPpm.load(std::memory_order_relaxed); }
+
+      void printReport() const;
+
+   private:
+      struct Device
+      {
+         Device(size_t capacityFrames, uint32_t frameBytes) : ring(capacityFrames, frameBytes) {}
+
+         PcmOutput              output;
+         SpscFrameRing<uint8_t> ring;         /* device format frames, one "channel" per byte */
+         std::vector<uint8_t>   silence {};
+         RenderThread           thread {};
+         std::atomic<uint64_t>  dropped { 0 }; /* frames the ring had no room for */
+         std::atomic<uint64_t>  starved { 0 }; /* periods of silence written on an empty ring */
+
+         std::unique_ptr<AdaptiveResampler> resampler {};   /* only with drift compensation */
+         DriftController        drift {};
+         std::vector<float>     input {};
+         std::vector<float>     resampled {};
+         std::vector<uint8_t>   staging {};
+         std::atomic<double>    driftPpm { 0.0 };
+      };
+
+      bool renderBlock();
+      bool runDevice(Device& device);
+      bool runResampledDevice(Device& device);
+      void distribute(Device& device);
+
+      MultiOutputSettings _settings;
+      size_t              _depthFrames;
+      size_t              _frameBytes = 0;
+      RenderFn            _render {};
+      std::vector<std::unique_ptr<Device>> _devices {};
+      std::vector<uint8_t> _block {};
+      RenderThread        _renderThread {};
+      std::atomic<uint64_t> _rendered { 0 };
+      std::atomic<uint64_t> _frameLimit { UINT64_MAX };
+      std::atomic<bool>   _renderDone { false };
+   };
+}
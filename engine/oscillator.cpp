@@ -0,0 +1,76 @@
+#include "oscillator.hpp"
+#include "sineTable.hpp"
+
+#include <math.h>
+
+namespace audio
+{
+   namespace
+   {
+      // one full sine period plus a guard entry, so that the interpolation never has to wrap the index
+      constexpr auto SINE_WAVETABLE = makeSinePeriod<int16_t, WavetableOscillator::TABLE_SIZE, 1>();
+   }
+
+   const int16_t* WavetableOscillator::sharedTable()
+   {
+      return SINE_WAVETABLE.data();
+   }
+
+   WavetableOscillator::WavetableOscillator(double frequency, uint32_t sampleRate, double amplitude)
+      : _table(sharedTable())
+      , _sampleRate(sampleRate)
+   {
+      setFrequency(frequency);
+      setAmplitude(amplitude);
+   }
+
+   void WavetableOscillator::setFrequency(double frequency)
+   {
+      // the increment is the fraction of a full period per sample expressed in 1/2^32 units
+      _increment = static_cast<uint32_t>(llround((frequency / _sampleRate) * 4294967296.0));
+   }
+
+   void WavetableOscillator::setAmplitude(double amplitude)
+   {
+      _amplitudeQ15 = static_cast<int32_t>(lround(amplitude * 32768.0));
+      if (_amplitudeQ15 > 32768)
+      {
+         _amplitudeQ15 = 32768;
+      }
+   }
+
+   double WavetableOscillator::frequency() const
+   {
+      return (static_cast<double>(_increment) * _sampleRate) / 4294967296.0;
+   }
+
+   void WavetableOscillator::render(int16_t* out, size_t count)
+   {
+      for (size_t i = 0; i < count; ++i)
+      {
+         out[i] = static_cast<int16_t>((nextSample() * _amplitudeQ15) >> 15);
+      }
+   }
+
+   void WavetableOscillator::renderInterleaved(int16_t* out, size_t frames, uint32_t channels)
+   {
+      for (size_t f = 0; f < frames; ++f)
+      {
+         const auto s = static_cast<int16_t>((nextSample() * _amplitudeQ15) >> 15);
+         for (uint32_t c = 0; c < channels; ++c)
+         {
+            *out++ = s;
+         }
+      }
+   }
+
+   void WavetableOscillator::render(float* out, size_t count)
+   {
+      const float scale = _amplitudeQ15 / (32768.0f * 32768.0f);
+
+      for (size_t i = 0; i < count; ++i)
+      {
+         out[i] = nextSample() * scale;
+      }
+   }
+}
@@ -0,0 +1,62 @@
+/*
+ *  Sine oscillator driven by a 32 bit fixed-point phase accumulator over a power-of-two wavetable.
+ *  Any frequency below nyquist can be played for an unbounded time (the phase simply wraps around)
+ *  and a sample costs one add, one table lookup and a linear interpolation - no libm calls at runtime.
+ *  The table itself is generated at compile time (see sineTable.hpp).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace audio
+{
+   class WavetableOscillator
+   {
+   public:
+      static constexpr uint32_t TABLE_BITS = 11;               /* 2048 entry table */
+      static constexpr uint32_t TABLE_SIZE = 1u << TABLE_BITS;
+      static constexpr uint32_t FRAC_BITS = 32 - TABLE_BITS;   /* phase bits used for the interpolation */
+
+      WavetableOscillator(double frequency, uint32_t sampleRate, double amplitude = 1.0);
+
+      void setFrequency(double frequency);
+      void setAmplitude(double amplitude);     /* linear gain 0.0 .. 1.0 */
+      void setPhase(uint32_t phase) { _phase = phase; }
+
+      double frequency() const;
+      uint32_t phase() const { return _phase; }
+      uint32_t phaseIncrement() const { return _increment; }
+
+      /* mono 16 bit samples */
+      void render(int16_t* out, size_t count);
+
+      /* the same mono signal copied into every channel of interleaved frames */
+      void renderInterleaved(int16_t* out, size_t frames, uint32_t channels);
+
+      /* mono float samples in the -1.0 .. 1.0 range */
+      void render(float* out, size_t count);
+
+   private:
+      inline int32_t nextSample()
+      {
+         const auto index = _phase >> FRAC_BITS;
+         const auto frac = static_cast<int32_t>((_phase >> (FRAC_BITS - 15)) & 0x7FFF);  /* Q15 position between two entries */
+         const int32_t a = _table[index];
+         const int32_t b = _table[index + 1];
+
+         _phase += _increment;
+
+         return a + (((b - a) * frac) >> 15);
+      }
+
+      static const int16_t* sharedTable();
+
+      const int16_t* _table;
+      uint32_t       _sampleRate;
+      uint32_t       _phase = 0;
+      uint32_t       _increment = 0;
+      int32_t        _amplitudeQ15 = 0;
+   };
+}
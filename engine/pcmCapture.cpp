@@ -0,0 +1,144 @@
+#include "pcmCapture.hpp"
+
+namespace audio
+{
+   PcmCapture::~PcmCapture()
+   {
+      close();
+   }
+
+   int PcmCapture::open(const PcmFormat& format)
+   {
+      int err;
+
+      close();
+
+      if ((err = snd_pcm_open(&_handle, format.device, SND_PCM_STREAM_CAPTURE, SND_PCM_NONBLOCK)) < 0)
+      {
+         printf("Capture open error: %s\n", snd_strerror(err));
+         _handle = nullptr;
+         return err;
+      }
+
+      // mmap makes no difference for reading a few seconds, the access is always readi
+      if ((err = applyHwParams(_handle, format.format, SND_PCM_ACCESS_RW_INTERLEAVED, format.sampleRate,
+                               format.channels, format.config, _negotiated)) < 0)
+      {
+         close();
+         return err;
+      }
+
+      // a capture stream is started explicitly or through the link, never by the threshold
+      PcmConfig config = format.config;
+      config.startThreshold = static_cast<uint32_t>(_negotiated.bufferFrames) * 2;
+
+      if ((err = applySwParams(_handle, config, _negotiated)) < 0)
+      {
+         close();
+         return err;
+      }
+
+      _format = format;
+      _frameBytes = (snd_pcm_format_physical_width(_negotiated.format) / 8) * format.channels;
+      _overruns = 0;
+
+      return 0;
+   }
+
+   snd_pcm_sframes_t PcmCapture::read(void* frames, snd_pcm_uframes_t maxFrames)
+   {
+      auto dst = static_cast<uint8_t*>(frames);
+      snd_pcm_uframes_t done = 0;
+
+      while (done < maxFrames)
+      {
+         auto res = snd_pcm_readi(_handle, dst + (done * _frameBytes), maxFrames - done);
+
+         if (res == -EAGAIN)
+         {
+            break;
+         }
+
+         if (res < 0)
+         {
+            if (res == -EPIPE)
+            {
+               ++_overruns;
+            }
+
+            if ((res = snd_pcm_recover(_handle, res, 0)) < 0)
+            {
+               printf("snd_pcm_readi failed: %s\n", snd_strerror(res));
+               return res;
+            }
+
+            // a recovered capture stream is prepared but not running any more
+            if ((res = snd_pcm_start(_handle)) < 0)
+            {
+               printf("Can't restart the capture: %s\n", snd_strerror(res));
+               return res;
+            }
+            continue;
+         }
+
+         if (res == 0)
+         {
+            break;
+         }
+         done += res;
+      }
+
+      return done;
+   }
+
+   int PcmCapture::link(const PcmOutput& playback)
+   {
+      if ((_handle == nullptr) || (playback.handle() == nullptr))
+      {
+         return -EBADFD;
+      }
+
+      auto err = snd_pcm_link(_handle, playback.handle());
+      if (err < 0)
+      {
+         printf("Can't link the capture to the playback stream: %s\n", snd_strerror(err));
+         return err;
+      }
+
+      _linked = true;
+      return 0;
+   }
+
+   void PcmCapture::unlink()
+   {
+      if (_linked)
+      {
+         snd_pcm_unlink(_handle);
+         _linked = false;
+      }
+   }
+
+   int PcmCapture::start()
+   {
+      auto err = snd_pcm_start(_handle);
+      if (err < 0)
+         printf("snd_pcm_start failed: %s\n", snd_strerror(err));
+
+      return err;
+   }
+
+   int PcmCapture::drop()
+   {
+      return (_handle != nullptr) ? snd_pcm_drop(_handle) : -EBADFD;
+   }
+
+   void PcmCapture::close()
+   {
+      if (_handle != nullptr)
+      {
+         unlink();
+         snd_pcm_close(_handle);
+         _handle = nullptr;
+      }
+   }
+}
@@ -0,0 +1,65 @@
+/*
+ *  The capture counterpart of PcmOutput.
+ *  The stream is configured with the same hw/sw params code and presets as the playback side, so that a capture
+ *  and a playback stream of one card can be linked (snd_pcm_link) and share a single start trigger.
+ *  The handle is always non-blocking: read() takes whatever the device has captured and never waits.
+ */
+
+#pragma once
+
+#include "pcmOutput.hpp"
+#include <alsa/asoundlib.h>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace audio
+{
+   class PcmCapture
+   {
+   public:
+      PcmCapture() = default;
+      ~PcmCapture();
+
+      PcmCapture(const PcmCapture&) = delete;
+      PcmCapture& operator=(const PcmCapture&) = delete;
+
+      /* opens and configures the capture device (format.device), pacing and renderFile are ignored */
+      /* returns 0 or a negative ALSA error code */
+      int open(const PcmFormat& format);
+
+      /* reads at most maxFrames interleaved frames, returns the amount read (0 when nothing is captured yet) */
+      /* overruns are recovered and counted, returns a negative ALSA error code when recovery was not possible */
+      snd_pcm_sframes_t read(void* frames, snd_pcm_uframes_t maxFrames);
+
+      /* frames captured and waiting to be read, or a negative ALSA error code */
+      snd_pcm_sframes_t availFrames() const { return snd_pcm_avail(_handle); }
+
+      /* links the capture to the playback stream so that both start (and stop) together, returns 0 or an error */
+      int link(const PcmOutput& playback);
+      void unlink();
+
+      /* starts an unlinked stream explicitly */
+      int start();
+
+      /* stops the stream dropping the captured frames, it has to be prepared again to be restarted */
+      int drop();
+
+      void close();
+
+      bool isOpen() const { return _handle != nullptr; }
+      bool isLinked() const { return _linked; }
+      snd_pcm_t* handle() const { return _handle; }
+      const PcmFormat& format() const { return _format; }
+      const NegotiatedParams& negotiated() const { return _negotiated; }
+      size_t frameBytes() const { return _frameBytes; }
+      uint64_t overrunCount() const { return _overruns; }
+
+   private:
+      snd_pcm_t* _handle = nullptr;
+      PcmFormat  _format {};
+      NegotiatedParams _negotiated {};
+      size_t     _frameBytes = 0;
+      bool       _linked = false;
+      uint64_t   _overruns = 0;
+   };
+}
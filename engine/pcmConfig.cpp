@@ -0,0 +1,236 @@
+#include "pcmConfig.hpp"
+#include "sampleFormat.hpp"
+
+namespace audio
+{
+   namespace
+   {
+      const PcmConfig* const ALL_PRESETS[] { &presets::LOW_LATENCY, &presets::BALANCED, &presets::THROUGHPUT };
+   }
+
+   namespace
+   {
+      /* reads back what the driver has really chosen */
+      void readBack(snd_pcm_hw_params_t* hwParams, NegotiatedParams& negotiated)
+      {
+         int dir = 0;
+         snd_pcm_hw_params_get_period_size(hwParams, &negotiated.periodFrames, &dir);
+         dir = 0;
+         snd_pcm_hw_params_get_periods(hwParams, &negotiated.periods, &dir);
+         snd_pcm_hw_params_get_buffer_size(hwParams, &negotiated.bufferFrames);
+      }
+   }
+
+   const PcmConfig* findPreset(const char* name)
+   {
+      if (name == nullptr)
+      {
+         return nullptr;
+      }
+
+      for (auto preset : ALL_PRESETS)
+      {
+         if (strncmp(preset->name, name, strlen(name)) == 0)
+         {
+            return preset;
+         }
+      }
+
+      return nullptr;
+   }
+
+   int applyHwParams(snd_pcm_t* handle, snd_pcm_format_t format, snd_pcm_access_t access, uint32_t sampleRate,
+                     uint32_t channels, const PcmConfig& config, NegotiatedParams& negotiated)
+   {
+      int err;
+      int dir = 0;
+      snd_pcm_hw_params_t* hwParams;
+
+      snd_pcm_hw_params_alloca(&hwParams);
+
+      if ((err = snd_pcm_hw_params_any(handle, hwParams)) < 0)
+      {
+         printf("No playback configurations available: %s\n", snd_strerror(err));
+         return err;
+      }
+
+      if ((err = snd_pcm_hw_params_set_rate_resample(handle, hwParams, 1)) < 0)
+      {
+         printf("Resampling setup failed: %s\n", snd_strerror(err));
+         return err;
+      }
+
+      // direct ring buffer access is optional - writei is always there as the fallback
+      if ((access == SND_PCM_ACCESS_MMAP_INTERLEAVED) && (snd_pcm_hw_params_test_access(handle, hwParams, access) < 0))
+      {
+         printf("mmap access not available, falling back to writei\n");
+         access = SND_PCM_ACCESS_RW_INTERLEAVED;
+      }
+
+      if ((err = snd_pcm_hw_params_set_access(handle, hwParams, access)) < 0)
+      {
+         printf("Access type not available: %s\n", snd_strerror(err));
+         return err;
+      }
+
+      snd_pcm_format_t chosenFormat;
+      if ((err = negotiateFormat(handle, hwParams, format, chosenFormat)) < 0)
+      {
+         return err;
+      }
+
+      if ((err = snd_pcm_hw_params_set_format(handle, hwParams, chosenFormat)) < 0)
+      {
+         printf("Sample format not available: %s\n", snd_strerror(err));
+         return err;
+      }
+
+      if ((err = snd_pcm_hw_params_set_channels(handle, hwParams, channels)) < 0)
+      {
+         printf("Channels count (%u) not available: %s\n", channels, snd_strerror(err));
+         return err;
+      }
+
+      unsigned int rate = sampleRate;
+      if ((err = snd_pcm_hw_params_set_rate_near(handle, hwParams, &rate, &dir)) < 0)
+      {
+         printf("Rate %uHz not available: %s\n", sampleRate, snd_strerror(err));
+         return err;
+      }
+      if (rate != sampleRate)
+      {
+         printf("Rate doesn't match (requested %uHz, got %uHz)\n", sampleRate, rate);
+         return -EINVAL;
+      }
+
+      snd_pcm_uframes_t periodFrames = config.periodFrames;
+      dir = 0;
+      if ((err = snd_pcm_hw_params_set_period_size_near(handle, hwParams, &periodFrames, &dir)) < 0)
+      {
+         printf("Unable to set period size %u: %s\n", config.periodFrames, snd_strerror(err));
+         return err;
+      }
+
+      snd_pcm_uframes_t bufferFrames = periodFrames * config.periods;
+      if ((err = snd_pcm_hw_params_set_buffer_size_near(handle, hwParams, &bufferFrames)) < 0)
+      {
+         printf("Unable to set buffer size %lu: %s\n", periodFrames * config.periods, snd_strerror(err));
+         return err;
+      }
+
+      if ((err = snd_pcm_hw_params(handle, hwParams)) < 0)
+      {
+         printf("Unable to set hw params: %s\n", snd_strerror(err));
+         return err;
+      }
+
+      readBack(hwParams, negotiated);
+
+      negotiated.format = chosenFormat;
+      negotiated.access = access;
+      negotiated.sampleRate = rate;
+      negotiated.channels = channels;
+
+      return 0;
+   }
+
+   int applyKnownHwParams(snd_pcm_t* handle, const NegotiatedParams& known, NegotiatedParams& negotiated)
+   {
+      int err;
+      snd_pcm_hw_params_t* hwParams;
+
+      snd_pcm_hw_params_alloca(&hwParams);
+
+      // every step refines the configuration space to the single point negotiated before
+      if (((err = snd_pcm_hw_params_any(handle, hwParams)) < 0) ||
+          ((err = snd_pcm_hw_params_set_rate_resample(handle, hwParams, 1)) < 0) ||
+          ((err = snd_pcm_hw_params_set_access(handle, hwParams, known.access)) < 0) ||
+          ((err = snd_pcm_hw_params_set_format(handle, hwParams, known.format)) < 0) ||
+          ((err = snd_pcm_hw_params_set_channels(handle, hwParams, known.channels)) < 0) ||
+          ((err = snd_pcm_hw_params_set_rate(handle, hwParams, known.sampleRate, 0)) < 0) ||
+          ((err = snd_pcm_hw_params_set_period_size(handle, hwParams, known.periodFrames, 0)) < 0) ||
+          ((err = snd_pcm_hw_params_set_buffer_size(handle, hwParams, known.bufferFrames)) < 0) ||
+          ((err = snd_pcm_hw_params(handle, hwParams)) < 0))
+      {
+         return err;
+      }
+
+      readBack(hwParams, negotiated);
+
+      negotiated.format = known.format;
+      negotiated.access = known.access;
+      negotiated.sampleRate = known.sampleRate;
+      negotiated.channels = known.channels;
+
+      return 0;
+   }
+
+   int applySwParams(snd_pcm_t* handle, const PcmConfig& config, NegotiatedParams& negotiated)
+   {
+      int err;
+      snd_pcm_sw_params_t* swParams;
+
+      snd_pcm_sw_params_alloca(&swParams);
+
+      if ((err = snd_pcm_sw_params_current(handle, swParams)) < 0)
+      {
+         printf("Unable to determine current sw params: %s\n", snd_strerror(err));
+         return err;
+      }
+
+      // by default the playback starts once all full periods of the buffer are queued
+      snd_pcm_uframes_t startThreshold = config.startThreshold;
+      if (startThreshold == 0)
+      {
+         startThreshold = (negotiated.bufferFrames / negotiated.periodFrames) * negotiated.periodFrames;
+      }
+
+      if ((err = snd_pcm_sw_params_set_start_threshold(handle, swParams, startThreshold)) < 0)
+      {
+         printf("Unable to set start threshold: %s\n", snd_strerror(err));
+         return err;
+      }
+
+      snd_pcm_uframes_t availMin = (config.availMin == 0) ? negotiated.periodFrames : config.availMin;
+      if ((err = snd_pcm_sw_params_set_avail_min(handle, swParams, availMin)) < 0)
+      {
+         printf("Unable to set avail min: %s\n", snd_strerror(err));
+         return err;
+      }
+
+      // timestamps of the hw pointer on the monotonic clock, which snd_pcm_htimestamp() maps wall clock time with
+      if ((snd_pcm_sw_params_set_tstamp_mode(handle, swParams, SND_PCM_TSTAMP_ENABLE) < 0) ||
+          (snd_pcm_sw_params_set_tstamp_type(handle, swParams, SND_PCM_TSTAMP_TYPE_MONOTONIC) < 0))
+      {
+         printf("Monotonic timestamps are not supported, scheduled starts are less accurate\n");
+      }
+
+      if ((err = snd_pcm_sw_params(handle, swParams)) < 0)
+      {
+         printf("Unable to set sw params: %s\n", snd_strerror(err));
+         return err;
+      }
+
+      snd_pcm_sw_params_get_start_threshold(swParams, &negotiated.startThreshold);
+      snd_pcm_sw_params_get_avail_min(swParams, &negotiated.availMin);
+
+      return 0;
+   }
+
+   void printNegotiated(const char* device, const NegotiatedParams& negotiated)
+   {
+      printf("Device \"%s\": %s, %s, %u Hz, %u ch, period %lu frames x %u = buffer %lu frames (%.1f ms), "
+             "start threshold %lu, avail min %lu\n",
+             device,
+             snd_pcm_format_name(negotiated.format),
+             (negotiated.access == SND_PCM_ACCESS_MMAP_INTERLEAVED) ? "mmap" : "writei",
+             negotiated.sampleRate,
+             negotiated.channels,
+             negotiated.periodFrames,
+             negotiated.periods,
+             negotiated.bufferFrames,
+             negotiated.bufferLatencyMs(),
+             negotiated.startThreshold,
+             negotiated.availMin);
+   }
+}
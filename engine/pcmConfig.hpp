@@ -0,0 +1,64 @@
+/*
+ *  Explicit ring buffer configuration built on top of snd_pcm_hw_params / snd_pcm_sw_params.
+ *  Instead of handing a latency window to snd_pcm_set_params and taking whatever the plugin picks,
+ *  the period size, period count, start threshold and avail_min are requested one by one
+ *  and the values which the driver really negotiated are reported back.
+ */
+
+#pragma once
+
+#include <alsa/asoundlib.h>
+#include <stdint.h>
+
+namespace audio
+{
+   struct PcmConfig
+   {
+      const char* name;              /* human readable preset name */
+      uint32_t    periodFrames;      /* frames between two hardware interrupts */
+      uint32_t    periods;           /* amount of periods in the ring buffer */
+      uint32_t    startThreshold;    /* frames queued before playback starts - 0 means a full buffer */
+      uint32_t    availMin;          /* free frames needed to wake up the writer - 0 means one period */
+   };
+
+   namespace presets
+   {
+      const PcmConfig LOW_LATENCY { "low-latency 2x128", 128, 2, 0, 0 };    /* 5.3 ms of buffering at 48 kHz */
+      const PcmConfig BALANCED { "balanced 3x1152", 1152, 3, 0, 0 };        /* matches the 24 ms processing frame of the demos */
+      const PcmConfig THROUGHPUT { "throughput 4x4096", 4096, 4, 0, 0 };    /* 341 ms of buffering, few wakeups */
+   }
+
+   /* returns the preset which name starts with the given string (e.g. "low-latency") or nullptr */
+   const PcmConfig* findPreset(const char* name);
+
+   struct NegotiatedParams
+   {
+      snd_pcm_format_t  format = SND_PCM_FORMAT_UNKNOWN;
+      snd_pcm_access_t  access = SND_PCM_ACCESS_RW_INTERLEAVED;
+      uint32_t          sampleRate = 0;
+      uint32_t          channels = 0;
+      snd_pcm_uframes_t periodFrames = 0;
+      uint32_t          periods = 0;
+      snd_pcm_uframes_t bufferFrames = 0;
+      snd_pcm_uframes_t startThreshold = 0;
+      snd_pcm_uframes_t availMin = 0;
+
+      /* worst case latency introduced by a completely filled ring buffer */
+      double bufferLatencyMs() const { return sampleRate ? (1000.0 * bufferFrames) / sampleRate : 0.0; }
+   };
+
+   /* requests the hardware configuration and reads back the negotiated values, returns 0 or a negative ALSA error code */
+   /* SND_PCM_ACCESS_MMAP_INTERLEAVED falls back to SND_PCM_ACCESS_RW_INTERLEAVED when the device can't map its buffer */
+   /* the sample format is negotiated with negotiateFormat() - SND_PCM_FORMAT_UNKNOWN lets the device pick a native one */
+   int applyHwParams(snd_pcm_t* handle, snd_pcm_format_t format, snd_pcm_access_t access, uint32_t sampleRate,
+                     uint32_t channels, const PcmConfig& config, NegotiatedParams& negotiated);
+
+   /* sets exactly the formerly negotiated values (no format probing and no _near searches) - the fast start path */
+   /* of DeviceCache, returns 0 or a negative ALSA error code without printing, as the caller negotiates again    */
+   int applyKnownHwParams(snd_pcm_t* handle, const NegotiatedParams& known, NegotiatedParams& negotiated);
+
+   /* sets the start threshold and avail_min, must be called after applyHwParams */
+   int applySwParams(snd_pcm_t* handle, const PcmConfig& config, NegotiatedParams& negotiated);
+
+   void printNegotiated(const char* device, const NegotiatedParams& negotiated);
+}
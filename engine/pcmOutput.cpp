@@ -0,0 +1,596 @@
+#include "pcmOutput.hpp"
+#include "sampleFormat.hpp"
+#include "deviceCache.hpp"
+#include "deviceList.hpp"
+#include <algorithm>
+
+namespace audio
+{
+   namespace
+   {
+      constexpr uint32_t STAGING_BUFFERS = 2;   /* writei fallback of the render() path */
+   }
+
+   PcmOutput::~PcmOutput()
+   {
+      close();
+   }
+
+   int PcmOutput::open(const PcmFormat& format)
+   {
+      close();
+
+      if (format.renderFile != nullptr)
+      {
+         return openFile(format);
+      }
+
+      return openDevice(format, nullptr);
+   }
+
+   int PcmOutput::open(const PcmFormat& format, DeviceCache& cache)
+   {
+      close();
+
+      if (format.renderFile != nullptr)
+      {
+         return openFile(format);
+      }
+
+      int err = openCached(format, cache, false);
+
+      // the requested device is gone (unplugged, renamed, busy): the last good ones first, enumerating costs more
+      // (the names are copied, opening them updates the cache)
+      std::vector<std::string> lastGood;
+      for (auto entry : cache.lastGood())
+      {
+         lastGood.push_back(entry->device);
+      }
+
+      for (size_t i = 0; (err < 0) && (i < lastGood.size()); ++i)
+      {
+         PcmFormat fallback = format;
+         fallback.device = lastGood[i].c_str();
+         if (lastGood[i] != stableDeviceName(format.device))
+         {
+            printf("Trying the last good device \"%s\"\n", fallback.device);
+            err = openCached(fallback, cache, true);
+         }
+      }
+
+      if (err < 0)
+      {
+         for (const auto& device : listDevices())
+         {
+            PcmFormat fallback = format;
+            fallback.device = device.name.c_str();
+            if ((device.name != format.device) && (device.name != "null") && ((err = openCached(fallback, cache, true)) == 0))
+            {
+               printf("Fell back to the enumerated device \"%s\"\n", fallback.device);
+               break;
+            }
+         }
+      }
+
+      if ((err == 0) && ((err = cache.save()) < 0))
+      {
+         printf("Playing without the device cache %s\n", cache.path().c_str());
+      }
+
+      return isOpen() ? 0 : err;
+   }
+
+   int PcmOutput::openCached(const PcmFormat& format, DeviceCache& cache, bool quiet)
+   {
+      int err;
+      const CachedDevice* entry = cache.find(format);
+
+      if (entry != nullptr)
+      {
+         if (openDevice(format, &entry->negotiated) == 0)
+         {
+            cache.remember(format, _handle, _negotiated);
+            return 0;
+         }
+         printf("The cached parameters of \"%s\" were rejected, negotiating again\n", format.device);
+         cache.forget(format);
+      }
+      else if (!quiet)
+      {
+         printf("No cached parameters of \"%s\", negotiating\n", format.device);
+      }
+
+      if ((err = openDevice(format, nullptr)) < 0)
+      {
+         return err;
+      }
+
+      cache.remember(format, _handle, _negotiated);
+      return 0;
+   }
+
+   int PcmOutput::openDevice(const PcmFormat& format, const NegotiatedParams* known)
+   {
+      int err;
+
+      const int openMode = (format.pacing == Pacing::DeviceClock) ? SND_PCM_NONBLOCK : 0;
+
+      if ((err = snd_pcm_open(&_handle, format.device, SND_PCM_STREAM_PLAYBACK, openMode)) < 0)
+      {
+         printf("Playback open error: %s\n", snd_strerror(err));
+         _handle = nullptr;
+         return err;
+      }
+
+      if (known != nullptr)
+      {
+         err = applyKnownHwParams(_handle, *known, _negotiated);
+      }
+      else
+      {
+         err = applyHwParams(_handle, format.format, format.access, format.sampleRate,
+                             format.channels, format.config, _negotiated);
+      }
+
+      if (err < 0)
+      {
+         close();
+         return err;
+      }
+
+      if ((err = applySwParams(_handle, format.config, _negotiated)) < 0)
+      {
+         close();
+         return err;
+      }
+
+      _device = format.device;
+      _format = format;
+      _format.device = _device.c_str();
+      _frameBytes = (snd_pcm_format_physical_width(_negotiated.format) / 8) * format.channels;
+      _stats.reset();
+
+      if (!usesMmap() && ((err = _stagingPool.init(STAGING_BUFFERS, _negotiated.periodFrames, _frameBytes)) < 0))
+      {
+         close();
+         return err;
+      }
+
+      if ((err = setupPacing()) < 0)
+      {
+         close();
+         return err;
+      }
+
+      return 0;
+   }
+
+   int PcmOutput::openFile(const PcmFormat& format)
+   {
+      int err;
+
+      // the "device" takes whatever was requested, a native format when the choice was left to it
+      _negotiated = NegotiatedParams {};
+      _negotiated.format = (format.format == SND_PCM_FORMAT_UNKNOWN) ? SND_PCM_FORMAT_S16 : format.format;
+      _negotiated.access = SND_PCM_ACCESS_RW_INTERLEAVED;
+      _negotiated.sampleRate = format.sampleRate;
+      _negotiated.channels = format.channels;
+      _negotiated.periodFrames = format.config.periodFrames;
+      _negotiated.periods = format.config.periods;
+      _negotiated.bufferFrames = format.config.periodFrames * format.config.periods;
+      _negotiated.startThreshold = _negotiated.bufferFrames;
+      _negotiated.availMin = format.config.periodFrames;
+
+      if ((err = _sink.open(format.renderFile, _negotiated.format, format.sampleRate, format.channels,
+                            FileSink::containerFor(format.renderFile))) < 0)
+      {
+         return err;
+      }
+
+      _format = format;
+      _frameBytes = (snd_pcm_format_physical_width(_negotiated.format) / 8) * format.channels;
+      _stats.reset();
+      _openMicros = monotonicMicros();
+
+      if ((err = _stagingPool.init(STAGING_BUFFERS, _negotiated.periodFrames, _frameBytes)) < 0)
+      {
+         close();
+         return err;
+      }
+
+      printf("Rendering offline to %s\n", format.renderFile);
+      return 0;
+   }
+
+   int PcmOutput::setupPacing()
+   {
+      int err;
+
+      // avail_min was already set by applySwParams - poll() wakes us once that much room is free
+      auto fdCount = snd_pcm_poll_descriptors_count(_handle);
+      if (fdCount <= 0)
+      {
+         printf("Invalid poll descriptors count\n");
+         return fdCount < 0 ? fdCount : -EINVAL;
+      }
+
+      _pollFds.resize(fdCount);
+      if ((err = snd_pcm_poll_descriptors(_handle, _pollFds.data(), fdCount)) < 0)
+      {
+         printf("Unable to obtain poll descriptors: %s\n", snd_strerror(err));
+         return err;
+      }
+
+      return 0;
+   }
+
+   bool PcmOutput::needsByteSwap() const
+   {
+      return (_format.format != SND_PCM_FORMAT_UNKNOWN) && (_negotiated.format != _format.format);
+   }
+
+   void PcmOutput::toDeviceOrder(void* frames, snd_pcm_uframes_t frameCount) const
+   {
+      if (needsByteSwap())
+      {
+         byteSwapSamples(frames, frameCount * _format.channels, _negotiated.format);
+      }
+   }
+
+   int PcmOutput::recover(int err)
+   {
+      AUDIO_TRACE_INSTANT("recover", err);
+      PcmStats::add(_stats.recovers);
+      if (err == -EPIPE)
+      {
+         PcmStats::add(_stats.underruns);
+         AUDIO_TRACE_XRUN();
+      }
+      else if (err == -ESTRPIPE)
+      {
+         PcmStats::add(_stats.suspends);
+      }
+
+      err = snd_pcm_recover(_handle, err, 0);
+      if (err < 0)
+      {
+         PcmStats::add(_stats.recoverFailures);
+         printf("Can't recover from the stream error: %s\n", snd_strerror(err));
+      }
+
+      return err;
+   }
+
+   void PcmOutput::sampleLatency()
+   {
+      snd_pcm_sframes_t avail = 0;
+      snd_pcm_sframes_t delay = 0;
+
+      // a single hwsync for both values, an error is left to the write which follows
+      if (snd_pcm_avail_delay(_handle, &avail, &delay) == 0)
+      {
+         _stats.availFrames.record(static_cast<uint64_t>(std::max<snd_pcm_sframes_t>(avail, 0)));
+         _stats.delayFrames.record(static_cast<uint64_t>(std::max<snd_pcm_sframes_t>(delay, 0)));
+      }
+   }
+
+   snd_pcm_sframes_t PcmOutput::waitForPeriod(int timeoutMs)
+   {
+      bool slept = false;
+
+      // a file never runs full, the render loop is not paced at all
+      if (isOffline())
+      {
+         return _negotiated.bufferFrames;
+      }
+
+      while (true)
+      {
+         auto avail = snd_pcm_avail_update(_handle);
+
+         if (avail < 0)
+         {
+            if ((avail = recover(avail)) < 0)
+            {
+               return avail;
+            }
+            continue;
+         }
+
+         // a stream which was not started yet has the whole buffer available, thus it never waits here
+         if (avail >= static_cast<snd_pcm_sframes_t>(_negotiated.availMin))
+         {
+            // every frame beyond avail_min was freed by the device while the thread was not yet running
+            if (slept && _format.latencyStats)
+            {
+               const auto lateFrames = static_cast<uint64_t>(avail) - _negotiated.availMin;
+               _stats.wakeupLatenessMicros.record((lateFrames * 1000000u) / _negotiated.sampleRate);
+            }
+            return avail;
+         }
+
+         auto ready = poll(_pollFds.data(), _pollFds.size(), timeoutMs);
+         slept = true;
+         AUDIO_TRACE_INSTANT("poll wake", ready);
+         if (ready < 0)
+         {
+            if (errno == EINTR)
+            {
+               continue;
+            }
+            return -errno;
+         }
+         if (ready == 0)
+         {
+            return 0;
+         }
+
+         unsigned short revents = 0;
+         snd_pcm_poll_descriptors_revents(_handle, _pollFds.data(), _pollFds.size(), &revents);
+
+         if (revents & (POLLERR | POLLNVAL))
+         {
+            auto state = snd_pcm_state(_handle);
+            auto err = recover((state == SND_PCM_STATE_SUSPENDED) ? -ESTRPIPE : -EPIPE);
+            if (err < 0)
+            {
+               return err;
+            }
+         }
+      }
+   }
+
+   snd_pcm_sframes_t PcmOutput::write(const void* frames, snd_pcm_uframes_t frameCount)
+   {
+      auto src = static_cast<const uint8_t*>(frames);
+      snd_pcm_uframes_t written = 0;
+      uint64_t startMicros = 0;
+
+      if (isOffline())
+      {
+         auto err = _sink.write(frames, frameCount);
+         if (err < 0)
+         {
+            return err;
+         }
+
+         PcmStats::add(_stats.writes);
+         PcmStats::add(_stats.frames, frameCount);
+         return frameCount;
+      }
+
+      if (_format.latencyStats)
+      {
+         sampleLatency();
+         startMicros = monotonicMicros();
+      }
+
+      AUDIO_TRACE_SCOPE("writei");
+      while (written < frameCount)
+      {
+         auto res = snd_pcm_writei(_handle, src + (written * _frameBytes), frameCount - written);
+
+         if (res == -EAGAIN)
+         {
+            snd_pcm_wait(_handle, -1);
+            continue;
+         }
+
+         if (res < 0)
+         {
+            if ((res = recover(res)) < 0)
+            {
+               printf("snd_pcm_writei failed: %s\n", snd_strerror(res));
+               return res;
+            }
+            continue; // recovered - retry the remaining frames
+         }
+
+         if (static_cast<snd_pcm_uframes_t>(res) < (frameCount - written))
+         {
+            PcmStats::add(_stats.shortWrites);
+         }
+
+         written += res;
+      }
+
+      PcmStats::add(_stats.writes);
+      PcmStats::add(_stats.frames, written);
+      if (_format.latencyStats)
+      {
+         _stats.writeMicros.record(monotonicMicros() - startMicros);
+      }
+
+      return written;
+   }
+
+   snd_pcm_sframes_t PcmOutput::beginWrite(void*& area, snd_pcm_uframes_t maxFrames)
+   {
+      if (!usesMmap())
+      {
+         if (!_staging && !(_staging = _stagingPool.acquire()))
+         {
+            return -ENOBUFS;
+         }
+         area = _staging.data();
+         return std::min<snd_pcm_uframes_t>(maxFrames, _negotiated.periodFrames);
+      }
+
+      while (true)
+      {
+         auto avail = snd_pcm_avail_update(_handle);
+         if (avail < 0)
+         {
+            if ((avail = recover(avail)) < 0)
+            {
+               return avail;
+            }
+            continue;
+         }
+
+         if (avail == 0)
+         {
+            // the ring buffer is full - wait for the device to consume a period
+            auto err = (_format.pacing == Pacing::DeviceClock) ? waitForPeriod() : snd_pcm_wait(_handle, -1);
+            if (err < 0)
+            {
+               if ((err = recover(err)) < 0)
+               {
+                  return err;
+               }
+            }
+            continue;
+         }
+
+         const snd_pcm_channel_area_t* areas = nullptr;
+         snd_pcm_uframes_t frames = std::min<snd_pcm_uframes_t>(avail, maxFrames);
+
+         auto err = snd_pcm_mmap_begin(_handle, &areas, &_mmapOffset, &frames);
+         if (err < 0)
+         {
+            if ((err = recover(err)) < 0)
+            {
+               return err;
+            }
+            continue;
+         }
+
+         // interleaved access - all channels share one area, the first one marks the start of a frame
+         area = static_cast<uint8_t*>(areas[0].addr) + (areas[0].first / 8) + (_mmapOffset * (areas[0].step / 8));
+         return frames;
+      }
+   }
+
+   snd_pcm_sframes_t PcmOutput::commitWrite(snd_pcm_uframes_t frameCount)
+   {
+      if (!usesMmap())
+      {
+         auto res = write(_staging.data(), frameCount);
+         _staging.reset();
+         return res;
+      }
+
+      uint64_t startMicros = 0;
+      AUDIO_TRACE_SCOPE("mmap commit");
+      if (_format.latencyStats)
+      {
+         sampleLatency();
+         startMicros = monotonicMicros();
+      }
+
+      auto res = snd_pcm_mmap_commit(_handle, _mmapOffset, frameCount);
+
+      if (_format.latencyStats)
+      {
+         _stats.writeMicros.record(monotonicMicros() - startMicros);
+      }
+
+      if ((res < 0) || (static_cast<snd_pcm_uframes_t>(res) != frameCount))
+      {
+         auto err = recover((res >= 0) ? -EPIPE : res);
+         if (err < 0)
+         {
+            printf("snd_pcm_mmap_commit failed: %s\n", snd_strerror(err));
+            return err;
+         }
+         return 0; // the frames got lost in the xrun, the caller simply renders the next ones
+      }
+
+      PcmStats::add(_stats.writes);
+      PcmStats::add(_stats.frames, res);
+      return res;
+   }
+
+   snd_pcm_sframes_t PcmOutput::delayFrames() const
+   {
+      if (isOffline())
+      {
+         return 0;
+      }
+
+      snd_pcm_sframes_t delay = 0;
+      const auto err = snd_pcm_delay(_handle, &delay);
+      return (err < 0) ? err : delay;
+   }
+
+   int PcmOutput::framePosition(uint64_t atMicros, uint64_t& frame) const
+   {
+      const auto written = _stats.frames.load(std::memory_order_relaxed);
+
+      // a file has no clock of its own, the time from now on is counted as if it was played from the next frame
+      if (isOffline())
+      {
+         const auto now = monotonicMicros();
+         frame = written + ((atMicros > now) ? ((atMicros - now) * _negotiated.sampleRate) / 1000000u : 0u);
+         return 0;
+      }
+
+      if (_handle == nullptr)
+      {
+         return -EBADFD;
+      }
+
+      snd_pcm_uframes_t avail = 0;
+      snd_htimestamp_t stamp {};
+
+      auto err = snd_pcm_htimestamp(_handle, &avail, &stamp);
+      if (err < 0)
+      {
+         return err;
+      }
+
+      // before the start (or without a stamp) the queued frames begin to play right away
+      uint64_t stampMicros = (static_cast<uint64_t>(stamp.tv_sec) * 1000000u) + (static_cast<uint64_t>(stamp.tv_nsec) / 1000u);
+      if ((stampMicros == 0) || (snd_pcm_state(_handle) != SND_PCM_STATE_RUNNING))
+      {
+         stampMicros = monotonicMicros();
+      }
+
+      const auto queued = static_cast<int64_t>(_negotiated.bufferFrames) - static_cast<int64_t>(std::min(avail, _negotiated.bufferFrames));
+      const auto playing = static_cast<int64_t>(written) - queued;
+      const auto ahead = ((static_cast<int64_t>(atMicros) - static_cast<int64_t>(stampMicros)) * _negotiated.sampleRate) / 1000000;
+
+      frame = static_cast<uint64_t>(std::max<int64_t>(playing + ahead, 0));
+      return 0;
+   }
+
+   int PcmOutput::drain()
+   {
+      if (isOffline())
+      {
+         const double seconds = (monotonicMicros() - _openMicros) / 1e6;
+         const double audioSeconds = static_cast<double>(_sink.framesWritten()) / _negotiated.sampleRate;
+
+         printf("Rendered %.1f s of audio in %.3f s - realtime factor %.1f\n", audioSeconds, seconds,
+                (seconds > 0.0) ? audioSeconds / seconds : 0.0);
+         return _sink.close();
+      }
+
+      if (_handle == nullptr)
+      {
+         return -EBADFD;
+      }
+
+      // snd_pcm_drain() of a non-blocking (DeviceClock) handle returns -EAGAIN instead of waiting for the tail
+      auto err = snd_pcm_nonblock(_handle, 0);
+      if (err == 0)
+         err = snd_pcm_drain(_handle);
+      if (err < 0)
+         printf("snd_pcm_drain failed: %s\n", snd_strerror(err));
+
+      return err;
+   }
+
+   void PcmOutput::close()
+   {
+      _staging.reset();
+      _sink.close();
+
+      if (_handle != nullptr)
+      {
+         snd_pcm_close(_handle);
+         _handle = nullptr;
+         _pollFds.clear();
+      }
+   }
+}
@@ -0,0 +1,167 @@
+/*
+ *  A small playback engine shared by all the demo programs.
+ *  It owns the ALSA pcm handle and takes care of the open / configure / write / recover / drain sequence,
+ *  so that the demos only have to worry about generating the audio samples.
+ *  With PcmFormat::renderFile set no device is opened at all: the frames go to a WAV / raw file as fast as
+ *  they are produced (offline rendering), while the demos keep using the very same calls.
+ */
+
+#pragma once
+
+#include "pcmConfig.hpp"
+#include "framePool.hpp"
+#include "pcmStats.hpp"
+#include "fileSink.hpp"
+#include "trace.hpp"
+#include <alsa/asoundlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace audio
+{
+   class DeviceCache;
+
+   enum class Pacing
+   {
+      Blocking,    /* snd_pcm_writei blocks until there is room in the ring buffer */
+      DeviceClock  /* non-blocking handle, the writer is woken by poll() once avail_min frames are free */
+   };
+
+   struct PcmFormat
+   {
+      const char*      device = "default";              /* playback device */
+      snd_pcm_format_t format = SND_PCM_FORMAT_S16;     /* host byte order format the samples are generated in */
+      uint32_t         sampleRate = 48000;              /* sampling rate in Hz */
+      uint32_t         channels = 2;                    /* amount of interleaved channels in a single frame */
+      PcmConfig        config = presets::BALANCED;      /* period and ring buffer layout */
+      Pacing           pacing = Pacing::Blocking;       /* how the writer is paced against the device */
+      snd_pcm_access_t access = SND_PCM_ACCESS_RW_INTERLEAVED; /* MMAP_INTERLEAVED renders straight into the ring buffer */
+      bool             latencyStats = true;             /* samples delay / avail and times every write for stats() */
+      const char*      renderFile = nullptr;            /* offline: renders to this .wav (or raw) file instead of the device */
+   };
+
+   class PcmOutput
+   {
+   public:
+      PcmOutput() = default;
+      ~PcmOutput();
+
+      PcmOutput(const PcmOutput&) = delete;
+      PcmOutput& operator=(const PcmOutput&) = delete;
+
+      /* opens and configures the playback device, returns 0 or a negative ALSA error code */
+      int open(const PcmFormat& format);
+
+      /* the fast start: sets the parameters the cache holds for the device and the request right away,      */
+      /* negotiates and caches them otherwise - when the device doesn't open at all the last good devices of  */
+      /* the cache are tried, the enumerated ones only after them. format().device tells which one was opened */
+      int open(const PcmFormat& format, DeviceCache& cache);
+
+      /* writes all of the given interleaved frames, short writes are continued and xruns recovered */
+      /* returns the amount of written frames or a negative ALSA error code when recovery was not possible */
+      snd_pcm_sframes_t write(const void* frames, snd_pcm_uframes_t frameCount);
+
+      /* hands out a contiguous area (at most maxFrames) to render interleaved frames into                    */
+      /* with mmap access that is the DMA ring buffer itself, with writei a period buffer borrowed from a pool  */
+      /* returns the amount of frames the area can take or a negative ALSA error code                         */
+      snd_pcm_sframes_t beginWrite(void*& area, snd_pcm_uframes_t maxFrames);
+
+      /* passes the frames rendered into the area from beginWrite to the device */
+      snd_pcm_sframes_t commitWrite(snd_pcm_uframes_t frameCount);
+
+      /* calls renderFn(void* area, snd_pcm_uframes_t frames) until frameCount frames were delivered,      */
+      /* the rendered host byte order samples are swapped to the device order when needed                  */
+      template <typename TRender>
+      snd_pcm_sframes_t render(snd_pcm_uframes_t frameCount, TRender&& renderFn)
+      {
+         snd_pcm_uframes_t done = 0;
+         AUDIO_TRACE_SCOPE("period");
+
+         while (done < frameCount)
+         {
+            void* area = nullptr;
+            auto frames = beginWrite(area, frameCount - done);
+            if (frames < 0)
+            {
+               return frames;
+            }
+
+            {
+               AUDIO_TRACE_SCOPE("render");
+               renderFn(area, static_cast<snd_pcm_uframes_t>(frames));
+            }
+            toDeviceOrder(area, frames);
+
+            auto res = commitWrite(frames);
+            if (res < 0)
+            {
+               return res;
+            }
+            done += res;
+         }
+
+         return done;
+      }
+
+      bool usesMmap() const { return _negotiated.access == SND_PCM_ACCESS_MMAP_INTERLEAVED; }
+
+      /* true when the device only accepts the opposite byte order of the generated samples */
+      bool needsByteSwap() const;
+
+      /* converts generated samples in place to the byte order of the device - a no-op for native formats */
+      void toDeviceOrder(void* frames, snd_pcm_uframes_t frameCount) const;
+
+      /* sleeps until at least one period (avail_min) of free space is available in the ring buffer */
+      /* returns the amount of available frames, 0 on timeout or a negative ALSA error code */
+      snd_pcm_sframes_t waitForPeriod(int timeoutMs = -1);
+
+      /* frames queued in front of the DAC (snd_pcm_delay), 0 when rendering offline or a negative ALSA error code */
+      snd_pcm_sframes_t delayFrames() const;
+
+      /* the stream frame - counted from open() like the written frames - the DAC plays at atMicros (monotonicMicros()) */
+      /* mapped from the hw pointer timestamp of snd_pcm_htimestamp(), offline from the next frame to write onwards  */
+      /* returns 0 or a negative ALSA error code                                                                     */
+      int framePosition(uint64_t atMicros, uint64_t& frame) const;
+
+      /* plays the remaining samples, otherwise they are dropped on close - waits for them with DeviceClock pacing as well */
+      /* (the handle is switched to blocking mode for that, it is closed next anyway)                               */
+      int drain();
+
+      void close();
+
+      bool isOpen() const { return (_handle != nullptr) || _sink.isOpen(); }
+      bool isOffline() const { return _sink.isOpen(); }
+      snd_pcm_t* handle() const { return _handle; }
+      const PcmFormat& format() const { return _format; }
+      const NegotiatedParams& negotiated() const { return _negotiated; }
+      size_t frameBytes() const { return _frameBytes; }
+
+      /* lock-free, may be read (e.g. with printStats) from any thread while playing */
+      const PcmStats& stats() const { return _stats; }
+      uint64_t shortWriteCount() const { return _stats.shortWrites.load(std::memory_order_relaxed); }
+      uint64_t recoverCount() const { return _stats.recovers.load(std::memory_order_relaxed); }
+
+   private:
+      int openFile(const PcmFormat& format);
+      int openDevice(const PcmFormat& format, const NegotiatedParams* known);
+      int openCached(const PcmFormat& format, DeviceCache& cache, bool quiet);
+      int setupPacing();
+      int recover(int err);
+      void sampleLatency();
+
+      snd_pcm_t* _handle = nullptr;
+      std::vector<struct pollfd> _pollFds {};
+      FramePool  _stagingPool {};         /* sized from the negotiated period at open */
+      FramePool::Buffer _staging {};
+      snd_pcm_uframes_t _mmapOffset = 0;
+      PcmFormat  _format {};
+      std::string _device {};             /* _format.device points here, the name may come from the cache */
+      NegotiatedParams _negotiated {};
+      size_t     _frameBytes = 0;
+      PcmStats   _stats {};
+      FileSink   _sink {};
+      uint64_t   _openMicros = 0;         /* start of an offline render, for the realtime factor */
+   };
+}
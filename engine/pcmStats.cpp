@@ -0,0 +1,155 @@
+#include "pcmStats.hpp"
+
+#include <time.h>
+#include <initializer_list>
+
+namespace audio
+{
+   size_t LogHistogram::bucketOf(uint64_t value)
+   {
+      if (value < 4)
+      {
+         return static_cast<size_t>(value);
+      }
+
+      const auto octave = 63 - __builtin_clzll(value);
+      const auto sub = (value >> (octave - 2)) & 3;
+      const auto bucket = (4 * static_cast<size_t>(octave - 1)) + sub;
+
+      return (bucket < BUCKETS) ? bucket : BUCKETS - 1;
+   }
+
+   uint64_t LogHistogram::bucketUpperBound(size_t bucket)
+   {
+      if (bucket < 4)
+      {
+         return bucket;
+      }
+
+      // the lower bound of the next bucket minus one
+      const auto next = bucket + 1;
+      const auto octave = (next / 4) + 1;
+      return (static_cast<uint64_t>(4 + (next % 4)) << (octave - 2)) - 1;
+   }
+
+   void LogHistogram::record(uint64_t value)
+   {
+      auto& bucket = _buckets[bucketOf(value)];
+      bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      _count.store(_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+      if (value > _max.load(std::memory_order_relaxed))
+      {
+         _max.store(value, std::memory_order_relaxed);
+      }
+   }
+
+   void LogHistogram::reset()
+   {
+      for (auto& bucket : _buckets)
+      {
+         bucket.store(0, std::memory_order_relaxed);
+      }
+      _count.store(0, std::memory_order_relaxed);
+      _max.store(0, std::memory_order_relaxed);
+   }
+
+   uint64_t LogHistogram::percentile(double p) const
+   {
+      const auto total = count();
+      if (total == 0)
+      {
+         return 0;
+      }
+
+      const auto rank = static_cast<uint64_t>((p / 100.0) * static_cast<double>(total - 1)) + 1;
+      uint64_t seen = 0;
+
+      for (size_t b = 0; b < BUCKETS; ++b)
+      {
+         seen += _buckets[b].load(std::memory_order_relaxed);
+         if (seen >= rank)
+         {
+            // the bucket bound may overshoot the largest recorded value
+            const auto bound = bucketUpperBound(b);
+            return (bound < max()) ? bound : max();
+         }
+      }
+
+      return max();
+   }
+
+   void PcmStats::reset()
+   {
+      for (auto* counter : { &writes, &frames, &shortWrites, &underruns, &suspends, &recovers, &recoverFailures })
+      {
+         counter->store(0, std::memory_order_relaxed);
+      }
+
+      delayFrames.reset();
+      availFrames.reset();
+      writeMicros.reset();
+      wakeupLatenessMicros.reset();
+   }
+
+   uint64_t monotonicMicros()
+   {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (static_cast<uint64_t>(ts.tv_sec) * 1000000u) + (static_cast<uint64_t>(ts.tv_nsec) / 1000u);
+   }
+
+   namespace
+   {
+      void printHistogramLine(FILE* out, const char* name, const LogHistogram& h)
+      {
+         fprintf(out, " | %s p50 %llu p99 %llu max %llu", name,
+                 static_cast<unsigned long long>(h.percentile(50.0)),
+                 static_cast<unsigned long long>(h.percentile(99.0)),
+                 static_cast<unsigned long long>(h.max()));
+      }
+
+      void printHistogramJson(FILE* out, const char* name, const LogHistogram& h, bool last)
+      {
+         fprintf(out, "\"%s\":{\"count\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}%s", name,
+                 static_cast<unsigned long long>(h.count()),
+                 static_cast<unsigned long long>(h.percentile(50.0)),
+                 static_cast<unsigned long long>(h.percentile(90.0)),
+                 static_cast<unsigned long long>(h.percentile(99.0)),
+                 static_cast<unsigned long long>(h.percentile(99.9)),
+                 static_cast<unsigned long long>(h.max()),
+                 last ? "" : ",");
+      }
+
+      unsigned long long value(const std::atomic<uint64_t>& counter)
+      {
+         return static_cast<unsigned long long>(counter.load(std::memory_order_relaxed));
+      }
+   }
+
+   void printStats(const PcmStats& stats, StatsReport report, FILE* out)
+   {
+      if (report == StatsReport::Json)
+      {
+         fprintf(out, "{\"writes\":%llu,\"frames\":%llu,\"short_writes\":%llu,\"underruns\":%llu,\"suspends\":%llu,"
+                      "\"recovers\":%llu,\"recover_failures\":%llu,",
+                 value(stats.writes), value(stats.frames), value(stats.shortWrites), value(stats.underruns),
+                 value(stats.suspends), value(stats.recovers), value(stats.recoverFailures));
+         printHistogramJson(out, "delay_frames", stats.delayFrames, false);
+         printHistogramJson(out, "avail_frames", stats.availFrames, false);
+         printHistogramJson(out, "write_us", stats.writeMicros, false);
+         printHistogramJson(out, "wakeup_lateness_us", stats.wakeupLatenessMicros, true);
+         fprintf(out, "}\n");
+         return;
+      }
+
+      fprintf(out, "writes %llu frames %llu | xruns %llu suspends %llu recovers %llu short %llu",
+              value(stats.writes), value(stats.frames), value(stats.underruns), value(stats.suspends),
+              value(stats.recovers), value(stats.shortWrites));
+      printHistogramLine(out, "delay", stats.delayFrames);
+      printHistogramLine(out, "avail", stats.availFrames);
+      printHistogramLine(out, "write us", stats.writeMicros);
+      printHistogramLine(out, "late us", stats.wakeupLatenessMicros);
+      fprintf(out, "\n");
+   }
+}
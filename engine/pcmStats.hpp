@@ -0,0 +1,75 @@
+/*
+ *  Playback telemetry of PcmOutput: xrun / recover counters, histograms of the ring buffer delay and
+ *  free space, of the write call duration and of the wakeup lateness of the writer thread.
+ *  Everything is a relaxed atomic written by the thread owning the PCM handle, so any other thread can
+ *  read (and report) the stats at any time without locks and without disturbing the writer.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <atomic>
+
+namespace audio
+{
+   /* log2 histogram with 4 linear sub-buckets per octave - at most 25% quantization error, any uint32 value */
+   class LogHistogram
+   {
+   public:
+      static constexpr size_t BUCKETS = 128;
+
+      void record(uint64_t value);
+      void reset();
+
+      uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+      uint64_t max() const { return _max.load(std::memory_order_relaxed); }
+
+      /* upper bound of the bucket holding the given percentile (0..100), 0 when empty */
+      uint64_t percentile(double p) const;
+
+   private:
+      static size_t bucketOf(uint64_t value);
+      static uint64_t bucketUpperBound(size_t bucket);
+
+      std::atomic<uint64_t> _buckets[BUCKETS] {};
+      std::atomic<uint64_t> _count { 0 };
+      std::atomic<uint64_t> _max { 0 };
+   };
+
+   struct PcmStats
+   {
+      std::atomic<uint64_t> writes { 0 };           /* write / commit calls */
+      std::atomic<uint64_t> frames { 0 };           /* frames passed to the device */
+      std::atomic<uint64_t> shortWrites { 0 };
+      std::atomic<uint64_t> underruns { 0 };        /* -EPIPE handed to snd_pcm_recover */
+      std::atomic<uint64_t> suspends { 0 };         /* -ESTRPIPE handed to snd_pcm_recover */
+      std::atomic<uint64_t> recovers { 0 };         /* every snd_pcm_recover call */
+      std::atomic<uint64_t> recoverFailures { 0 };
+
+      LogHistogram delayFrames;                     /* snd_pcm_delay before each write - the output latency */
+      LogHistogram availFrames;                     /* free space before each write */
+      LogHistogram writeMicros;                     /* duration of each write call, blocking included */
+      LogHistogram wakeupLatenessMicros;            /* how long after avail_min was reached waitForPeriod() returned */
+
+      void reset();
+
+      /* single writer helper - the stats are only ever modified by the thread owning the PCM handle */
+      static void add(std::atomic<uint64_t>& counter, uint64_t value = 1)
+      {
+         counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+      }
+   };
+
+   enum class StatsReport
+   {
+      Line,     /* one human readable line, for periodic printing */
+      Json      /* one JSON object, for collecting the results of a run */
+   };
+
+   void printStats(const PcmStats& stats, StatsReport report = StatsReport::Line, FILE* out = stdout);
+
+   /* microseconds of CLOCK_MONOTONIC - the time base of the stats */
+   uint64_t monotonicMicros();
+}
@@ -0,0 +1,248 @@
+#include "pipeline.hpp"
+
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace audio
+{
+   namespace
+   {
+      snd_pcm_format_t mixFormat(const PcmOutput& output)
+      {
+         // the samples are mixed in the requested (host) order, toDeviceOrder swaps them when needed
+         const auto requested = output.format().format;
+         return (requested == SND_PCM_FORMAT_UNKNOWN) ? output.negotiated().format : requested;
+      }
+   }
+
+   Pipeline::Pipeline(const PcmOutput& output, const PipelineSettings& settings) :
+      _output(output),
+      _settings(settings),
+      _format(mixFormat(output)),
+      _channels(output.negotiated().channels),
+      _sampleRate(output.negotiated().sampleRate),
+      _periodFrames(output.negotiated().periodFrames),
+      _frameBytes(output.frameBytes()),
+      _depthFrames(settings.depthPeriods * output.negotiated().periodFrames),
+      _mixer(_channels, _sampleRate, _periodFrames, settings.maxInputs),
+      _outRing(_depthFrames, static_cast<uint32_t>(_frameBytes)),
+      _mixBuffer(_periodFrames * _frameBytes, 0),
+      _silence(_periodFrames * _frameBytes, 0)
+   {
+      _inputs.reserve(settings.maxInputs);
+   }
+
+   Pipeline::~Pipeline()
+   {
+      stop();
+   }
+
+   int Pipeline::addInput(AudioSource* source, float gain)
+   {
+      if (_inputs.size() >= _settings.maxInputs)
+      {
+         return -ENOSPC;
+      }
+
+      _inputs.emplace_back(new Input(source, _depthFrames, _channels));
+      return _mixer.addVoice(&_inputs.back()->reader, gain);
+   }
+
+   void Pipeline::idle() const
+   {
+      // offline nothing paces the stages, so they only give way to each other
+      if (_output.isOffline())
+      {
+         std::this_thread::yield();
+         return;
+      }
+
+      // a quarter of a period - short enough to refill in time, long enough not to spin
+      std::this_thread::sleep_for(std::chrono::microseconds((_periodFrames * 250000) / _sampleRate));
+   }
+
+   size_t Pipeline::RingSource::render(float* out, size_t frames, uint32_t channels)
+   {
+      size_t done = 0;
+
+      // two spans at most - the second one after the wrap point
+      while (done < frames)
+      {
+         auto span = _ring.readSpan();
+         if (span.frames == 0)
+         {
+            break;
+         }
+
+         const auto count = std::min(span.frames, frames - done);
+         memcpy(out + (done * channels), span.data, count * channels * sizeof(float));
+         _ring.commitRead(count);
+         done += count;
+      }
+
+      // the mix stage only asks for what is readable, so a short block means that the source has finished
+      if ((done < frames) && !_finished.load(std::memory_order_acquire))
+      {
+         memset(out + (done * channels), 0, (frames - done) * channels * sizeof(float));
+         done = frames;
+      }
+
+      return done;
+   }
+
+   bool Pipeline::runSource(Input& input)
+   {
+      if (input.ring.readable() >= _depthFrames)
+      {
+         idle();
+         return true;
+      }
+
+      AUDIO_TRACE_SCOPE("source render");
+      auto span = input.ring.writeSpan();
+      const auto count = std::min(span.frames, _periodFrames);
+      const auto rendered = input.source->render(span.data, count, _channels);
+      input.ring.commitWrite(rendered);
+
+      if (rendered < count)
+      {
+         input.finished.store(true, std::memory_order_release);
+         return false;
+      }
+
+      return true;
+   }
+
+   bool Pipeline::runMix()
+   {
+      if (_mixer.activeVoices() == 0)
+      {
+         _mixFinished.store(true, std::memory_order_release);
+         return false;
+      }
+
+      if (_outRing.readable() + _periodFrames > _depthFrames)
+      {
+         idle();
+         return true;
+      }
+
+      // only whole periods are mixed once every running source delivered them - the gain smoothing
+      // then sees the same blocks in every run, which keeps offline renders bit-exact
+      for (const auto& input : _inputs)
+      {
+         if (!input->finished.load(std::memory_order_acquire) && (input->ring.readable() < _periodFrames))
+         {
+            idle();
+            return true;
+         }
+      }
+
+      AUDIO_TRACE_SCOPE("mix");
+      if (_format == SND_PCM_FORMAT_S16)
+      {
+         _mixer.mix(reinterpret_cast<int16_t*>(_mixBuffer.data()), _periodFrames);
+      }
+      else
+      {
+         _mixer.mix(reinterpret_cast<int32_t*>(_mixBuffer.data()), _periodFrames);
+      }
+
+      // swapped here, the output stage passes the frames untouched - even when they are partially written
+      _output.toDeviceOrder(_mixBuffer.data(), _periodFrames);
+
+      // two spans at most - the ring wraps at a power of two, not at a period boundary
+      size_t done = 0;
+      while (done < _periodFrames)
+      {
+         auto span = _outRing.writeSpan();
+         const auto count = std::min(span.frames, _periodFrames - done);
+         memcpy(span.data, _mixBuffer.data() + (done * _frameBytes), count * _frameBytes);
+         _outRing.commitWrite(count);
+         done += count;
+      }
+
+      return true;
+   }
+
+   int Pipeline::start()
+   {
+      if ((_format != SND_PCM_FORMAT_S16) && (_format != SND_PCM_FORMAT_S32))
+      {
+         printf("The pipeline mixes to S16 or S32, not to %s\n", snd_pcm_format_name(_format));
+         return -EINVAL;
+      }
+
+      auto sourceSettings = _settings.sourceThreads;
+      sourceSettings.name = "pipeline source";
+      for (auto& input : _inputs)
+      {
+         auto* stage = input.get();
+         stage->thread.start(sourceSettings, [this, stage]() { return runSource(*stage); });
+      }
+
+      auto mixSettings = _settings.mixThread;
+      mixSettings.name = "pipeline mix";
+      _mixThread.start(mixSettings, [this]() { return runMix(); });
+
+      // priming - the device starts with a full pipeline instead of starving on the first periods
+      while ((_outRing.readable() < _depthFrames) && !_mixFinished.load(std::memory_order_acquire))
+      {
+         idle();
+      }
+
+      return 0;
+   }
+
+   void Pipeline::stop()
+   {
+      _mixThread.stop();
+      _mixThread.join();
+
+      for (auto& input : _inputs)
+      {
+         input->thread.stop();
+         input->thread.join();
+      }
+   }
+
+   bool Pipeline::finished() const
+   {
+      return _mixFinished.load(std::memory_order_acquire) && (_outRing.readable() == 0);
+   }
+
+   snd_pcm_sframes_t Pipeline::pump(PcmOutput& output)
+   {
+      auto span = _outRing.readSpan();
+
+      // offline there is no deadline - the render waits for the mix stage and stays bit-exact
+      while ((span.frames == 0) && output.isOffline() && !_mixFinished.load(std::memory_order_acquire))
+      {
+         std::this_thread::yield();
+         span = _outRing.readSpan();
+      }
+
+      if (span.frames == 0)
+      {
+         if (_mixFinished.load(std::memory_order_acquire))
+         {
+            return 0;
+         }
+
+         ++_starved;
+         AUDIO_TRACE_INSTANT("pipeline starved", _starved);
+         return output.write(_silence.data(), _periodFrames);
+      }
+
+      const auto written = output.write(span.data, std::min(span.frames, _periodFrames));
+      if (written > 0)
+      {
+         _outRing.commitRead(written);
+      }
+
+      return written;
+   }
+}
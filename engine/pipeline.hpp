@@ -0,0 +1,109 @@
+/*
+ *  Staged playback pipeline: source (read / decode / convert to float) -> mix -> output.
+ *  Every source runs on its own worker and the mixer on another one, the stages are connected by
+ *  SpscFrameRings. Each ring is bounded to a depth of a few periods: a stage whose output ring is full
+ *  idles, which propagates the backpressure of the device clock up to the sources.
+ *  The thread owning the PCM handle only calls pump(), which never waits for a source - when the mix
+ *  stage is late (slow disk, heavy DSP) a period of silence is written and counted instead of an xrun.
+ *  Rendering offline (PcmFormat::renderFile) pump() waits for the mix stage instead, nothing is ever skipped.
+ */
+
+#pragma once
+
+#include "audioSource.hpp"
+#include "mixer.hpp"
+#include "pcmOutput.hpp"
+#include "rtThread.hpp"
+#include "spscRing.hpp"
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace audio
+{
+   struct PipelineSettings
+   {
+      size_t     depthPeriods = 3;      /* bound of every ring, in periods of the device */
+      size_t     maxInputs = 16;
+      RtSettings sourceThreads {};      /* the source workers may block on the disk, normal scheduling by default */
+      RtSettings mixThread {};
+   };
+
+   class Pipeline
+   {
+   public:
+      /* the period, channels and sample format are taken from the opened output, which has to be S16 or S32 */
+      Pipeline(const PcmOutput& output, const PipelineSettings& settings = {});
+      ~Pipeline();
+
+      Pipeline(const Pipeline&) = delete;
+      Pipeline& operator=(const Pipeline&) = delete;
+
+      /* before start() only, returns the voice index of the mixer or a negative errno code */
+      int addInput(AudioSource* source, float gain = 1.0f);
+
+      /* the gains and the headroom can be changed while running */
+      Mixer& mixer() { return _mixer; }
+
+      /* starts the workers and waits until the pipeline is primed, -EINVAL for an unsupported output format */
+      int start();
+      void stop();
+
+      /* output stage: writes up to one period to the device, 0 once every source has finished and was played */
+      snd_pcm_sframes_t pump(PcmOutput& output);
+
+      bool finished() const;
+
+      /* periods of silence written because the mix stage was late */
+      size_t starvedPeriods() const { return _starved; }
+
+   private:
+      /* reads the float output ring of a source stage - the mixer sees it as an ordinary voice */
+      class RingSource : public AudioSource
+      {
+      public:
+         RingSource(SpscFrameRing<float>& ring, const std::atomic<bool>& finished) : _ring(ring), _finished(finished) {}
+         size_t render(float* out, size_t frames, uint32_t channels) override;
+
+      private:
+         SpscFrameRing<float>&    _ring;
+         const std::atomic<bool>& _finished;
+      };
+
+      struct Input
+      {
+         Input(AudioSource* src, size_t capacityFrames, uint32_t channels)
+            : source(src), ring(capacityFrames, channels), reader(ring, finished) {}
+
+         AudioSource*         source;
+         SpscFrameRing<float> ring;
+         std::atomic<bool>    finished { false };
+         RingSource           reader;
+         RenderThread         thread {};
+      };
+
+      bool runSource(Input& input);
+      bool runMix();
+      void idle() const;
+
+      const PcmOutput& _output;
+      PipelineSettings _settings;
+      snd_pcm_format_t _format;
+      uint32_t         _channels;
+      uint32_t         _sampleRate;
+      size_t           _periodFrames;
+      size_t           _frameBytes;
+      size_t           _depthFrames;
+
+      std::vector<std::unique_ptr<Input>> _inputs {};
+      Mixer                  _mixer;
+      SpscFrameRing<uint8_t> _outRing;          /* device format frames, one "channel" per byte */
+      RenderThread           _mixThread {};
+      std::atomic<bool>      _mixFinished { false };
+      std::vector<uint8_t>   _mixBuffer;        /* one period, copied into the output ring across its wrap point */
+      std::vector<uint8_t>   _silence;
+      size_t                 _starved = 0;
+   };
+}
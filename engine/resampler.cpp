@@ -0,0 +1,112 @@
+#include "resampler.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace audio
+{
+   AdaptiveResampler::AdaptiveResampler(uint32_t channels, size_t maxInputFrames) :
+      _channels(channels),
+      _work((maxInputFrames + 4) * channels, 0.0f)
+   {
+      reset();
+   }
+
+   void AdaptiveResampler::reset()
+   {
+      // one frame of silence is the history of the very first output frame
+      std::fill(_work.begin(), _work.end(), 0.0f);
+      _workFrames = 1;
+      _position = 1.0;
+   }
+
+   size_t AdaptiveResampler::inputFramesFor(size_t outFrames) const
+   {
+      if (outFrames == 0)
+      {
+         return 0;
+      }
+
+      // the last output frame interpolates between the frames floor(position) - 1 .. floor(position) + 2
+      const auto last = static_cast<size_t>(_position + ((outFrames - 1) * _ratio));
+      const auto needed = last + 3;
+      return (needed > _workFrames) ? needed - _workFrames : 0;
+   }
+
+   size_t AdaptiveResampler::process(const float* in, size_t inFrames, float* out, size_t outFrames)
+   {
+      const auto channels = _channels;
+      inFrames = std::min(inFrames, (_work.size() / channels) - _workFrames);
+      memcpy(_work.data() + (_workFrames * channels), in, inFrames * channels * sizeof(float));
+      _workFrames += inFrames;
+
+      size_t produced = 0;
+
+      while (produced < outFrames)
+      {
+         const auto index = static_cast<size_t>(_position);
+         if (index + 2 >= _workFrames)
+         {
+            break;
+         }
+
+         // Catmull-Rom weights of the 4 neighbours, computed once per frame and shared by all the channels
+         const auto t = static_cast<float>(_position - index);
+         const auto t2 = t * t;
+         const auto t3 = t2 * t;
+         const float w0 = 0.5f * (-t3 + (2.0f * t2) - t);
+         const float w1 = 0.5f * ((3.0f * t3) - (5.0f * t2) + 2.0f);
+         const float w2 = 0.5f * ((-3.0f * t3) + (4.0f * t2) + t);
+         const float w3 = 0.5f * (t3 - t2);
+
+         const float* p = _work.data() + ((index - 1) * channels);
+         float* o = out + (produced * channels);
+
+         for (uint32_t c = 0; c < channels; ++c)
+         {
+            o[c] = (w0 * p[c]) + (w1 * p[c + channels]) + (w2 * p[c + (2 * channels)]) + (w3 * p[c + (3 * channels)]);
+         }
+
+         _position += _ratio;
+         ++produced;
+      }
+
+      // only the history of the next output frame is kept
+      const auto drop = std::min(static_cast<size_t>(_position) - 1, _workFrames);
+      memmove(_work.data(), _work.data() + (drop * channels), (_workFrames - drop) * channels * sizeof(float));
+      _workFrames -= drop;
+      _position -= drop;
+
+      return produced;
+   }
+
+   void DriftController::reset()
+   {
+      _filtered = 0.0;
+      _target = 0.0;
+      _integral = 0.0;
+      _ratio = 1.0;
+      _updates = 0;
+   }
+
+   double DriftController::update(double fillFrames)
+   {
+      _filtered = (_updates == 0) ? fillFrames : _filtered + (SMOOTHING * (fillFrames - _filtered));
+
+      // the first updates only learn the natural operating point of the sink
+      if (_updates < SETTLE_UPDATES)
+      {
+         ++_updates;
+         _target += fillFrames / SETTLE_UPDATES;
+         return _ratio;
+      }
+
+      // more queued than the target: the sink is slower than the source, so it has to consume faster
+      const auto error = _filtered - _target;
+      _integral = std::max(-MAX_DEVIATION, std::min(MAX_DEVIATION, _integral + (KI * error)));
+      _ratio = 1.0 + std::max(-MAX_DEVIATION, std::min(MAX_DEVIATION, _integral + (KP * error)));
+
+      return _ratio;
+   }
+}
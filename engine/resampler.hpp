@@ -0,0 +1,66 @@
+/*
+ *  Asynchronous sample rate adaption for clock drift between devices.
+ *  AdaptiveResampler interpolates interleaved float frames with a 4 point cubic (Catmull-Rom) at a ratio
+ *  that can change every block; DriftController steers that ratio so that the fill level of a sink
+ *  (ring + device buffer, from snd_pcm_delay) stays where it settled after start-up.
+ *  A drift of 100 ppm is 4.8 frames per second at 48 kHz - the ratio moves by parts per million and the
+ *  loop needs seconds to settle, which keeps the pitch changes far below anything audible.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace audio
+{
+   class AdaptiveResampler
+   {
+   public:
+      AdaptiveResampler(uint32_t channels, size_t maxInputFrames);
+
+      /* input frames consumed per output frame, 1.0 passes the signal through (delayed by one frame) */
+      void setRatio(double ratio) { _ratio = ratio; }
+      double ratio() const { return _ratio; }
+
+      /* the amount of new input frames process() needs to deliver outFrames */
+      size_t inputFramesFor(size_t outFrames) const;
+
+      /* takes all the input frames, returns the amount of produced output frames (outFrames when enough input) */
+      size_t process(const float* in, size_t inFrames, float* out, size_t outFrames);
+
+      void reset();
+
+   private:
+      uint32_t _channels;
+      double   _ratio = 1.0;
+      double   _position = 1.0;           /* of the next output frame in _work, at least one frame of history behind */
+      std::vector<float> _work;           /* the not yet consumed input frames */
+      size_t   _workFrames = 0;
+   };
+
+   class DriftController
+   {
+   public:
+      static constexpr double KP = 8e-6;             /* ratio change per frame of fill error */
+      static constexpr double KI = 2e-8;             /* integral gain per update - about 5 s to settle */
+      static constexpr double MAX_DEVIATION = 0.005; /* +-0.5 %, far beyond any crystal */
+      static constexpr double SMOOTHING = 0.05;      /* one pole filter of the measured fill level */
+      static constexpr uint32_t SETTLE_UPDATES = 40; /* the fill level is averaged this long before it becomes the target */
+
+      /* expects one fill measurement per written period, returns the ratio for the next period */
+      double update(double fillFrames);
+      void reset();
+
+      double target() const { return _target; }
+      double deviationPpm() const { return (_ratio - 1.0) * 1e6; }
+
+   private:
+      double   _filtered = 0.0;
+      double   _target = 0.0;
+      double   _integral = 0.0;
+      double   _ratio = 1.0;
+      uint32_t _updates = 0;
+   };
+}
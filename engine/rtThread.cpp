@@ -0,0 +1,145 @@
+#include "rtThread.hpp"
+#include "allocGuard.hpp"
+#include "trace.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <alloca.h>
+#include <sys/mman.h>
+
+namespace audio
+{
+   namespace
+   {
+      void prefaultStack(size_t bytes)
+      {
+         // the array is placed on the stack of the calling thread, writing it maps the pages in
+         auto stack = static_cast<volatile uint8_t*>(alloca(bytes));
+         const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+         for (size_t i = 0; i < bytes; i += pageSize)
+         {
+            stack[i] = 0;
+         }
+      }
+   }
+
+   RtStatus applyRtSettings(const RtSettings& settings)
+   {
+      RtStatus status {};
+      int err;
+
+      if (settings.lockMemory)
+      {
+         if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+         {
+            // freed heap memory stays with the process, so that a later malloc does not fault it in again
+            mallopt(M_TRIM_THRESHOLD, -1);
+            mallopt(M_MMAP_MAX, 0);
+            status.memoryLocked = true;
+         }
+         else
+         {
+            printf("mlockall failed (%s), continuing without memory locking\n", strerror(errno));
+         }
+      }
+
+      if (settings.prefaultStackBytes > 0)
+      {
+         prefaultStack(settings.prefaultStackBytes);
+      }
+
+      if (settings.cpu >= 0)
+      {
+         cpu_set_t cpuSet;
+         CPU_ZERO(&cpuSet);
+         CPU_SET(settings.cpu, &cpuSet);
+
+         if ((err = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet)) == 0)
+         {
+            status.pinned = true;
+         }
+         else
+         {
+            printf("Pinning to CPU %d failed (%s), the thread may migrate\n", settings.cpu, strerror(err));
+         }
+      }
+
+      if (settings.priority > 0)
+      {
+         sched_param param {};
+         param.sched_priority = settings.priority;
+
+         if ((err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) == 0)
+         {
+            status.fifo = true;
+         }
+         else
+         {
+            printf("SCHED_FIFO priority %d not permitted (%s), keeping normal scheduling\n", settings.priority, strerror(err));
+         }
+      }
+
+      return status;
+   }
+
+   void prefault(void* memory, size_t bytes)
+   {
+      auto bytePtr = static_cast<volatile uint8_t*>(memory);
+      const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+      for (size_t i = 0; i < bytes; i += pageSize)
+      {
+         bytePtr[i] = bytePtr[i];
+      }
+   }
+
+   RenderThread::~RenderThread()
+   {
+      stop();
+      join();
+   }
+
+   void RenderThread::start(const RtSettings& settings, std::function<bool()> body)
+   {
+      stop();
+      join();
+
+      _running.store(true, std::memory_order_relaxed);
+      _thread = std::thread([this, settings, body]()
+      {
+         auto status = applyRtSettings(settings);
+
+         printf("Thread %s: %s, %s, %s\n", settings.name,
+                status.fifo ? "SCHED_FIFO" : "normal scheduling",
+                status.pinned ? "pinned" : "not pinned",
+                status.memoryLocked ? "memory locked" : "memory not locked");
+
+         // claims the trace ring before the guard, so that tracing never allocates in the loop
+         AUDIO_TRACE_THREAD(settings.name);
+
+         // from here on the loop must not touch the heap (checked in debug builds with AUDIO_COUNT_ALLOCATIONS)
+         AllocationGuard allocationGuard;
+
+         while (_running.load(std::memory_order_relaxed) && body())
+         {
+            allocationGuard.check();
+         }
+
+         _running.store(false, std::memory_order_relaxed);
+      });
+   }
+
+   void RenderThread::join()
+   {
+      if (_thread.joinable())
+      {
+         _thread.join();
+      }
+   }
+}
@@ -0,0 +1,62 @@
+/*
+ *  Runs the render / write loop of a demo on a dedicated thread with real-time attributes:
+ *  SCHED_FIFO priority, CPU pinning and locked, pre-faulted memory.
+ *  Every attribute is optional - when the process lacks the rights for it a warning is printed
+ *  and the loop runs with normal scheduling instead of failing.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+namespace audio
+{
+   struct RtSettings
+   {
+      int    priority = 0;                  /* SCHED_FIFO priority 1..99, 0 keeps the normal scheduling */
+      int    cpu = -1;                      /* CPU the thread is pinned to, -1 lets the scheduler decide */
+      bool   lockMemory = false;            /* mlockall() the process and keep freed heap memory mapped */
+      size_t prefaultStackBytes = 64*1024;  /* stack touched up front so that the loop never page faults on it */
+      const char* name = "render";          /* thread name in the start-up line and in traces (a string literal) */
+   };
+
+   struct RtStatus
+   {
+      bool fifo = false;
+      bool pinned = false;
+      bool memoryLocked = false;
+   };
+
+   /* applies the settings to the calling thread, whatever is not permitted is skipped with a warning */
+   RtStatus applyRtSettings(const RtSettings& settings);
+
+   /* touches every page of the given memory so that the first real access does not fault */
+   void prefault(void* memory, size_t bytes);
+
+   class RenderThread
+   {
+   public:
+      RenderThread() = default;
+      ~RenderThread();
+
+      RenderThread(const RenderThread&) = delete;
+      RenderThread& operator=(const RenderThread&) = delete;
+
+      /* starts a thread which calls body() - one period per call - until it returns false or stop() is called */
+      void start(const RtSettings& settings, std::function<bool()> body);
+
+      /* asks the loop to finish after the current period */
+      void stop() { _running.store(false, std::memory_order_relaxed); }
+
+      void join();
+
+      bool running() const { return _running.load(std::memory_order_relaxed); }
+
+   private:
+      std::thread       _thread {};
+      std::atomic<bool> _running { false };
+   };
+}
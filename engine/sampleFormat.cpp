@@ -0,0 +1,91 @@
+#include "sampleFormat.hpp"
+#include "simdKernels.hpp"
+
+namespace audio
+{
+   const snd_pcm_format_t NATIVE_FORMATS[] { SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S32, SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S24 };
+   const size_t NATIVE_FORMATS_COUNT = sizeof(NATIVE_FORMATS)/sizeof(NATIVE_FORMATS[0]);
+
+   bool runningOnLittleEndianHost()
+   {
+      const uint16_t probe = 1;
+      return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+   }
+
+   snd_pcm_format_t byteSwappedFormat(snd_pcm_format_t format)
+   {
+      switch (format)
+      {
+         case SND_PCM_FORMAT_S16_LE:   return SND_PCM_FORMAT_S16_BE;
+         case SND_PCM_FORMAT_S16_BE:   return SND_PCM_FORMAT_S16_LE;
+         case SND_PCM_FORMAT_U16_LE:   return SND_PCM_FORMAT_U16_BE;
+         case SND_PCM_FORMAT_U16_BE:   return SND_PCM_FORMAT_U16_LE;
+         case SND_PCM_FORMAT_S24_LE:   return SND_PCM_FORMAT_S24_BE;
+         case SND_PCM_FORMAT_S24_BE:   return SND_PCM_FORMAT_S24_LE;
+         case SND_PCM_FORMAT_S32_LE:   return SND_PCM_FORMAT_S32_BE;
+         case SND_PCM_FORMAT_S32_BE:   return SND_PCM_FORMAT_S32_LE;
+         case SND_PCM_FORMAT_FLOAT_LE: return SND_PCM_FORMAT_FLOAT_BE;
+         case SND_PCM_FORMAT_FLOAT_BE: return SND_PCM_FORMAT_FLOAT_LE;
+         default:                      return format;
+      }
+   }
+
+   int negotiateFormat(snd_pcm_t* handle, snd_pcm_hw_params_t* hwParams, snd_pcm_format_t requested,
+                       snd_pcm_format_t& chosen)
+   {
+      if (requested == SND_PCM_FORMAT_UNKNOWN)
+      {
+         for (size_t i = 0; i < NATIVE_FORMATS_COUNT; ++i)
+         {
+            if (snd_pcm_hw_params_test_format(handle, hwParams, NATIVE_FORMATS[i]) == 0)
+            {
+               chosen = NATIVE_FORMATS[i];
+               return 0;
+            }
+         }
+         printf("None of the native sample formats is supported by the device\n");
+         return -EINVAL;
+      }
+
+      if (snd_pcm_hw_params_test_format(handle, hwParams, requested) == 0)
+      {
+         chosen = requested;
+         return 0;
+      }
+
+      auto swapped = byteSwappedFormat(requested);
+      if ((swapped != requested) && (snd_pcm_hw_params_test_format(handle, hwParams, swapped) == 0))
+      {
+         chosen = swapped;
+         return 0;
+      }
+
+      printf("Sample format %s not available\n", snd_pcm_format_name(requested));
+      return -EINVAL;
+   }
+
+   void byteSwap16(uint16_t* samples, size_t count)
+   {
+      kernels::byteSwap16(samples, count);
+   }
+
+   void byteSwap32(uint32_t* samples, size_t count)
+   {
+      kernels::byteSwap32(samples, count);
+   }
+
+   void byteSwapSamples(void* samples, size_t sampleCount, snd_pcm_format_t format)
+   {
+      switch (snd_pcm_format_physical_width(format))
+      {
+         case 16:
+            byteSwap16(static_cast<uint16_t*>(samples), sampleCount);
+            break;
+         case 32:
+            byteSwap32(static_cast<uint32_t*>(samples), sampleCount);
+            break;
+         default:
+            break;
+      }
+   }
+}
@@ -0,0 +1,37 @@
+/*
+ *  Sample format helpers: host endianness, native format negotiation and byte order conversion.
+ *  Samples are generated in the host byte order - a swap pass is only needed when the device
+ *  can do nothing else than the opposite endianness.
+ */
+
+#pragma once
+
+#include <alsa/asoundlib.h>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace audio
+{
+   bool runningOnLittleEndianHost();
+
+   /* returns the same format with the opposite byte order (e.g. S16_LE -> S16_BE) or the input when there is none */
+   snd_pcm_format_t byteSwappedFormat(snd_pcm_format_t format);
+
+   /* host byte order formats in the order of preference used when the caller lets the device choose */
+   extern const snd_pcm_format_t NATIVE_FORMATS[];
+   extern const size_t NATIVE_FORMATS_COUNT;
+
+   /* picks the format to be set in the hw params:                                                          */
+   /*  - requested == SND_PCM_FORMAT_UNKNOWN -> the first native format supported by the device              */
+   /*  - otherwise the requested format, or its byte swapped twin when only that one is supported            */
+   /* returns 0 and fills chosen, or a negative ALSA error code                                            */
+   int negotiateFormat(snd_pcm_t* handle, snd_pcm_hw_params_t* hwParams, snd_pcm_format_t requested,
+                       snd_pcm_format_t& chosen);
+
+   /* in place byte order reversal through the SIMD kernels of the CPU (see simdKernels.hpp) */
+   void byteSwap16(uint16_t* samples, size_t count);
+   void byteSwap32(uint32_t* samples, size_t count);
+
+   /* swaps the samples only when the format width needs it (8 bit and 24-in-3-byte formats are not handled) */
+   void byteSwapSamples(void* samples, size_t sampleCount, snd_pcm_format_t format);
+}
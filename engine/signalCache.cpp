@@ -0,0 +1,394 @@
+#include "signalCache.hpp"
+#include "sampleFormat.hpp"
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <new>
+#include <numeric>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace audio
+{
+   namespace
+   {
+      const uint32_t SEGMENT_MAGIC = 0x4c4f4f50;   /* "LOOP" */
+      const uint32_t SEGMENT_VERSION = 1;
+      const size_t   DATA_OFFSET = 64;             /* the frames start a cache line after the header */
+      const int      ATTACH_TIMEOUT_MS = 1000;     /* waiting for another process to finish rendering */
+
+      struct SegmentHeader
+      {
+         uint32_t magic;
+         uint32_t version;
+         LoopKey  key;
+         uint32_t loopFrames;
+         uint32_t totalFrames;
+         uint32_t frameBytes;
+         std::atomic<uint32_t> ready;   /* set by the rendering process once the frames are complete */
+      };
+      static_assert(sizeof(SegmentHeader) <= DATA_OFFSET, "the header overlaps the frames");
+
+      enum class Encoding { None, S16, S24, S32, Float };
+
+      struct FormatInfo
+      {
+         Encoding encoding;
+         size_t   bytes;
+         bool     bigEndian;
+      };
+
+      FormatInfo formatInfo(snd_pcm_format_t format)
+      {
+         switch (format)
+         {
+            case SND_PCM_FORMAT_S16_LE:   return { Encoding::S16, 2, false };
+            case SND_PCM_FORMAT_S16_BE:   return { Encoding::S16, 2, true };
+            case SND_PCM_FORMAT_S24_LE:   return { Encoding::S24, 4, false };
+            case SND_PCM_FORMAT_S24_BE:   return { Encoding::S24, 4, true };
+            case SND_PCM_FORMAT_S32_LE:   return { Encoding::S32, 4, false };
+            case SND_PCM_FORMAT_S32_BE:   return { Encoding::S32, 4, true };
+            case SND_PCM_FORMAT_FLOAT_LE: return { Encoding::Float, 4, false };
+            case SND_PCM_FORMAT_FLOAT_BE: return { Encoding::Float, 4, true };
+            default:                      return { Encoding::None, 0, false };
+         }
+      }
+
+      /* the frames after which the sine is back at its start phase, 0 when that's beyond MAX_LOOP_SECONDS */
+      uint32_t loopLength(const LoopKey& key)
+      {
+         const uint64_t cycle = static_cast<uint64_t>(key.sampleRate) * 1000;
+         const uint64_t frames = cycle / std::gcd(cycle, static_cast<uint64_t>(key.frequencyMilliHz));
+         return (frames <= static_cast<uint64_t>(SharedLoop::MAX_LOOP_SECONDS) * key.sampleRate) ? static_cast<uint32_t>(frames) : 0;
+      }
+
+      /* one host byte order sample of the value (-1.0 .. 1.0) */
+      void encode(Encoding encoding, double value, uint8_t* sample)
+      {
+         value = std::max(-1.0, std::min(1.0, value));
+
+         switch (encoding)
+         {
+            case Encoding::S16:
+            {
+               const auto s = static_cast<int16_t>(lrint(value * 32767.0));
+               memcpy(sample, &s, sizeof(s));
+               break;
+            }
+            case Encoding::S24:
+            {
+               const auto s = static_cast<int32_t>(lrint(value * 8388607.0));
+               memcpy(sample, &s, sizeof(s));
+               break;
+            }
+            case Encoding::S32:
+            {
+               const auto s = static_cast<int32_t>(llrint(value * 2147483647.0));
+               memcpy(sample, &s, sizeof(s));
+               break;
+            }
+            case Encoding::Float:
+            {
+               const auto s = static_cast<float>(value);
+               memcpy(sample, &s, sizeof(s));
+               break;
+            }
+            case Encoding::None:
+               break;
+         }
+      }
+
+      /* the phase is exact for every frame (integer modulo), so the repetitions after the loop are identical */
+      void renderSine(uint8_t* data, const LoopKey& key, uint32_t frames)
+      {
+         const auto info = formatInfo(key.format);
+         const uint64_t cycle = static_cast<uint64_t>(key.sampleRate) * 1000;
+         uint8_t sample[4];
+
+         for (uint32_t f = 0; f < frames; ++f)
+         {
+            const uint64_t phase = (static_cast<uint64_t>(key.frequencyMilliHz) * f) % cycle;
+            encode(info.encoding, key.gain * sin((2.0 * M_PI * phase) / cycle), sample);
+
+            for (uint32_t c = 0; c < key.channels; ++c)
+            {
+               memcpy(data + ((static_cast<size_t>(f) * key.channels) + c) * info.bytes, sample, info.bytes);
+            }
+         }
+
+         if (info.bigEndian == runningOnLittleEndianHost())
+         {
+            byteSwapSamples(data, static_cast<size_t>(frames) * key.channels, key.format);
+         }
+      }
+   }
+
+   LoopKey LoopKey::sine(double frequency, uint32_t sampleRate, snd_pcm_format_t format, uint32_t channels, float gain)
+   {
+      LoopKey key;
+      key.frequencyMilliHz = static_cast<uint32_t>(lround(frequency * 1000.0));
+      key.sampleRate = sampleRate;
+      key.format = format;
+      key.channels = channels;
+      key.gain = gain;
+      return key;
+   }
+
+   bool LoopKey::operator==(const LoopKey& other) const
+   {
+      return (frequencyMilliHz == other.frequencyMilliHz) && (sampleRate == other.sampleRate) &&
+             (format == other.format) && (channels == other.channels) && (gain == other.gain);
+   }
+
+   SharedLoop::~SharedLoop()
+   {
+      close();
+   }
+
+   std::string SharedLoop::segmentName(const LoopKey& key)
+   {
+      uint32_t gainBits;
+      memcpy(&gainBits, &key.gain, sizeof(gainBits));
+
+      char name[96];
+      snprintf(name, sizeof(name), "/alsa-playground-loop-%u-%u-%d-%u-%08x",
+               key.frequencyMilliHz, key.sampleRate, static_cast<int>(key.format), key.channels, gainBits);
+      return name;
+   }
+
+   int SharedLoop::open(const LoopKey& key, Scope scope)
+   {
+      int err;
+
+      close();
+
+      const auto info = formatInfo(key.format);
+      const uint32_t loopFrames = ((key.sampleRate != 0) && (key.frequencyMilliHz != 0)) ? loopLength(key) : 0;
+      if ((info.encoding == Encoding::None) || (key.channels == 0) || (loopFrames == 0))
+      {
+         printf("No loop of %.3f Hz at %u Hz in %s within %u s\n", key.frequencyMilliHz / 1000.0, key.sampleRate,
+                snd_pcm_format_name(key.format), MAX_LOOP_SECONDS);
+         return -EINVAL;
+      }
+
+      // whole loops, enough of them that any read from an offset inside the first one stays in the segment
+      const uint32_t loops = (loopFrames + MAX_READ_FRAMES - 1 + loopFrames - 1) / loopFrames;
+      const uint32_t totalFrames = loops * loopFrames;
+      const size_t bytes = DATA_OFFSET + static_cast<size_t>(totalFrames) * key.channels * info.bytes;
+      const std::string name = segmentName(key);
+
+      if (scope == Scope::Host)
+      {
+         // exactly one process wins the creation, the others wait for its ready flag
+         int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+         if (fd >= 0)
+         {
+            err = create(fd, key, bytes, loopFrames, totalFrames, false);
+            ::close(fd);
+            if (err == 0)
+            {
+               return 0;
+            }
+            shm_unlink(name.c_str());
+         }
+         else if ((errno == EEXIST) && ((fd = shm_open(name.c_str(), O_RDONLY, 0)) >= 0))
+         {
+            err = attach(fd, key, bytes, loopFrames);
+            ::close(fd);
+            if (err == 0)
+            {
+               return 0;
+            }
+         }
+         else
+         {
+            err = -errno;
+         }
+
+         printf("The shared segment %s is unusable (%s), rendering a private copy\n", name.c_str(), strerror(-err));
+      }
+
+      const int fd = memfd_create(name.c_str() + 1, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+      if (fd < 0)
+      {
+         err = -errno;
+         printf("memfd_create failed: %s\n", strerror(-err));
+         return err;
+      }
+
+      err = create(fd, key, bytes, loopFrames, totalFrames, true);
+      ::close(fd);
+      return err;
+   }
+
+   int SharedLoop::create(int fd, const LoopKey& key, size_t bytes, uint32_t loopFrames, uint32_t totalFrames, bool seal)
+   {
+      if (ftruncate(fd, static_cast<off_t>(bytes)) < 0)
+      {
+         return -errno;
+      }
+
+      void* writable = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (writable == MAP_FAILED)
+      {
+         return -errno;
+      }
+
+      auto header = new (writable) SegmentHeader {};
+      header->magic = SEGMENT_MAGIC;
+      header->version = SEGMENT_VERSION;
+      header->key = key;
+      header->loopFrames = loopFrames;
+      header->totalFrames = totalFrames;
+      header->frameBytes = static_cast<uint32_t>(key.channels * formatInfo(key.format).bytes);
+      renderSine(static_cast<uint8_t*>(writable) + DATA_OFFSET, key, totalFrames);
+      header->ready.store(1, std::memory_order_release);
+      munmap(writable, bytes);
+
+      // a memfd can be sealed for good once the writable mapping is gone - nobody can change the frames any more
+      if (seal && (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) < 0))
+      {
+         printf("Sealing the loop failed: %s\n", strerror(errno));
+      }
+
+      const int err = attach(fd, key, bytes, loopFrames);
+      _rendered = (err == 0);
+      return err;
+   }
+
+   int SharedLoop::attach(int fd, const LoopKey& key, size_t bytes, uint32_t loopFrames)
+   {
+      struct stat st;
+      void* mapping = MAP_FAILED;
+
+      // the creating process may not have sized the segment yet
+      for (int waited = 0; mapping == MAP_FAILED; ++waited)
+      {
+         if (fstat(fd, &st) < 0)
+         {
+            return -errno;
+         }
+
+         if (static_cast<size_t>(st.st_size) == bytes)
+         {
+            if ((mapping = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+            {
+               return -errno;
+            }
+         }
+         else if ((st.st_size != 0) || (waited == ATTACH_TIMEOUT_MS))
+         {
+            return (st.st_size != 0) ? -EINVAL : -ETIMEDOUT;
+         }
+         else
+         {
+            usleep(1000);
+         }
+      }
+
+      auto header = static_cast<const SegmentHeader*>(mapping);
+      for (int waited = 0; header->ready.load(std::memory_order_acquire) == 0; ++waited)
+      {
+         if (waited == ATTACH_TIMEOUT_MS)
+         {
+            munmap(mapping, bytes);
+            return -ETIMEDOUT;
+         }
+         usleep(1000);
+      }
+
+      if ((header->magic != SEGMENT_MAGIC) || (header->version != SEGMENT_VERSION) ||
+          !(header->key == key) || (header->loopFrames != loopFrames))
+      {
+         munmap(mapping, bytes);
+         return -EINVAL;
+      }
+
+      _key = key;
+      _mapping = mapping;
+      _mappedBytes = bytes;
+      _data = static_cast<const uint8_t*>(mapping) + DATA_OFFSET;
+      _loopFrames = loopFrames;
+      _frameBytes = header->frameBytes;
+      _rendered = false;
+      return 0;
+   }
+
+   void SharedLoop::close()
+   {
+      if (_mapping != nullptr)
+      {
+         munmap(_mapping, _mappedBytes);
+      }
+
+      _mapping = nullptr;
+      _mappedBytes = 0;
+      _data = nullptr;
+      _loopFrames = 0;
+      _frameBytes = 0;
+      _rendered = false;
+   }
+
+   const void* SharedLoop::read(uint32_t& offset, size_t& frames) const
+   {
+      frames = std::min<size_t>(frames, MAX_READ_FRAMES);
+
+      const void* area = _data + static_cast<size_t>(offset) * _frameBytes;
+      offset = static_cast<uint32_t>((offset + frames) % _loopFrames);
+      return area;
+   }
+
+   void SharedLoop::copy(void* out, size_t frames, uint32_t& offset) const
+   {
+      auto dst = static_cast<uint8_t*>(out);
+
+      while (frames > 0)
+      {
+         size_t count = frames;
+         const void* area = read(offset, count);
+         memcpy(dst, area, count * _frameBytes);
+         dst += count * _frameBytes;
+         frames -= count;
+      }
+   }
+
+   const SharedLoop* SignalCache::loop(const LoopKey& key)
+   {
+      for (const auto& loop : _loops)
+      {
+         if (loop->key() == key)
+         {
+            return loop.get();
+         }
+      }
+
+      std::unique_ptr<SharedLoop> loop(new SharedLoop());
+      if (loop->open(key, _scope) < 0)
+      {
+         return nullptr;
+      }
+
+      _loops.push_back(std::move(loop));
+      return _loops.back().get();
+   }
+
+   size_t SignalCache::renderedLoops() const
+   {
+      return std::count_if(_loops.begin(), _loops.end(), [](const std::unique_ptr<SharedLoop>& loop) { return loop->rendered(); });
+   }
+
+   size_t SignalCache::mappedBytes() const
+   {
+      size_t bytes = 0;
+      for (const auto& loop : _loops)
+      {
+         bytes += loop->segmentBytes();
+      }
+      return bytes;
+   }
+}
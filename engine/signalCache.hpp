@@ -0,0 +1,104 @@
+/*
+ *  Looped test signals rendered once per host instead of once per stream (or per process).
+ *  A SharedLoop is one period-exact loop of a sine - keyed by frequency, rate, format, channels and gain -
+ *  in a shared memory segment the streams map read-only. The first process to ask for a key renders it
+ *  into a named POSIX shm segment, every later one (and every stream) only maps it and keeps an offset.
+ *  The loop is followed by enough of its own repetition that a read of up to MAX_READ_FRAMES frames from
+ *  any offset is contiguous - a stream hands that pointer straight to writei or copies it into its period.
+ */
+
+#pragma once
+
+#include <alsa/asoundlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace audio
+{
+   struct LoopKey
+   {
+      uint32_t         frequencyMilliHz = 0;          /* the loop has to close within MAX_LOOP_SECONDS at this resolution */
+      uint32_t         sampleRate = 0;
+      snd_pcm_format_t format = SND_PCM_FORMAT_S16;   /* S16, S24 (in 32 bit), S32 or FLOAT - either byte order */
+      uint32_t         channels = 0;                  /* the same signal in every channel */
+      float            gain = 1.0f;
+
+      static LoopKey sine(double frequency, uint32_t sampleRate, snd_pcm_format_t format, uint32_t channels, float gain);
+
+      bool operator==(const LoopKey& other) const;
+   };
+
+   class SharedLoop
+   {
+   public:
+      static constexpr uint32_t MAX_READ_FRAMES = 8192;   /* the largest contiguous read, two throughput periods */
+      static constexpr uint32_t MAX_LOOP_SECONDS = 10;
+
+      enum class Scope
+      {
+         Host,     /* a named shm segment (/dev/shm) any process can map, it outlives the processes */
+         Process   /* a sealed memfd only this process sees - the fallback when the named one is unusable */
+      };
+
+      SharedLoop() = default;
+      ~SharedLoop();
+
+      SharedLoop(const SharedLoop&) = delete;
+      SharedLoop& operator=(const SharedLoop&) = delete;
+
+      /* maps the loop of the key, renders it first when no process did before - returns 0 or a negative errno */
+      int open(const LoopKey& key, Scope scope = Scope::Host);
+
+      void close();
+
+      /* the loop from offset (< loopFrames) on - frames is clamped to MAX_READ_FRAMES, offset advanced past */
+      /* them modulo the loop: the offset is all the state a stream playing the loop needs                  */
+      const void* read(uint32_t& offset, size_t& frames) const;
+
+      /* copies frames of the loop to out through as many reads as needed */
+      void copy(void* out, size_t frames, uint32_t& offset) const;
+
+      bool isOpen() const { return _data != nullptr; }
+      bool rendered() const { return _rendered; }   /* false when it was mapped from a segment of another stream */
+      const LoopKey& key() const { return _key; }
+      uint32_t loopFrames() const { return _loopFrames; }
+      size_t frameBytes() const { return _frameBytes; }
+      size_t segmentBytes() const { return _mappedBytes; }
+
+      /* the shm name of a key, e.g. for "rm /dev/shm/..." */
+      static std::string segmentName(const LoopKey& key);
+
+   private:
+      int create(int fd, const LoopKey& key, size_t bytes, uint32_t loopFrames, uint32_t totalFrames, bool seal);
+      int attach(int fd, const LoopKey& key, size_t bytes, uint32_t loopFrames);
+
+      LoopKey  _key {};
+      void*    _mapping = nullptr;
+      size_t   _mappedBytes = 0;
+      const uint8_t* _data = nullptr;
+      uint32_t _loopFrames = 0;
+      size_t   _frameBytes = 0;
+      bool     _rendered = false;
+   };
+
+   /* one SharedLoop per key within the process, the streams playing the same signal get the same one */
+   class SignalCache
+   {
+   public:
+      explicit SignalCache(SharedLoop::Scope scope = SharedLoop::Scope::Host) : _scope(scope) {}
+
+      /* the loop of the key - opened (or rendered) on the first call, nullptr when that failed */
+      const SharedLoop* loop(const LoopKey& key);
+
+      size_t loops() const { return _loops.size(); }
+      size_t renderedLoops() const;   /* the ones this process had to render, the others came from the segments */
+      size_t mappedBytes() const;
+
+   private:
+      SharedLoop::Scope _scope;
+      std::vector<std::unique_ptr<SharedLoop>> _loops {};
+   };
+}
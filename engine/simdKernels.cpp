@@ -0,0 +1,991 @@
+#include "simdKernels.hpp"
+
+#include <math.h>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AUDIO_KERNELS_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define AUDIO_KERNELS_NEON 1
+#endif
+
+namespace audio
+{
+   namespace kernels
+   {
+      namespace scalar
+      {
+         void fanOut16(const int16_t* mono, int16_t* out, size_t frames, uint32_t channels)
+         {
+            for (size_t f = 0; f < frames; ++f)
+            {
+               for (uint32_t c = 0; c < channels; ++c)
+               {
+                  *out++ = mono[f];
+               }
+            }
+         }
+
+         /* the channel loop unrolled at compile time for the quad, 5.1 and 7.1 layouts */
+         template <uint32_t Channels, typename T>
+         void interleaveFixed(const T* const* planes, T* out, size_t frames)
+         {
+            for (size_t f = 0; f < frames; ++f)
+            {
+               for (uint32_t c = 0; c < Channels; ++c)
+               {
+                  out[c] = planes[c][f];
+               }
+               out += Channels;
+            }
+         }
+
+         template <typename T>
+         void interleave(const T* const* planes, T* out, size_t frames, uint32_t channels)
+         {
+            switch (channels)
+            {
+               case 4: interleaveFixed<4>(planes, out, frames); return;
+               case 6: interleaveFixed<6>(planes, out, frames); return;
+               case 8: interleaveFixed<8>(planes, out, frames); return;
+               default: break;
+            }
+
+            for (size_t f = 0; f < frames; ++f)
+            {
+               for (uint32_t c = 0; c < channels; ++c)
+               {
+                  *out++ = planes[c][f];
+               }
+            }
+         }
+
+         template <typename T>
+         void deinterleave(const T* in, T* const* planes, size_t frames, uint32_t channels)
+         {
+            for (size_t f = 0; f < frames; ++f)
+            {
+               for (uint32_t c = 0; c < channels; ++c)
+               {
+                  planes[c][f] = *in++;
+               }
+            }
+         }
+
+         void interleave16(const int16_t* const* planes, int16_t* out, size_t frames, uint32_t channels)
+         {
+            interleave(planes, out, frames, channels);
+         }
+
+         void deinterleave16(const int16_t* in, int16_t* const* planes, size_t frames, uint32_t channels)
+         {
+            deinterleave(in, planes, frames, channels);
+         }
+
+         void interleave32(const int32_t* const* planes, int32_t* out, size_t frames, uint32_t channels)
+         {
+            interleave(planes, out, frames, channels);
+         }
+
+         void deinterleave32(const int32_t* in, int32_t* const* planes, size_t frames, uint32_t channels)
+         {
+            deinterleave(in, planes, frames, channels);
+         }
+
+         void byteSwap16(uint16_t* samples, size_t count)
+         {
+            for (size_t i = 0; i < count; ++i)
+            {
+               samples[i] = static_cast<uint16_t>((samples[i] << 8) | (samples[i] >> 8));
+            }
+         }
+
+         void byteSwap32(uint32_t* samples, size_t count)
+         {
+            for (size_t i = 0; i < count; ++i)
+            {
+               const auto s = samples[i];
+               samples[i] = (s << 24) | ((s & 0xFF00u) << 8) | ((s >> 8) & 0xFF00u) | (s >> 24);
+            }
+         }
+
+         void narrowS32ToS16(const int32_t* in, int16_t* out, size_t count, uint32_t preShift, int32_t gainQ15)
+         {
+            for (size_t i = 0; i < count; ++i)
+            {
+               // the gain is applied to the full 32 bits, the product is rounded to 16 bit once
+               const auto x = static_cast<int32_t>(static_cast<uint32_t>(in[i]) << preShift);
+               const auto v = (int64_t(x) * gainQ15 + (int64_t(1) << 30)) >> 31;
+
+               out[i] = static_cast<int16_t>((v < INT16_MIN) ? INT16_MIN : ((v > INT16_MAX) ? INT16_MAX : v));
+            }
+         }
+
+         void accumulateRamp(float* acc, const float* in, size_t count, float gain, float gainStep)
+         {
+            for (size_t i = 0; i < count; ++i)
+            {
+               acc[i] += in[i] * (gain + (static_cast<float>(i) * gainStep));
+            }
+         }
+
+         void floatToS16(const float* in, int16_t* out, size_t count, float scale)
+         {
+            for (size_t i = 0; i < count; ++i)
+            {
+               const auto v = lrintf(in[i] * scale);
+               out[i] = static_cast<int16_t>((v < INT16_MIN) ? INT16_MIN : ((v > INT16_MAX) ? INT16_MAX : v));
+            }
+         }
+
+         void floatToS32(const float* in, int32_t* out, size_t count, float scale)
+         {
+            for (size_t i = 0; i < count; ++i)
+            {
+               const auto v = llrint(static_cast<double>(in[i]) * scale);
+               out[i] = static_cast<int32_t>((v < INT32_MIN) ? INT32_MIN : ((v > INT32_MAX) ? INT32_MAX : v));
+            }
+         }
+      }
+
+#if defined(AUDIO_KERNELS_X86)
+      namespace sse2
+      {
+         __attribute__((target("sse2")))
+         void fanOut16(const int16_t* mono, int16_t* out, size_t frames, uint32_t channels)
+         {
+            size_t f = 0;
+
+            if (channels == 2)
+            {
+               for (; f + 8 <= frames; f += 8)
+               {
+                  const auto m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mono + f));
+                  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2*f), _mm_unpacklo_epi16(m, m));
+                  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2*f + 8), _mm_unpackhi_epi16(m, m));
+               }
+            }
+            else if (channels == 4)
+            {
+               for (; f + 8 <= frames; f += 8)
+               {
+                  const auto m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mono + f));
+                  const auto lo = _mm_unpacklo_epi16(m, m);
+                  const auto hi = _mm_unpackhi_epi16(m, m);
+                  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4*f), _mm_unpacklo_epi32(lo, lo));
+                  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4*f + 8), _mm_unpackhi_epi32(lo, lo));
+                  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4*f + 16), _mm_unpacklo_epi32(hi, hi));
+                  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4*f + 24), _mm_unpackhi_epi32(hi, hi));
+               }
+            }
+            else if (channels >= 8)
+            {
+               // every frame takes at least one whole vector of the broadcast sample
+               for (; f < frames; ++f)
+               {
+                  const auto m = _mm_set1_epi16(mono[f]);
+                  auto dst = out + f*channels;
+                  uint32_t c = 0;
+                  for (; c + 8 <= channels; c += 8)
+                  {
+                     _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + c), m);
+                  }
+                  for (; c < channels; ++c)
+                  {
+                     dst[c] = mono[f];
+                  }
+               }
+            }
+
+            scalar::fanOut16(mono + f, out + f*channels, frames - f, channels);
+         }
+
+         /* 8 frames of 4 planes -> 4 vectors of two frames each */
+         __attribute__((target("sse2")))
+         void interleave16x4(const int16_t* const* planes, int16_t* out, size_t frames)
+         {
+            size_t f = 0;
+            for (; f + 8 <= frames; f += 8)
+            {
+               const auto a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[0] + f));
+               const auto a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[1] + f));
+               const auto a2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[2] + f));
+               const auto a3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[3] + f));
+               const auto lo01 = _mm_unpacklo_epi16(a0, a1);
+               const auto hi01 = _mm_unpackhi_epi16(a0, a1);
+               const auto lo23 = _mm_unpacklo_epi16(a2, a3);
+               const auto hi23 = _mm_unpackhi_epi16(a2, a3);
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4*f), _mm_unpacklo_epi32(lo01, lo23));
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4*f + 8), _mm_unpackhi_epi32(lo01, lo23));
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4*f + 16), _mm_unpacklo_epi32(hi01, hi23));
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4*f + 24), _mm_unpackhi_epi32(hi01, hi23));
+            }
+
+            const int16_t* rest[4] { planes[0] + f, planes[1] + f, planes[2] + f, planes[3] + f };
+            scalar::interleave16(rest, out + 4*f, frames - f, 4);
+         }
+
+         /* 8 frames of 8 planes -> one vector per frame, the 8x8 transpose in three unpack stages */
+         __attribute__((target("sse2")))
+         void interleave16x8(const int16_t* const* planes, int16_t* out, size_t frames)
+         {
+            size_t f = 0;
+            for (; f + 8 <= frames; f += 8)
+            {
+               __m128i a[8];
+               for (uint32_t c = 0; c < 8; ++c)
+               {
+                  a[c] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[c] + f));
+               }
+
+               __m128i pairs[8];   /* channel pairs 01, 23, 45, 67 - frames 0..3 and 4..7 */
+               for (uint32_t p = 0; p < 4; ++p)
+               {
+                  pairs[2*p] = _mm_unpacklo_epi16(a[2*p], a[2*p + 1]);
+                  pairs[2*p + 1] = _mm_unpackhi_epi16(a[2*p], a[2*p + 1]);
+               }
+
+               __m128i quads[8];   /* channels 0..3 and 4..7 of two frames each */
+               for (uint32_t h = 0; h < 2; ++h)
+               {
+                  quads[4*h] = _mm_unpacklo_epi32(pairs[4*h], pairs[4*h + 2]);
+                  quads[4*h + 1] = _mm_unpackhi_epi32(pairs[4*h], pairs[4*h + 2]);
+                  quads[4*h + 2] = _mm_unpacklo_epi32(pairs[4*h + 1], pairs[4*h + 3]);
+                  quads[4*h + 3] = _mm_unpackhi_epi32(pairs[4*h + 1], pairs[4*h + 3]);
+               }
+
+               for (uint32_t q = 0; q < 4; ++q)
+               {
+                  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8*(f + 2*q)), _mm_unpacklo_epi64(quads[q], quads[q + 4]));
+                  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8*(f + 2*q + 1)), _mm_unpackhi_epi64(quads[q], quads[q + 4]));
+               }
+            }
+
+            const int16_t* rest[8];
+            for (uint32_t c = 0; c < 8; ++c)
+            {
+               rest[c] = planes[c] + f;
+            }
+            scalar::interleave16(rest, out + 8*f, frames - f, 8);
+         }
+
+         __attribute__((target("sse2")))
+         void interleave16(const int16_t* const* planes, int16_t* out, size_t frames, uint32_t channels)
+         {
+            if (channels == 4)
+            {
+               interleave16x4(planes, out, frames);
+               return;
+            }
+            if (channels == 8)
+            {
+               interleave16x8(planes, out, frames);
+               return;
+            }
+            if (channels != 2)
+            {
+               scalar::interleave16(planes, out, frames, channels);
+               return;
+            }
+
+            size_t f = 0;
+            for (; f + 8 <= frames; f += 8)
+            {
+               const auto l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[0] + f));
+               const auto r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[1] + f));
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2*f), _mm_unpacklo_epi16(l, r));
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2*f + 8), _mm_unpackhi_epi16(l, r));
+            }
+
+            const int16_t* rest[2] { planes[0] + f, planes[1] + f };
+            scalar::interleave16(rest, out + 2*f, frames - f, 2);
+         }
+
+         __attribute__((target("sse2")))
+         void deinterleave16(const int16_t* in, int16_t* const* planes, size_t frames, uint32_t channels)
+         {
+            if (channels != 2)
+            {
+               scalar::deinterleave16(in, planes, frames, channels);
+               return;
+            }
+
+            size_t f = 0;
+            for (; f + 8 <= frames; f += 8)
+            {
+               const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2*f));
+               const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2*f + 8));
+               // sign extending the even / odd 16 bit lanes keeps packs_epi32 from saturating anything
+               const auto l = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+               const auto r = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[0] + f), l);
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[1] + f), r);
+            }
+
+            int16_t* rest[2] { planes[0] + f, planes[1] + f };
+            scalar::deinterleave16(in + 2*f, rest, frames - f, 2);
+         }
+
+         /* 4 frames of 4 planes into out, a frame every stride samples - the 4x4 transpose */
+         __attribute__((target("sse2")))
+         inline void transpose32x4(const int32_t* const* planes, size_t f, int32_t* out, size_t stride)
+         {
+            const auto a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[0] + f));
+            const auto a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[1] + f));
+            const auto a2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[2] + f));
+            const auto a3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[3] + f));
+            const auto lo01 = _mm_unpacklo_epi32(a0, a1);
+            const auto hi01 = _mm_unpackhi_epi32(a0, a1);
+            const auto lo23 = _mm_unpacklo_epi32(a2, a3);
+            const auto hi23 = _mm_unpackhi_epi32(a2, a3);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi64(lo01, lo23));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + stride), _mm_unpackhi_epi64(lo01, lo23));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2*stride), _mm_unpacklo_epi64(hi01, hi23));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 3*stride), _mm_unpackhi_epi64(hi01, hi23));
+         }
+
+         /* 4 or 8 planes - the 8 channel frames are the transposes of both plane quads side by side */
+         __attribute__((target("sse2")))
+         void interleave32Quads(const int32_t* const* planes, int32_t* out, size_t frames, uint32_t channels)
+         {
+            size_t f = 0;
+            for (; f + 4 <= frames; f += 4)
+            {
+               for (uint32_t c = 0; c < channels; c += 4)
+               {
+                  transpose32x4(planes + c, f, out + channels*f + c, channels);
+               }
+            }
+
+            const int32_t* rest[8];
+            for (uint32_t c = 0; c < channels; ++c)
+            {
+               rest[c] = planes[c] + f;
+            }
+            scalar::interleave32(rest, out + channels*f, frames - f, channels);
+         }
+
+         __attribute__((target("sse2")))
+         void interleave32(const int32_t* const* planes, int32_t* out, size_t frames, uint32_t channels)
+         {
+            if ((channels == 4) || (channels == 8))
+            {
+               interleave32Quads(planes, out, frames, channels);
+               return;
+            }
+            if (channels != 2)
+            {
+               scalar::interleave32(planes, out, frames, channels);
+               return;
+            }
+
+            size_t f = 0;
+            for (; f + 4 <= frames; f += 4)
+            {
+               const auto l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[0] + f));
+               const auto r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[1] + f));
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2*f), _mm_unpacklo_epi32(l, r));
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2*f + 4), _mm_unpackhi_epi32(l, r));
+            }
+
+            const int32_t* rest[2] { planes[0] + f, planes[1] + f };
+            scalar::interleave32(rest, out + 2*f, frames - f, 2);
+         }
+
+         __attribute__((target("sse2")))
+         void deinterleave32(const int32_t* in, int32_t* const* planes, size_t frames, uint32_t channels)
+         {
+            if (channels != 2)
+            {
+               scalar::deinterleave32(in, planes, frames, channels);
+               return;
+            }
+
+            size_t f = 0;
+            for (; f + 4 <= frames; f += 4)
+            {
+               const auto a = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2*f)), _MM_SHUFFLE(3, 1, 2, 0));
+               const auto b = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2*f + 4)), _MM_SHUFFLE(3, 1, 2, 0));
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[0] + f), _mm_unpacklo_epi64(a, b));
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[1] + f), _mm_unpackhi_epi64(a, b));
+            }
+
+            int32_t* rest[2] { planes[0] + f, planes[1] + f };
+            scalar::deinterleave32(in + 2*f, rest, frames - f, 2);
+         }
+
+         __attribute__((target("sse2")))
+         void byteSwap16(uint16_t* samples, size_t count)
+         {
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+               auto p = reinterpret_cast<__m128i*>(samples + i);
+               const auto v = _mm_loadu_si128(p);
+               _mm_storeu_si128(p, _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+            }
+            scalar::byteSwap16(samples + i, count - i);
+         }
+
+         __attribute__((target("sse2")))
+         void byteSwap32(uint32_t* samples, size_t count)
+         {
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+               auto p = reinterpret_cast<__m128i*>(samples + i);
+               auto v = _mm_loadu_si128(p);
+               // swapping the 16 bit halves, then the bytes inside of them
+               v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+               _mm_storeu_si128(p, _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+            }
+            scalar::byteSwap32(samples + i, count - i);
+         }
+
+         __attribute__((target("sse2")))
+         void narrowS32ToS16(const int32_t* in, int16_t* out, size_t count, uint32_t preShift, int32_t gainQ15)
+         {
+            const auto shift = _mm_cvtsi32_si128(static_cast<int>(preShift));
+            const auto one = _mm_set1_epi32(1);
+            const auto half = _mm_set1_epi32(1 << 30);
+            const auto gain = _mm_set1_epi16(static_cast<int16_t>(gainQ15));
+            size_t i = 0;
+
+            for (; i + 8 <= count; i += 8)
+            {
+               auto a = _mm_sll_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), shift);
+               auto b = _mm_sll_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 4)), shift);
+
+               if (gainQ15 == 32768)
+               {
+                  a = _mm_srai_epi32(_mm_add_epi32(_mm_srai_epi32(a, 15), one), 1);   /* rounding shift which can't overflow */
+                  b = _mm_srai_epi32(_mm_add_epi32(_mm_srai_epi32(b, 15), one), 1);
+               }
+               else
+               {
+                  // x * g = (high * g) << 16 + low * g with a signed high and an unsigned low half, both 16x16 -> 32 bit
+                  // products; (x * g + 2^30) >> 31 == (high * g + ((low * g + 2^30) >>> 16)) >> 15 rounds only once
+                  const auto high = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+                  const auto low = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+                  const auto highLo = _mm_mullo_epi16(high, gain);
+                  const auto highHi = _mm_mulhi_epi16(high, gain);
+                  const auto lowLo = _mm_mullo_epi16(low, gain);
+                  const auto lowHi = _mm_mulhi_epu16(low, gain);
+
+                  const auto lowA = _mm_srli_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lowLo, lowHi), half), 16);
+                  const auto lowB = _mm_srli_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lowLo, lowHi), half), 16);
+                  a = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(highLo, highHi), lowA), 15);
+                  b = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(highLo, highHi), lowB), 15);
+               }
+
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(a, b));   /* saturates to 16 bit */
+            }
+
+            scalar::narrowS32ToS16(in + i, out + i, count - i, preShift, gainQ15);
+         }
+
+         __attribute__((target("sse2")))
+         void accumulateRamp(float* acc, const float* in, size_t count, float gain, float gainStep)
+         {
+            auto g = _mm_setr_ps(gain, gain + gainStep, gain + 2*gainStep, gain + 3*gainStep);
+            const auto step = _mm_set1_ps(4*gainStep);
+            size_t i = 0;
+
+            for (; i + 4 <= count; i += 4)
+            {
+               const auto sum = _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(in + i), g));
+               _mm_storeu_ps(acc + i, sum);
+               g = _mm_add_ps(g, step);
+            }
+
+            scalar::accumulateRamp(acc + i, in + i, count - i, gain + (i * gainStep), gainStep);
+         }
+
+         __attribute__((target("sse2")))
+         void floatToS16(const float* in, int16_t* out, size_t count, float scale)
+         {
+            const auto s = _mm_set1_ps(scale);
+            const auto maxValue = _mm_set1_ps(32767.0f);
+            const auto minValue = _mm_set1_ps(-32768.0f);
+            size_t i = 0;
+
+            for (; i + 8 <= count; i += 8)
+            {
+               // clamped first since cvtps turns anything beyond the int32 range into INT32_MIN
+               const auto a = _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i), s), maxValue), minValue));
+               const auto b = _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), s), maxValue), minValue));
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(a, b));
+            }
+
+            scalar::floatToS16(in + i, out + i, count - i, scale);
+         }
+
+         __attribute__((target("sse2")))
+         void floatToS32(const float* in, int32_t* out, size_t count, float scale)
+         {
+            const auto s = _mm_set1_ps(scale);
+            const auto maxValue = _mm_set1_ps(2147483520.0f);   /* the biggest float below 2^31 */
+            const auto minValue = _mm_set1_ps(-2147483648.0f);
+            size_t i = 0;
+
+            for (; i + 4 <= count; i += 4)
+            {
+               const auto v = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i), s), maxValue), minValue);
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_cvtps_epi32(v));
+            }
+
+            scalar::floatToS32(in + i, out + i, count - i, scale);
+         }
+      }
+
+      namespace avx2
+      {
+         __attribute__((target("avx2")))
+         void fanOut16(const int16_t* mono, int16_t* out, size_t frames, uint32_t channels)
+         {
+            if (channels != 2)
+            {
+               sse2::fanOut16(mono, out, frames, channels);
+               return;
+            }
+
+            size_t f = 0;
+            for (; f + 16 <= frames; f += 16)
+            {
+               const auto m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mono + f));
+               // unpack works per 128 bit lane, the permutes bring the halves back into order
+               const auto lo = _mm256_unpacklo_epi16(m, m);
+               const auto hi = _mm256_unpackhi_epi16(m, m);
+               _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2*f), _mm256_permute2x128_si256(lo, hi, 0x20));
+               _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2*f + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+            }
+
+            sse2::fanOut16(mono + f, out + 2*f, frames - f, 2);
+         }
+
+         __attribute__((target("avx2")))
+         void interleave16(const int16_t* const* planes, int16_t* out, size_t frames, uint32_t channels)
+         {
+            if (channels != 2)
+            {
+               sse2::interleave16(planes, out, frames, channels);
+               return;
+            }
+
+            size_t f = 0;
+            for (; f + 16 <= frames; f += 16)
+            {
+               const auto l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(planes[0] + f));
+               const auto r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(planes[1] + f));
+               const auto lo = _mm256_unpacklo_epi16(l, r);
+               const auto hi = _mm256_unpackhi_epi16(l, r);
+               _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2*f), _mm256_permute2x128_si256(lo, hi, 0x20));
+               _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2*f + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+            }
+
+            const int16_t* rest[2] { planes[0] + f, planes[1] + f };
+            sse2::interleave16(rest, out + 2*f, frames - f, 2);
+         }
+
+         __attribute__((target("avx2")))
+         void byteSwap16(uint16_t* samples, size_t count)
+         {
+            const auto mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                               1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16)
+            {
+               auto p = reinterpret_cast<__m256i*>(samples + i);
+               _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), mask));
+            }
+            sse2::byteSwap16(samples + i, count - i);
+         }
+
+         __attribute__((target("avx2")))
+         void byteSwap32(uint32_t* samples, size_t count)
+         {
+            const auto mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                               3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+               auto p = reinterpret_cast<__m256i*>(samples + i);
+               _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), mask));
+            }
+            sse2::byteSwap32(samples + i, count - i);
+         }
+
+         __attribute__((target("avx2")))
+         void narrowS32ToS16(const int32_t* in, int16_t* out, size_t count, uint32_t preShift, int32_t gainQ15)
+         {
+            const auto shift = _mm_cvtsi32_si128(static_cast<int>(preShift));
+            const auto one = _mm256_set1_epi32(1);
+            const auto half = _mm256_set1_epi32(1 << 30);
+            const auto gain = _mm256_set1_epi16(static_cast<int16_t>(gainQ15));
+            size_t i = 0;
+
+            for (; i + 16 <= count; i += 16)
+            {
+               auto a = _mm256_sll_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)), shift);
+               auto b = _mm256_sll_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 8)), shift);
+
+               if (gainQ15 == 32768)
+               {
+                  a = _mm256_srai_epi32(_mm256_add_epi32(_mm256_srai_epi32(a, 15), one), 1);
+                  b = _mm256_srai_epi32(_mm256_add_epi32(_mm256_srai_epi32(b, 15), one), 1);
+               }
+               else
+               {
+                  // the split multiply of the sse2 version - pack and unpack stay within the 128 bit lanes,
+                  // so every sample ends up in its own 32 bit slot again before the final pack
+                  const auto high = _mm256_packs_epi32(_mm256_srai_epi32(a, 16), _mm256_srai_epi32(b, 16));
+                  const auto low = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16), _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16));
+                  const auto highLo = _mm256_mullo_epi16(high, gain);
+                  const auto highHi = _mm256_mulhi_epi16(high, gain);
+                  const auto lowLo = _mm256_mullo_epi16(low, gain);
+                  const auto lowHi = _mm256_mulhi_epu16(low, gain);
+
+                  const auto lowA = _mm256_srli_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(lowLo, lowHi), half), 16);
+                  const auto lowB = _mm256_srli_epi32(_mm256_add_epi32(_mm256_unpackhi_epi16(lowLo, lowHi), half), 16);
+                  a = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(highLo, highHi), lowA), 15);
+                  b = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpackhi_epi16(highLo, highHi), lowB), 15);
+               }
+
+               _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+            }
+
+            sse2::narrowS32ToS16(in + i, out + i, count - i, preShift, gainQ15);
+         }
+
+         __attribute__((target("avx2,fma")))
+         void accumulateRamp(float* acc, const float* in, size_t count, float gain, float gainStep)
+         {
+            auto g = _mm256_add_ps(_mm256_set1_ps(gain), _mm256_mul_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps(gainStep)));
+            const auto step = _mm256_set1_ps(8*gainStep);
+            size_t i = 0;
+
+            for (; i + 8 <= count; i += 8)
+            {
+               _mm256_storeu_ps(acc + i, _mm256_fmadd_ps(_mm256_loadu_ps(in + i), g, _mm256_loadu_ps(acc + i)));
+               g = _mm256_add_ps(g, step);
+            }
+
+            sse2::accumulateRamp(acc + i, in + i, count - i, gain + (i * gainStep), gainStep);
+         }
+
+         __attribute__((target("avx2")))
+         void floatToS16(const float* in, int16_t* out, size_t count, float scale)
+         {
+            const auto s = _mm256_set1_ps(scale);
+            const auto maxValue = _mm256_set1_ps(32767.0f);
+            const auto minValue = _mm256_set1_ps(-32768.0f);
+            size_t i = 0;
+
+            for (; i + 16 <= count; i += 16)
+            {
+               const auto a = _mm256_cvtps_epi32(_mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), s), maxValue), minValue));
+               const auto b = _mm256_cvtps_epi32(_mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), s), maxValue), minValue));
+               _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+            }
+
+            sse2::floatToS16(in + i, out + i, count - i, scale);
+         }
+      }
+#endif
+
+#if defined(AUDIO_KERNELS_NEON)
+      namespace neon
+      {
+         void fanOut16(const int16_t* mono, int16_t* out, size_t frames, uint32_t channels)
+         {
+            size_t f = 0;
+
+            if (channels == 2)
+            {
+               for (; f + 8 <= frames; f += 8)
+               {
+                  const auto m = vld1q_s16(mono + f);
+                  vst2q_s16(out + 2*f, (int16x8x2_t { { m, m } }));
+               }
+            }
+            else if (channels == 4)
+            {
+               for (; f + 8 <= frames; f += 8)
+               {
+                  const auto m = vld1q_s16(mono + f);
+                  vst4q_s16(out + 4*f, (int16x8x4_t { { m, m, m, m } }));
+               }
+            }
+
+            scalar::fanOut16(mono + f, out + f*channels, frames - f, channels);
+         }
+
+         void interleave16(const int16_t* const* planes, int16_t* out, size_t frames, uint32_t channels)
+         {
+            if (channels == 4)
+            {
+               size_t f = 0;
+               for (; f + 8 <= frames; f += 8)
+               {
+                  vst4q_s16(out + 4*f, (int16x8x4_t { { vld1q_s16(planes[0] + f), vld1q_s16(planes[1] + f),
+                                                        vld1q_s16(planes[2] + f), vld1q_s16(planes[3] + f) } }));
+               }
+
+               const int16_t* rest[4] { planes[0] + f, planes[1] + f, planes[2] + f, planes[3] + f };
+               scalar::interleave16(rest, out + 4*f, frames - f, 4);
+               return;
+            }
+            if (channels != 2)
+            {
+               scalar::interleave16(planes, out, frames, channels);
+               return;
+            }
+
+            size_t f = 0;
+            for (; f + 8 <= frames; f += 8)
+            {
+               vst2q_s16(out + 2*f, (int16x8x2_t { { vld1q_s16(planes[0] + f), vld1q_s16(planes[1] + f) } }));
+            }
+
+            const int16_t* rest[2] { planes[0] + f, planes[1] + f };
+            scalar::interleave16(rest, out + 2*f, frames - f, 2);
+         }
+
+         void deinterleave16(const int16_t* in, int16_t* const* planes, size_t frames, uint32_t channels)
+         {
+            if (channels != 2)
+            {
+               scalar::deinterleave16(in, planes, frames, channels);
+               return;
+            }
+
+            size_t f = 0;
+            for (; f + 8 <= frames; f += 8)
+            {
+               const auto lr = vld2q_s16(in + 2*f);
+               vst1q_s16(planes[0] + f, lr.val[0]);
+               vst1q_s16(planes[1] + f, lr.val[1]);
+            }
+
+            int16_t* rest[2] { planes[0] + f, planes[1] + f };
+            scalar::deinterleave16(in + 2*f, rest, frames - f, 2);
+         }
+
+         void interleave32(const int32_t* const* planes, int32_t* out, size_t frames, uint32_t channels)
+         {
+            if (channels != 2)
+            {
+               scalar::interleave32(planes, out, frames, channels);
+               return;
+            }
+
+            size_t f = 0;
+            for (; f + 4 <= frames; f += 4)
+            {
+               vst2q_s32(out + 2*f, (int32x4x2_t { { vld1q_s32(planes[0] + f), vld1q_s32(planes[1] + f) } }));
+            }
+
+            const int32_t* rest[2] { planes[0] + f, planes[1] + f };
+            scalar::interleave32(rest, out + 2*f, frames - f, 2);
+         }
+
+         void deinterleave32(const int32_t* in, int32_t* const* planes, size_t frames, uint32_t channels)
+         {
+            if (channels != 2)
+            {
+               scalar::deinterleave32(in, planes, frames, channels);
+               return;
+            }
+
+            size_t f = 0;
+            for (; f + 4 <= frames; f += 4)
+            {
+               const auto lr = vld2q_s32(in + 2*f);
+               vst1q_s32(planes[0] + f, lr.val[0]);
+               vst1q_s32(planes[1] + f, lr.val[1]);
+            }
+
+            int32_t* rest[2] { planes[0] + f, planes[1] + f };
+            scalar::deinterleave32(in + 2*f, rest, frames - f, 2);
+         }
+
+         void byteSwap16(uint16_t* samples, size_t count)
+         {
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+               vst1q_u16(samples + i, vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(vld1q_u16(samples + i)))));
+            }
+            scalar::byteSwap16(samples + i, count - i);
+         }
+
+         void byteSwap32(uint32_t* samples, size_t count)
+         {
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+               vst1q_u32(samples + i, vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(vld1q_u32(samples + i)))));
+            }
+            scalar::byteSwap32(samples + i, count - i);
+         }
+
+         void narrowS32ToS16(const int32_t* in, int16_t* out, size_t count, uint32_t preShift, int32_t gainQ15)
+         {
+            const auto shift = vdupq_n_s32(static_cast<int32_t>(preShift));
+            size_t i = 0;
+
+            for (; i + 8 <= count; i += 8)
+            {
+               auto a = vshlq_s32(vld1q_s32(in + i), shift);
+               auto b = vshlq_s32(vld1q_s32(in + i + 4), shift);
+
+               if (gainQ15 == 32768)
+               {
+                  a = vrshrq_n_s32(a, 16);
+                  b = vrshrq_n_s32(b, 16);
+               }
+               else
+               {
+                  // 32x32 -> 64 bit products, vrshrn adds the 2^30 before the shift - one rounding
+                  a = vcombine_s32(vrshrn_n_s64(vmull_n_s32(vget_low_s32(a), gainQ15), 31), vrshrn_n_s64(vmull_n_s32(vget_high_s32(a), gainQ15), 31));
+                  b = vcombine_s32(vrshrn_n_s64(vmull_n_s32(vget_low_s32(b), gainQ15), 31), vrshrn_n_s64(vmull_n_s32(vget_high_s32(b), gainQ15), 31));
+               }
+
+               vst1q_s16(out + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+            }
+
+            scalar::narrowS32ToS16(in + i, out + i, count - i, preShift, gainQ15);
+         }
+
+         void accumulateRamp(float* acc, const float* in, size_t count, float gain, float gainStep)
+         {
+            const float offsets[4] { 0.0f, 1.0f, 2.0f, 3.0f };
+            auto g = vmlaq_n_f32(vdupq_n_f32(gain), vld1q_f32(offsets), gainStep);
+            const auto step = vdupq_n_f32(4*gainStep);
+            size_t i = 0;
+
+            for (; i + 4 <= count; i += 4)
+            {
+               vst1q_f32(acc + i, vmlaq_f32(vld1q_f32(acc + i), vld1q_f32(in + i), g));
+               g = vaddq_f32(g, step);
+            }
+
+            scalar::accumulateRamp(acc + i, in + i, count - i, gain + (i * gainStep), gainStep);
+         }
+
+         void floatToS16(const float* in, int16_t* out, size_t count, float scale)
+         {
+            size_t i = 0;
+
+            for (; i + 8 <= count; i += 8)
+            {
+               // vcvtnq rounds to nearest and saturates, vqmovn narrows with saturation
+               const auto a = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in + i), scale));
+               const auto b = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in + i + 4), scale));
+               vst1q_s16(out + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+            }
+
+            scalar::floatToS16(in + i, out + i, count - i, scale);
+         }
+
+         void floatToS32(const float* in, int32_t* out, size_t count, float scale)
+         {
+            size_t i = 0;
+
+            for (; i + 4 <= count; i += 4)
+            {
+               vst1q_s32(out + i, vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in + i), scale)));
+            }
+
+            scalar::floatToS32(in + i, out + i, count - i, scale);
+         }
+      }
+#endif
+
+      namespace
+      {
+         const KernelTable SCALAR_KERNELS { Isa::Scalar, "scalar", scalar::fanOut16, scalar::interleave16, scalar::deinterleave16,
+                                            scalar::interleave32, scalar::deinterleave32, scalar::byteSwap16, scalar::byteSwap32,
+                                            scalar::narrowS32ToS16, scalar::accumulateRamp, scalar::floatToS16, scalar::floatToS32 };
+#if defined(AUDIO_KERNELS_X86)
+         const KernelTable SSE2_KERNELS { Isa::Sse2, "sse2", sse2::fanOut16, sse2::interleave16, sse2::deinterleave16,
+                                          sse2::interleave32, sse2::deinterleave32, sse2::byteSwap16, sse2::byteSwap32,
+                                          sse2::narrowS32ToS16, sse2::accumulateRamp, sse2::floatToS16, sse2::floatToS32 };
+         const KernelTable AVX2_KERNELS { Isa::Avx2, "avx2", avx2::fanOut16, avx2::interleave16, sse2::deinterleave16,
+                                          sse2::interleave32, sse2::deinterleave32, avx2::byteSwap16, avx2::byteSwap32,
+                                          avx2::narrowS32ToS16, avx2::accumulateRamp, avx2::floatToS16, sse2::floatToS32 };
+#endif
+#if defined(AUDIO_KERNELS_NEON)
+         const KernelTable NEON_KERNELS { Isa::Neon, "neon", neon::fanOut16, neon::interleave16, neon::deinterleave16,
+                                          neon::interleave32, neon::deinterleave32, neon::byteSwap16, neon::byteSwap32,
+                                          neon::narrowS32ToS16, neon::accumulateRamp, neon::floatToS16, neon::floatToS32 };
+#endif
+
+         const KernelTable* detect()
+         {
+#if defined(AUDIO_KERNELS_X86)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            {
+               return &AVX2_KERNELS;
+            }
+            if (__builtin_cpu_supports("sse2"))
+            {
+               return &SSE2_KERNELS;
+            }
+#elif defined(AUDIO_KERNELS_NEON)
+            return &NEON_KERNELS;
+#endif
+            return &SCALAR_KERNELS;
+         }
+
+         std::atomic<const KernelTable*>& activeKernels()
+         {
+            static std::atomic<const KernelTable*> kernels { detect() };
+            return kernels;
+         }
+      }
+
+      const KernelTable& active()
+      {
+         return *activeKernels().load(std::memory_order_relaxed);
+      }
+
+      const KernelTable* forIsa(Isa isa)
+      {
+         switch (isa)
+         {
+            case Isa::Scalar:
+               return &SCALAR_KERNELS;
+#if defined(AUDIO_KERNELS_X86)
+            case Isa::Sse2:
+               __builtin_cpu_init();
+               return __builtin_cpu_supports("sse2") ? &SSE2_KERNELS : nullptr;
+            case Isa::Avx2:
+               __builtin_cpu_init();
+               return (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? &AVX2_KERNELS : nullptr;
+#endif
+#if defined(AUDIO_KERNELS_NEON)
+            case Isa::Neon:
+               return &NEON_KERNELS;
+#endif
+            default:
+               return nullptr;
+         }
+      }
+
+      bool select(Isa isa)
+      {
+         auto kernels = forIsa(isa);
+         if (kernels == nullptr)
+         {
+            return false;
+         }
+
+         activeKernels().store(kernels, std::memory_order_relaxed);
+         return true;
+      }
+   }
+}
@@ -0,0 +1,115 @@
+/*
+ *  Vectorized sample kernels: mono -> N channel fan-out, planar <-> interleaved conversion,
+ *  16/32 bit byte swapping, the 32 -> 16 bit narrowing used by the bit depth converter and the
+ *  float accumulate / saturate loops of the mixer.
+ *  There are SSE2, AVX2 and NEON variants next to a scalar fallback. The best one supported by the
+ *  CPU is picked once at runtime (NEON is a compile time choice, every aarch64 CPU has it).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace audio
+{
+   namespace kernels
+   {
+      enum class Isa
+      {
+         Scalar,
+         Sse2,
+         Avx2,
+         Neon
+      };
+
+      struct KernelTable
+      {
+         Isa         isa;
+         const char* name;
+
+         void (*fanOut16)(const int16_t* mono, int16_t* out, size_t frames, uint32_t channels);
+         void (*interleave16)(const int16_t* const* planes, int16_t* out, size_t frames, uint32_t channels);
+         void (*deinterleave16)(const int16_t* in, int16_t* const* planes, size_t frames, uint32_t channels);
+         void (*interleave32)(const int32_t* const* planes, int32_t* out, size_t frames, uint32_t channels);
+         void (*deinterleave32)(const int32_t* in, int32_t* const* planes, size_t frames, uint32_t channels);
+         void (*byteSwap16)(uint16_t* samples, size_t count);
+         void (*byteSwap32)(uint32_t* samples, size_t count);
+
+         /* (in << preShift) * gainQ15 (<= 32768 = unity) rounded to 16 bit once and saturated - the gain */
+         /* is applied to all the 32 bits, so the bits below the 16 bit LSB still count                  */
+         void (*narrowS32ToS16)(const int32_t* in, int16_t* out, size_t count, uint32_t preShift, int32_t gainQ15);
+
+         /* acc[i] += in[i] * (gain + i*gainStep) - a gain ramp fused into the accumulation */
+         void (*accumulateRamp)(float* acc, const float* in, size_t count, float gain, float gainStep);
+
+         /* round(in[i] * scale) saturated to the 16 / 32 bit range */
+         void (*floatToS16)(const float* in, int16_t* out, size_t count, float scale);
+         void (*floatToS32)(const float* in, int32_t* out, size_t count, float scale);
+      };
+
+      /* the kernels of the best instruction set the CPU supports */
+      const KernelTable& active();
+
+      /* the kernels of a given instruction set (e.g. to benchmark them), nullptr when the CPU can't run them */
+      const KernelTable* forIsa(Isa isa);
+
+      /* forces the kernels used by the free functions below, returns false when the CPU can't run them */
+      bool select(Isa isa);
+
+      inline void fanOut16(const int16_t* mono, int16_t* out, size_t frames, uint32_t channels)
+      {
+         active().fanOut16(mono, out, frames, channels);
+      }
+
+      inline void interleave16(const int16_t* const* planes, int16_t* out, size_t frames, uint32_t channels)
+      {
+         active().interleave16(planes, out, frames, channels);
+      }
+
+      inline void deinterleave16(const int16_t* in, int16_t* const* planes, size_t frames, uint32_t channels)
+      {
+         active().deinterleave16(in, planes, frames, channels);
+      }
+
+      inline void interleave32(const int32_t* const* planes, int32_t* out, size_t frames, uint32_t channels)
+      {
+         active().interleave32(planes, out, frames, channels);
+      }
+
+      inline void deinterleave32(const int32_t* in, int32_t* const* planes, size_t frames, uint32_t channels)
+      {
+         active().deinterleave32(in, planes, frames, channels);
+      }
+
+      inline void byteSwap16(uint16_t* samples, size_t count)
+      {
+         active().byteSwap16(samples, count);
+      }
+
+      inline void byteSwap32(uint32_t* samples, size_t count)
+      {
+         active().byteSwap32(samples, count);
+      }
+
+      inline void narrowS32ToS16(const int32_t* in, int16_t* out, size_t count, uint32_t preShift, int32_t gainQ15)
+      {
+         active().narrowS32ToS16(in, out, count, preShift, gainQ15);
+      }
+
+      inline void accumulateRamp(float* acc, const float* in, size_t count, float gain, float gainStep)
+      {
+         active().accumulateRamp(acc, in, count, gain, gainStep);
+      }
+
+      inline void floatToS16(const float* in, int16_t* out, size_t count, float scale)
+      {
+         active().floatToS16(in, out, count, scale);
+      }
+
+      inline void floatToS32(const float* in, int32_t* out, size_t count, float scale)
+      {
+         active().floatToS32(in, out, count, scale);
+      }
+   }
+}
@@ -0,0 +1,128 @@
+/*
+ *  Sine lookup tables generated at compile time.
+ *  A table is parameterized on the sample type, sampling rate and sine frequency, the amplitude
+ *  (dampening) is a constexpr argument - changing any of them regenerates the data, nothing is pasted by hand.
+ *
+ *    constexpr auto table = audio::SineTable<int16_t, 48000, 1000>::make(0.7079);   // 48 samples, -3 dB
+ *
+ *  For targets with very little memory QuarterSineTable stores only a quarter of the period
+ *  (12 samples for 1 kHz at 48 kHz) and mirrors it on access.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+#include <limits>
+#include <type_traits>
+
+namespace audio
+{
+   namespace detail
+   {
+      constexpr double PI = 3.14159265358979323846;
+
+      /* sin() is not constexpr - a range reduced taylor series is precise enough for 32 bit samples */
+      constexpr double constexprSin(double x)
+      {
+         while (x > PI)  { x -= 2.0 * PI; }
+         while (x < -PI) { x += 2.0 * PI; }
+
+         double term = x;
+         double sum = x;
+         for (int n = 1; n < 12; ++n)
+         {
+            term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+            sum += term;
+         }
+         return sum;
+      }
+
+      template <typename TSample>
+      constexpr double fullScale()
+      {
+         if constexpr (std::is_floating_point<TSample>::value)
+         {
+            return 1.0;
+         }
+         else
+         {
+            return static_cast<double>(std::numeric_limits<TSample>::max());
+         }
+      }
+
+      /* sample n of the sine, truncated towards zero like the runtime generators of the demos */
+      template <typename TSample>
+      constexpr TSample sineSample(size_t n, size_t samplesPerPeriod, double amplitude)
+      {
+         return static_cast<TSample>(fullScale<TSample>() * amplitude * constexprSin((2.0 * PI * n) / samplesPerPeriod));
+      }
+   }
+
+   /* Size samples of one period followed by GuardSamples repeated from its start (for interpolating readers) */
+   template <typename TSample, size_t Size, size_t GuardSamples = 0>
+   constexpr std::array<TSample, Size + GuardSamples> makeSinePeriod(double amplitude = 1.0)
+   {
+      std::array<TSample, Size + GuardSamples> table {};
+      for (size_t n = 0; n < Size + GuardSamples; ++n)
+      {
+         table[n] = detail::sineSample<TSample>(n % Size, Size, amplitude);
+      }
+      return table;
+   }
+
+   template <typename TSample, uint32_t SampleRate, uint32_t Frequency>
+   struct SineTable
+   {
+      static_assert( Frequency < SampleRate/2 ); /* the frequency has to stay below nyquist */
+      static_assert( (SampleRate % Frequency) == 0 ); /* a table holds one whole period */
+
+      static constexpr size_t SIZE = SampleRate / Frequency;
+
+      static constexpr std::array<TSample, SIZE> make(double amplitude = 1.0)
+      {
+         return makeSinePeriod<TSample, SIZE>(amplitude);
+      }
+   };
+
+   /* stores the samples 1 .. N/4 of the period, the rest is mirrored - sample 0 is always zero */
+   template <typename TSample, uint32_t SampleRate, uint32_t Frequency>
+   struct QuarterSineTable
+   {
+      static_assert( Frequency < SampleRate/2 );
+      static_assert( (SampleRate % (4 * Frequency)) == 0 ); /* the quarters of the period have to be whole samples */
+
+      static constexpr size_t PERIOD = SampleRate / Frequency;
+      static constexpr size_t SIZE = PERIOD / 4;
+
+      std::array<TSample, SIZE> quarter {};
+
+      static constexpr QuarterSineTable make(double amplitude = 1.0)
+      {
+         QuarterSineTable table {};
+         for (size_t k = 0; k < SIZE; ++k)
+         {
+            table.quarter[k] = detail::sineSample<TSample>(k + 1, PERIOD, amplitude);
+         }
+         return table;
+      }
+
+      /* sample n (0 .. PERIOD-1) of the full period */
+      constexpr TSample operator[](size_t n) const
+      {
+         const auto r = n % SIZE;
+         TSample value {};
+
+         switch (n / SIZE)
+         {
+            case 0:  value = (r == 0) ? TSample {} : quarter[r - 1];        break;  /* rising from zero */
+            case 1:  value = quarter[SIZE - 1 - r];                         break;  /* falling from the peak */
+            case 2:  value = (r == 0) ? TSample {} : -quarter[r - 1];       break;
+            default: value = -quarter[SIZE - 1 - r];                        break;
+         }
+
+         return value;
+      }
+   };
+}
@@ -0,0 +1,228 @@
+#include "sourceScheduler.hpp"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace audio
+{
+   SourceScheduler::SourceScheduler(uint32_t channels, size_t blockFrames, size_t queueDepth)
+      : _channels(channels)
+      , _blockFrames(blockFrames)
+      , _commands(queueDepth, 1)
+      , _retired(queueDepth * 2 + 2, 1)   /* every queued command retires at most one source, plus the two playing */
+      , _current(blockFrames * channels)
+      , _fading(blockFrames * channels)
+   {
+   }
+
+   bool SourceScheduler::schedule(AudioSource* source, uint64_t startFrame, uint32_t fadeFrames, float gain)
+   {
+      auto span = _commands.writeSpan();
+      if (span.frames == 0)
+      {
+         return false;
+      }
+
+      span.data[0] = Command { source, startFrame, fadeFrames, gain };
+      _commands.commitWrite(1);
+      _idle.store(false, std::memory_order_relaxed);
+      return true;
+   }
+
+   AudioSource* SourceScheduler::retired()
+   {
+      auto span = _retired.readSpan();
+      if (span.frames == 0)
+      {
+         return nullptr;
+      }
+
+      auto source = span.data[0];
+      _retired.commitRead(1);
+      return source;
+   }
+
+   void SourceScheduler::retire(AudioSource* source)
+   {
+      if (source == nullptr)
+      {
+         return;
+      }
+
+      auto span = _retired.writeSpan();
+      if (span.frames > 0)
+      {
+         span.data[0] = source;
+         _retired.commitWrite(1);
+      }
+   }
+
+   bool SourceScheduler::nextCommand(Command& command)
+   {
+      if (!_hasNext)
+      {
+         auto span = _commands.readSpan();
+         if (span.frames == 0)
+         {
+            return false;
+         }
+
+         _next = span.data[0];
+         _commands.commitRead(1);
+         _hasNext = true;
+      }
+
+      command = _next;
+      return true;
+   }
+
+   void SourceScheduler::start(const Command& command)
+   {
+      _hasNext = false;
+
+      // a fade still running is cut short, the new fade starts from the voice heard now
+      retire(_fadeOut.source);
+      _fadeOut = Voice {};
+      _fadeFrames = 0;
+
+      if ((command.fadeFrames > 0) && (_voice.source != nullptr))
+      {
+         _fadeOut = _voice;
+         _fadeFrames = command.fadeFrames;
+         _fadePos = 0;
+      }
+      else
+      {
+         retire(_voice.source);
+      }
+
+      _voice.source = command.source;
+      _voice.gain = command.gain;
+
+      // fading in from silence
+      if ((command.fadeFrames > 0) && (_fadeOut.source == nullptr) && (command.source != nullptr))
+      {
+         _fadeFrames = command.fadeFrames;
+         _fadePos = 0;
+      }
+   }
+
+   size_t SourceScheduler::renderVoice(Voice& voice, float* out, size_t frames, bool& ended)
+   {
+      size_t rendered = 0;
+      ended = false;
+
+      if (voice.source != nullptr)
+      {
+         rendered = voice.source->render(out, frames, _channels);
+         ended = (rendered < frames);
+      }
+
+      memset(out + rendered * _channels, 0, (frames - rendered) * _channels * sizeof(float));
+      return rendered;
+   }
+
+   size_t SourceScheduler::render(float* out, size_t frames, uint32_t channels)
+   {
+      auto position = _position.load(std::memory_order_relaxed);
+      size_t done = 0;
+
+      (void)channels;   // the sources render the channel count the scheduler was made for
+
+      while (done < frames)
+      {
+         size_t count = std::min(frames - done, _blockFrames);
+
+         // a scheduled start splits the block exactly at its frame
+         Command command {};
+         if (nextCommand(command) && (command.startFrame == AFTER_CURRENT) && (_voice.source == nullptr))
+         {
+            // nothing to wait for
+            start(command);
+            continue;
+         }
+
+         if (nextCommand(command) && (command.startFrame != AFTER_CURRENT))
+         {
+            if (command.startFrame <= position)
+            {
+               if (command.startFrame < position)
+               {
+                  _lateStarts.fetch_add(1, std::memory_order_relaxed);
+               }
+               start(command);
+               continue;
+            }
+            count = std::min<size_t>(count, command.startFrame - position);
+         }
+
+         // the end of a fade splits it too, so that the faded out source is retired right there
+         if (_fadeFrames > 0)
+         {
+            count = std::min<size_t>(count, _fadeFrames - _fadePos);
+         }
+
+         bool ended = false;
+         auto rendered = renderVoice(_voice, _current.data(), count, ended);
+
+         if (ended)
+         {
+            // the current source ran out - the rest of the block belongs to a gapless successor, if one is queued
+            count = rendered;
+            retire(_voice.source);
+            _voice = Voice {};
+         }
+
+         float* dst = out + done * _channels;
+
+         if (_fadeFrames > 0)
+         {
+            bool fadeEnded = false;
+            renderVoice(_fadeOut, _fading.data(), count, fadeEnded);
+
+            // equal power crossfade - the sources are not correlated
+            for (size_t f = 0; f < count; ++f)
+            {
+               const float x = (static_cast<float>(_fadePos + f) + 0.5f) / _fadeFrames;
+               const float in = sinf(x * static_cast<float>(M_PI_2)) * _voice.gain;
+               const float outGain = cosf(x * static_cast<float>(M_PI_2)) * _fadeOut.gain;
+
+               for (uint32_t c = 0; c < _channels; ++c)
+               {
+                  const auto i = f * _channels + c;
+                  dst[i] = _current[i] * in + _fading[i] * outGain;
+               }
+            }
+
+            _fadePos += static_cast<uint32_t>(count);
+            if (fadeEnded || (_fadePos >= _fadeFrames))
+            {
+               retire(_fadeOut.source);
+               _fadeOut = Voice {};
+               _fadeFrames = 0;
+            }
+         }
+         else
+         {
+            for (size_t i = 0; i < count * _channels; ++i)
+            {
+               dst[i] = _current[i] * _voice.gain;
+            }
+         }
+
+         done += count;
+         position += count;
+
+         // gapless: the successor takes over at the very next frame, without it the next round renders silence
+         if (ended && nextCommand(command) && (command.startFrame == AFTER_CURRENT))
+         {
+            start(command);
+         }
+      }
+
+      _position.store(position, std::memory_order_relaxed);
+      _idle.store(!_hasNext && (_voice.source == nullptr) && (_fadeOut.source == nullptr) && (_commands.readable() == 0),
+                  std::memory_order_relaxed);
+      return frames;
+   }
+}
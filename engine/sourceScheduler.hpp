@@ -0,0 +1,87 @@
+/*
+ *  A command queue in front of the sources: a source is started at an exact frame of the stream, cutting or
+ *  crossfading from the one playing, or right after the current one ends (gapless back-to-back clips).
+ *  The scheduler is itself an AudioSource which never ends - nothing playing is rendered as silence -
+ *  so the device stays open and its ring full while the sources change.
+ *  Commands are queued from a control thread and picked up by the render thread without locks; the switch
+ *  happens inside the block at the requested frame. PcmOutput::framePosition() maps a wall clock time to that
+ *  frame. Sources which are not used any more are handed back through retired() to be deleted or reused.
+ */
+
+#pragma once
+
+#include "audioSource.hpp"
+#include "spscRing.hpp"
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace audio
+{
+   class SourceScheduler : public AudioSource
+   {
+   public:
+      static constexpr uint64_t AFTER_CURRENT = UINT64_MAX;   /* start frame: the frame after the current source ends */
+
+      /* blockFrames is the largest amount rendered by one render() call of the scheduler into its sources */
+      SourceScheduler(uint32_t channels, size_t blockFrames, size_t queueDepth = 16);
+
+      /* control thread: starts source at the given stream frame, crossfading over fadeFrames (0 cuts)           */
+      /* commands have to be queued in the order of their start frames, a frame already rendered starts at once */
+      /* a nullptr source fades (or cuts) to silence; returns false when the queue is full                       */
+      bool schedule(AudioSource* source, uint64_t startFrame, uint32_t fadeFrames = 0, float gain = 1.0f);
+
+      /* control thread: the next source which is no longer rendered, nullptr when there is none */
+      AudioSource* retired();
+
+      /* render thread: always renders all frames, silence where nothing is scheduled */
+      size_t render(float* out, size_t frames, uint32_t channels) override;
+
+      /* the stream frame of the next render() - starts at 0 like the written frames of PcmOutput */
+      uint64_t position() const { return _position.load(std::memory_order_relaxed); }
+
+      /* commands which arrived after their start frame was already rendered */
+      uint64_t lateStarts() const { return _lateStarts.load(std::memory_order_relaxed); }
+
+      /* true while nothing is queued and the current source, if any, ended */
+      bool idle() const { return _idle.load(std::memory_order_relaxed); }
+
+   private:
+      struct Command
+      {
+         AudioSource* source;
+         uint64_t     startFrame;
+         uint32_t     fadeFrames;
+         float        gain;
+      };
+
+      struct Voice
+      {
+         AudioSource* source = nullptr;
+         float        gain = 1.0f;
+      };
+
+      bool nextCommand(Command& command);
+      void start(const Command& command);
+      void retire(AudioSource* source);
+      size_t renderVoice(Voice& voice, float* out, size_t frames, bool& ended);
+
+      const uint32_t _channels;
+      const size_t   _blockFrames;
+      SpscFrameRing<Command>      _commands;   /* control -> render thread */
+      SpscFrameRing<AudioSource*> _retired;    /* render -> control thread */
+      std::vector<float> _current {};          /* block of the current source */
+      std::vector<float> _fading {};           /* block of the source faded out */
+
+      Voice    _voice {};
+      Voice    _fadeOut {};
+      uint32_t _fadeFrames = 0;
+      uint32_t _fadePos = 0;
+      bool     _hasNext = false;
+      Command  _next {};
+
+      std::atomic<uint64_t> _position { 0 };
+      std::atomic<uint64_t> _lateStarts { 0 };
+      std::atomic<bool>     _idle { true };
+   };
+}
@@ -0,0 +1,131 @@
+/*
+ *  Fixed capacity single-producer / single-consumer ring of interleaved audio frames.
+ *  One thread generates (or decodes) into it, another one drains it into ALSA - without locks.
+ *  Both sides work on contiguous spans, so nothing is copied at the wrap point: a caller which hits
+ *  the end of the storage simply gets a shorter span and asks again for the rest.
+ *  All operations are wait-free, the head and tail live on their own cache lines.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <new>
+
+namespace audio
+{
+   constexpr size_t CACHE_LINE_SIZE = 64;
+
+   template <typename TSample>
+   class SpscFrameRing
+   {
+   public:
+      template <typename TPtr>
+      struct Span
+      {
+         TPtr   data;     /* first sample of the first frame */
+         size_t frames;   /* amount of contiguous interleaved frames */
+      };
+
+      /* the capacity is rounded up to a power of two amount of frames */
+      SpscFrameRing(size_t capacityFrames, uint32_t channels)
+         : _capacity(roundUpPow2(capacityFrames))
+         , _mask(_capacity - 1)
+         , _channels(channels)
+         , _storage(new (std::align_val_t(CACHE_LINE_SIZE)) TSample[_capacity * channels]())
+      {
+      }
+
+      SpscFrameRing(const SpscFrameRing&) = delete;
+      SpscFrameRing& operator=(const SpscFrameRing&) = delete;
+
+      size_t capacity() const { return _capacity; }
+      uint32_t channels() const { return _channels; }
+
+      /* producer side: the free frames up to the wrap point */
+      Span<TSample*> writeSpan()
+      {
+         const auto head = _head.load(std::memory_order_relaxed);
+         const auto index = head & _mask;
+         auto free = _capacity - (head - _cachedTail);
+
+         // the shared tail is only touched when the cached one can't fill the span up to the wrap point
+         if (free < (_capacity - index))
+         {
+            _cachedTail = _tail.load(std::memory_order_acquire);
+            free = _capacity - (head - _cachedTail);
+         }
+
+         const auto contiguous = (free < (_capacity - index)) ? free : (_capacity - index);
+
+         return { _storage.get() + (index * _channels), contiguous };
+      }
+
+      /* producer side: publishes frames written into the last write span */
+      void commitWrite(size_t frames)
+      {
+         _head.store(_head.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+      }
+
+      /* consumer side: the queued frames up to the wrap point */
+      Span<const TSample*> readSpan()
+      {
+         const auto tail = _tail.load(std::memory_order_relaxed);
+         const auto index = tail & _mask;
+         auto queued = _cachedHead - tail;
+
+         if (queued < (_capacity - index))
+         {
+            _cachedHead = _head.load(std::memory_order_acquire);
+            queued = _cachedHead - tail;
+         }
+
+         const auto contiguous = (queued < (_capacity - index)) ? queued : (_capacity - index);
+
+         return { _storage.get() + (index * _channels), contiguous };
+      }
+
+      /* consumer side: releases frames of the last read span back to the producer */
+      void commitRead(size_t frames)
+      {
+         _tail.store(_tail.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+      }
+
+      /* approximate fill level - exact only when called from one of the two sides while the other one is idle */
+      size_t readable() const
+      {
+         return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+      }
+
+      size_t writable() const { return _capacity - readable(); }
+
+   private:
+      struct AlignedDelete
+      {
+         void operator()(TSample* ptr) const { operator delete[](ptr, std::align_val_t(CACHE_LINE_SIZE)); }
+      };
+
+      static size_t roundUpPow2(size_t value)
+      {
+         size_t res = 1;
+         while (res < value)
+         {
+            res <<= 1;
+         }
+         return res;
+      }
+
+      const size_t   _capacity;
+      const size_t   _mask;
+      const uint32_t _channels;
+      std::unique_ptr<TSample[], AlignedDelete> _storage;
+
+      alignas(CACHE_LINE_SIZE) std::atomic<size_t> _head { 0 };   /* written by the producer only */
+      size_t _cachedTail = 0;                                      /* producer's last seen tail */
+
+      alignas(CACHE_LINE_SIZE) std::atomic<size_t> _tail { 0 };   /* written by the consumer only */
+      size_t _cachedHead = 0;                                      /* consumer's last seen head */
+   };
+}
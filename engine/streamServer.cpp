@@ -0,0 +1,298 @@
+#include "streamServer.hpp"
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+namespace audio
+{
+   namespace
+   {
+      constexpr int MAX_EVENTS = 64;          /* handled per epoll_wait() */
+      constexpr int POLL_TIMEOUT_MS = 100;    /* the poll thread checks for stop() this often */
+
+      /* the fd index travels in the upper half of the epoll data, the stream index in the lower one */
+      inline uint64_t eventKey(uint32_t stream, size_t fd) { return (static_cast<uint64_t>(fd) << 32) | stream; }
+   }
+
+   StreamServer::StreamServer(const StreamServerSettings& settings) : _settings(settings)
+   {
+   }
+
+   StreamServer::~StreamServer()
+   {
+      stop();
+   }
+
+   int StreamServer::addStream(const PcmFormat& format, RenderFn render)
+   {
+      if (_streams.size() >= _settings.maxStreams)
+      {
+         printf("The stream server is limited to %zu streams\n", _settings.maxStreams);
+         return -ENOSPC;
+      }
+
+      std::unique_ptr<Stream> stream(new Stream());
+      PcmFormat deviceFormat = format;
+      deviceFormat.pacing = Pacing::DeviceClock;    /* SND_PCM_NONBLOCK - a worker must never block on one stream */
+
+      int err;
+      if ((err = stream->output.open(deviceFormat)) < 0)
+      {
+         return err;
+      }
+
+      if (!stream->output.isOffline())
+      {
+         auto count = snd_pcm_poll_descriptors_count(stream->output.handle());
+         if (count <= 0)
+         {
+            printf("%s has no poll descriptors\n", format.device);
+            return -EINVAL;
+         }
+
+         stream->fds.resize(count);
+         if ((err = snd_pcm_poll_descriptors(stream->output.handle(), stream->fds.data(), count)) < 0)
+         {
+            printf("Unable to obtain poll descriptors for %s: %s\n", format.device, snd_strerror(err));
+            return err;
+         }
+      }
+
+      stream->render = std::move(render);
+      _streams.push_back(std::move(stream));
+      return static_cast<int>(_streams.size() - 1);
+   }
+
+   int StreamServer::arm(uint32_t index, size_t fd, int op)
+   {
+      const auto& pfd = _streams[index]->fds[fd];
+
+      struct epoll_event event {};
+      event.events = EPOLLONESHOT | EPOLLERR;
+      if (pfd.events & POLLIN)
+      {
+         event.events |= EPOLLIN;
+      }
+      if (pfd.events & POLLOUT)
+      {
+         event.events |= EPOLLOUT;
+      }
+      event.data.u64 = eventKey(index, fd);
+
+      return (epoll_ctl(_epoll, op, pfd.fd, &event) < 0) ? -errno : 0;
+   }
+
+   int StreamServer::start()
+   {
+      int err;
+
+      if (_streams.empty())
+      {
+         return -EINVAL;
+      }
+
+      if ((_epoll = epoll_create1(EPOLL_CLOEXEC)) < 0)
+      {
+         err = -errno;
+         printf("epoll_create1 failed: %s\n", strerror(-err));
+         return err;
+      }
+
+      auto workerSettings = _settings.workerThreads;
+      workerSettings.name = "stream worker";
+      if ((err = _pool.start(_settings.workers, _streams.size(), workerSettings,
+                             [this](uint32_t task, uint32_t) { service(task); })) < 0)
+      {
+         return err;
+      }
+
+      _active.store(_streams.size(), std::memory_order_relaxed);
+
+      for (uint32_t s = 0; s < _streams.size(); ++s)
+      {
+         for (size_t fd = 0; fd < _streams[s]->fds.size(); ++fd)
+         {
+            if ((err = arm(s, fd, EPOLL_CTL_ADD)) < 0)
+            {
+               printf("Unable to add %s to the epoll set: %s\n", _streams[s]->output.format().device, strerror(-err));
+               stop();
+               return err;
+            }
+         }
+
+         // a stream which was not started yet is writable anyway, the first service fills its buffer
+         schedule(s);
+      }
+
+      auto pollSettings = _settings.pollThread;
+      pollSettings.name = "stream epoll";
+      _pollThread.start(pollSettings, [this]() { return pollOnce(); });
+      return 0;
+   }
+
+   bool StreamServer::pollOnce()
+   {
+      struct epoll_event events[MAX_EVENTS];
+
+      const int ready = epoll_wait(_epoll, events, MAX_EVENTS, POLL_TIMEOUT_MS);
+      if (ready < 0)
+      {
+         return errno == EINTR;
+      }
+
+      for (int e = 0; e < ready; ++e)
+      {
+         const auto index = static_cast<uint32_t>(events[e].data.u64 & 0xFFFFFFFFu);
+         const auto fd = static_cast<size_t>(events[e].data.u64 >> 32);
+         auto& stream = *_streams[index];
+
+         // the plugin decides what the raw descriptor events mean (e.g. a timer fd of dmix)
+         for (auto& pfd : stream.fds)
+         {
+            pfd.revents = 0;
+         }
+         stream.fds[fd].revents = static_cast<short>(events[e].events & (EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP));
+
+         unsigned short revents = 0;
+         snd_pcm_poll_descriptors_revents(stream.output.handle(), stream.fds.data(), stream.fds.size(), &revents);
+
+         if (revents & (POLLOUT | POLLERR | POLLNVAL))
+         {
+            schedule(index);
+         }
+         else if (!stream.done.load(std::memory_order_relaxed))
+         {
+            arm(index, fd, EPOLL_CTL_MOD);
+         }
+      }
+
+      return true;
+   }
+
+   void StreamServer::schedule(uint32_t index)
+   {
+      // a stream with more than one descriptor may fire again while it is queued - it is serviced once
+      if (!_streams[index]->queued.exchange(true, std::memory_order_acq_rel))
+      {
+         _pool.submit(index);
+      }
+   }
+
+   void StreamServer::service(uint32_t index)
+   {
+      auto& stream = *_streams[index];
+      auto& output = stream.output;
+      const auto period = output.negotiated().periodFrames;
+      bool more = true;
+
+      stream.services.fetch_add(1, std::memory_order_relaxed);
+      AUDIO_TRACE_SCOPE("stream service");
+
+      // everything the device has room for, whole periods only - the handle is non-blocking, writei never waits
+      while (more)
+      {
+         auto avail = output.waitForPeriod(0);
+         if (avail < 0)
+         {
+            printf("%s failed: %s\n", output.format().device, snd_strerror(avail));
+            finish(stream);
+            return;
+         }
+
+         const auto frames = (static_cast<snd_pcm_uframes_t>(avail) / period) * period;
+         if (frames == 0)
+         {
+            break;
+         }
+
+         auto res = output.render(frames, [&stream, &more](void* area, snd_pcm_uframes_t count)
+         {
+            more = more && stream.render(area, count);
+            if (!more)
+            {
+               // the rest of the period after the end of the stream
+               memset(area, 0, count * stream.output.frameBytes());
+            }
+         });
+         if (res < 0)
+         {
+            finish(stream);
+            return;
+         }
+
+         // a file takes any amount, one buffer per service keeps the offline streams interleaved fairly
+         if (output.isOffline())
+         {
+            break;
+         }
+      }
+
+      if (!more)
+      {
+         finish(stream);
+         return;
+      }
+
+      stream.queued.store(false, std::memory_order_release);
+
+      if (output.isOffline())
+      {
+         schedule(index);
+         return;
+      }
+
+      for (size_t fd = 0; fd < stream.fds.size(); ++fd)
+      {
+         arm(index, fd, EPOLL_CTL_MOD);
+      }
+   }
+
+   void StreamServer::finish(Stream& stream)
+   {
+      // the descriptors stay disarmed (one shot), the device plays what is queued until stop() drains it
+      if (!stream.done.exchange(true))
+      {
+         _active.fetch_sub(1, std::memory_order_relaxed);
+      }
+   }
+
+   void StreamServer::stop()
+   {
+      _pollThread.stop();
+      _pollThread.join();
+      _pool.stop();
+
+      if (_epoll >= 0)
+      {
+         ::close(_epoll);
+         _epoll = -1;
+      }
+
+      for (auto& stream : _streams)
+      {
+         if (stream->output.isOpen())
+         {
+            stream->output.drain();
+            stream->output.close();
+         }
+      }
+   }
+
+   void StreamServer::printReport() const
+   {
+      for (uint32_t w = 0; w < _pool.workerCount(); ++w)
+      {
+         printf("worker %u: %llu services, %llu stolen\n", w, static_cast<unsigned long long>(_pool.executed(w)),
+                static_cast<unsigned long long>(_pool.stolen(w)));
+      }
+
+      for (size_t s = 0; s < _streams.size(); ++s)
+      {
+         printf("stream %zu (%s)%s: %llu services | ", s, _streams[s]->output.format().device,
+                _streams[s]->done.load(std::memory_order_relaxed) ? " done" : "",
+                static_cast<unsigned long long>(services(s)));
+         printStats(_streams[s]->output.stats());
+      }
+   }
+}
@@ -0,0 +1,86 @@
+/*
+ *  Drives many independent playback streams from one process without a thread per stream.
+ *  Every stream is opened non-blocking (SND_PCM_NONBLOCK) and the poll descriptors of all of them are gathered
+ *  into one epoll set. A single poll thread waits on it and hands a stream whose device has room for a period
+ *  to a WorkStealingPool, where a worker renders and writes as many periods as fit, then re-arms the stream.
+ *  The descriptors are registered EPOLLONESHOT, so a stream is only ever serviced by one worker at a time.
+ */
+
+#pragma once
+
+#include "pcmOutput.hpp"
+#include "rtThread.hpp"
+#include "workPool.hpp"
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace audio
+{
+   struct StreamServerSettings
+   {
+      uint32_t   workers = 4;              /* threads rendering and writing the streams */
+      size_t     maxStreams = 64;
+      RtSettings workerThreads {};
+      RtSettings pollThread {};
+   };
+
+   class StreamServer
+   {
+   public:
+      /* renders frames interleaved host byte order frames into area, returning false ends the stream */
+      using RenderFn = std::function<bool(void* area, snd_pcm_uframes_t frames)>;
+
+      explicit StreamServer(const StreamServerSettings& settings = {});
+      ~StreamServer();
+
+      StreamServer(const StreamServer&) = delete;
+      StreamServer& operator=(const StreamServer&) = delete;
+
+      /* opens one more stream (pacing is always DeviceClock), returns its index or a negative error code */
+      /* must be called before start(); an offline stream (renderFile) is rendered as fast as the workers allow */
+      int addStream(const PcmFormat& format, RenderFn render);
+
+      /* starts the workers and the poll thread, the first service fills the buffers and starts the devices */
+      int start();
+
+      /* true once every stream returned false from its render function or failed */
+      bool finished() const { return _active.load(std::memory_order_relaxed) == 0; }
+
+      /* stops the threads, drains and closes the streams */
+      void stop();
+
+      size_t streamCount() const { return _streams.size(); }
+      const PcmOutput& stream(size_t index) const { return _streams[index]->output; }
+      uint64_t services(size_t index) const { return _streams[index]->services.load(std::memory_order_relaxed); }
+
+      void printReport() const;
+
+   private:
+      struct Stream
+      {
+         PcmOutput                   output;
+         RenderFn                    render {};
+         std::vector<struct pollfd>  fds {};        /* registered in the epoll set, revents filled by the poll thread */
+         std::atomic<bool>           queued { false };
+         std::atomic<bool>           done { false };
+         std::atomic<uint64_t>       services { 0 };
+      };
+
+      bool pollOnce();
+      void schedule(uint32_t index);
+      void service(uint32_t index);
+      void finish(Stream& stream);
+      int arm(uint32_t index, size_t fd, int op);
+
+      StreamServerSettings _settings;
+      std::vector<std::unique_ptr<Stream>> _streams {};
+      WorkStealingPool      _pool {};
+      RenderThread          _pollThread {};
+      int                   _epoll = -1;
+      std::atomic<size_t>   _active { 0 };
+   };
+}
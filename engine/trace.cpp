@@ -0,0 +1,189 @@
+#include "trace.hpp"
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace audio
+{
+   namespace trace
+   {
+      namespace
+      {
+#if defined(AUDIO_TRACE)
+         constexpr size_t RINGS = MAX_THREADS;
+#else
+         constexpr size_t RINGS = 1;   /* the macros record nothing, keeps mlockall() of the demos small */
+#endif
+
+         struct Ring
+         {
+            std::atomic<uint64_t> head { 0 };   /* events ever recorded, written by the owner only */
+            std::atomic<const char*> name { nullptr };
+            Event events[RING_EVENTS];
+         };
+
+         Ring _rings[RINGS];
+         std::atomic<size_t> _claimed { 0 };
+         std::atomic<bool> _xrun { false };
+         thread_local Ring* _ring = nullptr;
+
+         uint64_t monotonicRawNanos()
+         {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+            return (static_cast<uint64_t>(ts.tv_sec) * 1000000000u) + static_cast<uint64_t>(ts.tv_nsec);
+         }
+
+         /* the tick counter against the raw monotonic clock at start-up, the dump calibrates with a second pair */
+         struct Origin
+         {
+            uint64_t ticks = trace::ticks();
+            uint64_t nanos = monotonicRawNanos();
+         };
+         const Origin _origin {};
+
+         Ring* claim()
+         {
+            const auto index = _claimed.fetch_add(1, std::memory_order_relaxed);
+            if (index >= RINGS)
+            {
+               return nullptr;
+            }
+            return &_rings[index];
+         }
+      }
+
+      bool enabled()
+      {
+#if defined(AUDIO_TRACE)
+         return true;
+#else
+         return false;
+#endif
+      }
+
+      void setThreadName(const char* name)
+      {
+         if (_ring == nullptr)
+         {
+            _ring = claim();
+         }
+         if (_ring != nullptr)
+         {
+            _ring->name.store(name, std::memory_order_relaxed);
+         }
+      }
+
+      void record(Phase phase, const char* name, int32_t value)
+      {
+         if (_ring == nullptr)
+         {
+            // more threads than rings - the rest isn't traced
+            if ((_ring = claim()) == nullptr)
+            {
+               return;
+            }
+         }
+
+         const auto head = _ring->head.load(std::memory_order_relaxed);
+         auto& event = _ring->events[head & (RING_EVENTS - 1)];
+         event.ticks = ticks();
+         event.name = name;
+         event.value = value;
+         event.phase = phase;
+         _ring->head.store(head + 1, std::memory_order_release);
+      }
+
+      void markXrun()
+      {
+         _xrun.store(true, std::memory_order_relaxed);
+      }
+
+      bool takeXrun()
+      {
+         return _xrun.exchange(false, std::memory_order_relaxed);
+      }
+
+      int dumpChromeJson(const char* path)
+      {
+         FILE* file = fopen(path, "w");
+         if (file == nullptr)
+         {
+            const int err = -errno;
+            printf("Can't write the trace to %s: %s\n", path, strerror(-err));
+            return err;
+         }
+
+         // ticks -> nanoseconds from the two calibration points
+         const uint64_t nowTicks = ticks();
+         const uint64_t nowNanos = monotonicRawNanos();
+         const double nanosPerTick = (nowTicks > _origin.ticks)
+            ? static_cast<double>(nowNanos - _origin.nanos) / static_cast<double>(nowTicks - _origin.ticks) : 1.0;
+
+         const size_t threads = std::min(_claimed.load(std::memory_order_relaxed), RINGS);
+         std::vector<Event> snapshot(RING_EVENTS);
+         size_t written = 0;
+         bool first = true;
+
+         fprintf(file, "{\"traceEvents\":[\n");
+
+         for (size_t t = 0; t < threads; ++t)
+         {
+            auto& ring = _rings[t];
+            const auto name = ring.name.load(std::memory_order_relaxed);
+
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", t, (name != nullptr) ? name : "thread");
+            first = false;
+
+            // copied while the owner keeps recording - whatever it overwrote meanwhile is dropped
+            const auto end = ring.head.load(std::memory_order_acquire);
+            const auto begin = (end > RING_EVENTS) ? end - RING_EVENTS : 0;
+            for (auto i = begin; i < end; ++i)
+            {
+               snapshot[i - begin] = ring.events[i & (RING_EVENTS - 1)];
+            }
+
+            const auto after = ring.head.load(std::memory_order_acquire);
+            const auto valid = (after > RING_EVENTS) ? std::max(begin, after - RING_EVENTS + 1) : begin;
+
+            for (auto i = valid; i < end; ++i)
+            {
+               const auto& event = snapshot[i - begin];
+               const double micros = ((event.ticks - _origin.ticks) * nanosPerTick) / 1000.0;
+
+               switch (event.phase)
+               {
+                  case Phase::Begin:
+                  case Phase::End:
+                     fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%zu}", event.name,
+                             (event.phase == Phase::Begin) ? "B" : "E", micros, t);
+                     break;
+
+                  case Phase::Instant:
+                     fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%zu,"
+                             "\"args\":{\"value\":%lld}}", event.name, micros, t, static_cast<long long>(event.value));
+                     break;
+
+                  case Phase::Counter:
+                     fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%zu,"
+                             "\"args\":{\"value\":%lld}}", event.name, micros, t, static_cast<long long>(event.value));
+                     break;
+               }
+               ++written;
+            }
+         }
+
+         fprintf(file, "\n]}\n");
+         const int err = (fclose(file) == 0) ? 0 : -errno;
+
+         printf("Wrote %zu trace events of %zu threads to %s%s\n", written, threads, path,
+                enabled() ? "" : " (tracing is compiled out, build with AUDIO_TRACE)");
+         return err;
+      }
+   }
+}
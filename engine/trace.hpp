@@ -0,0 +1,102 @@
+/*
+ *  Hot path tracing which can stay enabled in production.
+ *  When compiled with AUDIO_TRACE the AUDIO_TRACE_* macros record timestamped events (TSC on x86,
+ *  CLOCK_MONOTONIC_RAW elsewhere) into a lock-free ring owned by the calling thread - a few stores and no
+ *  syscall per event. The rings live in static storage, so tracing never allocates.
+ *  dumpChromeJson() writes the last events of every thread in the Chrome trace / Perfetto JSON format;
+ *  an xrun raises a flag (takeXrun()) so that a control thread can dump the moments leading up to it.
+ *  Without the define the macros compile to nothing.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+namespace audio
+{
+   namespace trace
+   {
+      constexpr size_t RING_EVENTS = 4096;   /* last events kept per thread, a power of two */
+      constexpr size_t MAX_THREADS = 32;     /* 96 kB of rings each, only reserved in AUDIO_TRACE builds */
+
+      enum class Phase : uint8_t
+      {
+         Begin,
+         End,
+         Instant,
+         Counter
+      };
+
+      struct Event
+      {
+         uint64_t    ticks;
+         const char* name;     /* has to be a string literal (or live as long as the process) */
+         int32_t     value;    /* counter value or argument of an instant event */
+         Phase       phase;
+      };
+
+      inline uint64_t ticks()
+      {
+#if defined(__x86_64__) || defined(__i386__)
+         return __rdtsc();
+#else
+         struct timespec ts;
+         clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+         return (static_cast<uint64_t>(ts.tv_sec) * 1000000000u) + static_cast<uint64_t>(ts.tv_nsec);
+#endif
+      }
+
+      /* names the ring of the calling thread in the dump, claims it up front so that the first event is cheap */
+      void setThreadName(const char* name);
+
+      /* appends an event to the ring of the calling thread, the oldest events are overwritten */
+      void record(Phase phase, const char* name, int32_t value = 0);
+
+      /* flags an xrun, e.g. from the recovery path of PcmOutput */
+      void markXrun();
+
+      /* true once per flagged xrun - poll it from a control thread and dump then */
+      bool takeXrun();
+
+      /* writes the rings of every thread to a Chrome trace JSON file, returns 0 or a negative errno code */
+      int dumpChromeJson(const char* path);
+
+      bool enabled();
+
+      class Scope
+      {
+      public:
+         explicit Scope(const char* name) : _name(name) { record(Phase::Begin, name); }
+         ~Scope() { record(Phase::End, _name); }
+
+         Scope(const Scope&) = delete;
+         Scope& operator=(const Scope&) = delete;
+
+      private:
+         const char* _name;
+      };
+   }
+}
+
+#if defined(AUDIO_TRACE)
+#define AUDIO_TRACE_CONCAT2(a, b) a##b
+#define AUDIO_TRACE_CONCAT(a, b) AUDIO_TRACE_CONCAT2(a, b)
+#define AUDIO_TRACE_SCOPE(name) audio::trace::Scope AUDIO_TRACE_CONCAT(_traceScope, __LINE__)(name)
+#define AUDIO_TRACE_INSTANT(name, value) audio::trace::record(audio::trace::Phase::Instant, name, static_cast<int32_t>(value))
+#define AUDIO_TRACE_COUNTER(name, value) audio::trace::record(audio::trace::Phase::Counter, name, static_cast<int32_t>(value))
+#define AUDIO_TRACE_THREAD(name) audio::trace::setThreadName(name)
+#define AUDIO_TRACE_XRUN() do { audio::trace::record(audio::trace::Phase::Instant, "xrun"); audio::trace::markXrun(); } while (0)
+#else
+#define AUDIO_TRACE_SCOPE(name) do {} while (0)
+#define AUDIO_TRACE_INSTANT(name, value) do {} while (0)
+#define AUDIO_TRACE_COUNTER(name, value) do {} while (0)
+#define AUDIO_TRACE_THREAD(name) do {} while (0)
+#define AUDIO_TRACE_XRUN() do {} while (0)
+#endif
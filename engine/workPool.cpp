@@ -0,0 +1,150 @@
+#include "workPool.hpp"
+#include <errno.h>
+#include <chrono>
+
+namespace audio
+{
+   namespace
+   {
+      constexpr int IDLE_WAIT_MS = 10;   /* an idle worker rechecks the queues at least this often */
+   }
+
+   bool WorkStealingPool::Worker::push(uint32_t task)
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      if (count == tasks.size())
+      {
+         return false;
+      }
+
+      tasks[(head + count) % tasks.size()] = task;
+      ++count;
+      return true;
+   }
+
+   bool WorkStealingPool::Worker::popFront(uint32_t& task)
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      if (count == 0)
+      {
+         return false;
+      }
+
+      task = tasks[head];
+      head = (head + 1) % tasks.size();
+      --count;
+      return true;
+   }
+
+   bool WorkStealingPool::Worker::popBack(uint32_t& task)
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      if (count == 0)
+      {
+         return false;
+      }
+
+      --count;
+      task = tasks[(head + count) % tasks.size()];
+      return true;
+   }
+
+   WorkStealingPool::~WorkStealingPool()
+   {
+      stop();
+   }
+
+   int WorkStealingPool::start(uint32_t workers, size_t capacity, const RtSettings& settings, TaskFn handler)
+   {
+      stop();
+
+      if ((workers == 0) || (capacity == 0))
+      {
+         return -EINVAL;
+      }
+
+      _handler = std::move(handler);
+      _workers.clear();
+      for (uint32_t w = 0; w < workers; ++w)
+      {
+         _workers.emplace_back(new Worker(capacity));
+      }
+
+      for (uint32_t w = 0; w < workers; ++w)
+      {
+         _workers[w]->thread.start(settings, [this, w]() { return runOnce(w); });
+      }
+
+      return 0;
+   }
+
+   bool WorkStealingPool::submit(uint32_t task)
+   {
+      if (_workers.empty())
+      {
+         return false;
+      }
+
+      const auto target = _next.fetch_add(1, std::memory_order_relaxed) % _workers.size();
+      if (!_workers[target]->push(task))
+      {
+         return false;
+      }
+
+      _pending.fetch_add(1, std::memory_order_release);
+      {
+         // under the lock, so that a worker between its check and the wait can't miss the wakeup
+         std::lock_guard<std::mutex> guard(_idleLock);
+      }
+      _wake.notify_one();
+      return true;
+   }
+
+   bool WorkStealingPool::runOnce(uint32_t index)
+   {
+      auto& self = *_workers[index];
+      uint32_t task = 0;
+      bool found = self.popFront(task);
+
+      for (size_t offset = 1; !found && (offset < _workers.size()); ++offset)
+      {
+         found = _workers[(index + offset) % _workers.size()]->popBack(task);
+         if (found)
+         {
+            self.stolen.fetch_add(1, std::memory_order_relaxed);
+         }
+      }
+
+      if (!found)
+      {
+         std::unique_lock<std::mutex> guard(_idleLock);
+         _wake.wait_for(guard, std::chrono::milliseconds(IDLE_WAIT_MS), [this, &self]()
+         {
+            return (_pending.load(std::memory_order_acquire) > 0) || !self.thread.running();
+         });
+         return true;
+      }
+
+      _pending.fetch_sub(1, std::memory_order_acq_rel);
+      _handler(task, index);
+      self.executed.fetch_add(1, std::memory_order_relaxed);
+      return true;
+   }
+
+   void WorkStealingPool::stop()
+   {
+      for (auto& worker : _workers)
+      {
+         worker->thread.stop();
+      }
+      _wake.notify_all();
+
+      for (auto& worker : _workers)
+      {
+         worker->thread.join();
+      }
+
+      _workers.clear();
+      _pending.store(0, std::memory_order_relaxed);
+   }
+}
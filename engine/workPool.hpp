@@ -0,0 +1,74 @@
+/*
+ *  A fixed set of worker threads with one bounded task queue each and work stealing.
+ *  A task is a small integer (e.g. a stream index) handed to one handler, so nothing is allocated after start();
+ *  submit() spreads the tasks round robin and an idle worker takes the oldest task of its own queue or steals
+ *  the newest one of another, so a worker stuck in a long render doesn't hold back the tasks queued behind it.
+ */
+
+#pragma once
+
+#include "rtThread.hpp"
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace audio
+{
+   class WorkStealingPool
+   {
+   public:
+      /* called on a worker thread for every submitted task */
+      using TaskFn = std::function<void(uint32_t task, uint32_t worker)>;
+
+      WorkStealingPool() = default;
+      ~WorkStealingPool();
+
+      WorkStealingPool(const WorkStealingPool&) = delete;
+      WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+      /* starts the workers, every queue holds up to capacity tasks; returns 0 or -EINVAL */
+      int start(uint32_t workers, size_t capacity, const RtSettings& settings, TaskFn handler);
+
+      /* queues a task from any thread, returns false when the queue of the chosen worker is full */
+      bool submit(uint32_t task);
+
+      /* lets the workers finish their current task and joins them, queued tasks are dropped */
+      void stop();
+
+      uint32_t workerCount() const { return static_cast<uint32_t>(_workers.size()); }
+      uint64_t executed(uint32_t worker) const { return _workers[worker]->executed.load(std::memory_order_relaxed); }
+      uint64_t stolen(uint32_t worker) const { return _workers[worker]->stolen.load(std::memory_order_relaxed); }
+
+   private:
+      struct Worker
+      {
+         explicit Worker(size_t capacity) : tasks(capacity) {}
+
+         bool push(uint32_t task);
+         bool popFront(uint32_t& task);   /* the owner takes the oldest task */
+         bool popBack(uint32_t& task);    /* a thief takes the newest one */
+
+         std::mutex            lock;
+         std::vector<uint32_t> tasks;      /* ring of queued tasks */
+         size_t                head = 0;
+         size_t                count = 0;
+         RenderThread          thread {};
+         std::atomic<uint64_t> executed { 0 };
+         std::atomic<uint64_t> stolen { 0 };
+      };
+
+      bool runOnce(uint32_t index);
+
+      std::vector<std::unique_ptr<Worker>> _workers {};
+      TaskFn                _handler {};
+      std::atomic<uint32_t> _next { 0 };      /* round robin target of submit() */
+      std::atomic<size_t>   _pending { 0 };
+      std::mutex            _idleLock;
+      std::condition_variable _wake;
+   };
+}
@@ -2,10 +2,9 @@
  *   This small demo presents a 10 second 1000 Hz mono sine generation sampled at 48 kHz
  */
 
-#include <alsa/asoundlib.h>
+#include "engine/pcmOutput.hpp"
 #include <math.h>
 #include <limits.h>
-#include <arpa/inet.h>
 #include <iterator>
 #include <algorithm>
 
@@ -17,22 +16,10 @@ const double _sineFrequency = 1000.0;
 const double _PI = 3.14159265;
 const unsigned int _simulationDurSec = 10;
 
-bool runningOnLittleEndianHost()
-{
-   return htonl(23) != 23;
-}
-
-template <typename TVal, size_t size>
-void convToBigEndian(TVal (&buff)[size])
-{
-   std::for_each(std::begin(buff), std::end(buff), [](uint16_t& i) { i = htons(i); });
-}
-
 int main(void)
 {
-   int err;
    unsigned int i;
-   snd_pcm_t *handle;
+   audio::PcmOutput output;
    snd_pcm_sframes_t frames;
 
    // putting a 1 kHz sine wave (sampling rate 48 kHz) in to the buffer
@@ -47,51 +34,36 @@ int main(void)
       _buffer[a] = *reinterpret_cast<uint16_t*>(&tempVal);
    }
 
-   if ((err = snd_pcm_open(&handle, device, SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
-      printf("Playback open error: %s\n", snd_strerror(err));
-      exit(EXIT_FAILURE);
-   }
+   audio::PcmFormat format {};
+   format.device = device;
+   format.format = SND_PCM_FORMAT_S16;      /* generated in the host byte order */
+   format.channels = 1;
+   format.sampleRate = 48000;
+   format.config = audio::presets::THROUGHPUT;
 
-   if ((err = snd_pcm_set_params(handle,
-                     SND_PCM_FORMAT_S16_BE,
-                     SND_PCM_ACCESS_RW_INTERLEAVED,
-                     1,
-                     48000,
-                     1,
-                     5000000)) < 0) {   /* 0.5sec */
-      printf("Playback open error: %s\n", snd_strerror(err));
+   if (output.open(format) < 0)
+   {
       exit(EXIT_FAILURE);
    }
 
-   if(runningOnLittleEndianHost())
-   {
-      convToBigEndian(_buffer);
-   }
+   audio::printNegotiated(format.device, output.negotiated());
+
+   // only swaps when the device can't take the host byte order
+   output.toDeviceOrder(_buffer, sizeof(_buffer)/sizeof(short));
 
    for (i = 0; i < _simulationDurSec; i++)
    {
-      frames = snd_pcm_writei(handle, _buffer, sizeof(_buffer)/sizeof(short));
+      frames = output.write(_buffer, sizeof(_buffer)/sizeof(short));
 
       if (frames < 0)
-         frames = snd_pcm_recover(handle, frames, 0);
-      if (frames < 0) {
-         printf("snd_pcm_writei failed: %s\n", snd_strerror(frames));
-         break;
-      }
-      if (frames > 0 && frames < (long)sizeof(_buffer)/sizeof(short))
       {
-         printf("Short write (expected %li, wrote %li)\n", (long)sizeof(_buffer), frames);
-      }
-      else
-      {
-         printf("ALL GOOD wrote %li frames.\n", frames);
+         break;
       }
+
+      printf("ALL GOOD wrote %li frames.\n", frames);
    }
 
     /* pass the remaining samples, otherwise they're dropped in close */
-    err = snd_pcm_drain(handle);
-    if (err < 0)
-        printf("snd_pcm_drain failed: %s\n", snd_strerror(err));
-    snd_pcm_close(handle);
+    output.drain();
     return 0;
 }
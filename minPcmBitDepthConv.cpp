@@ -3,16 +3,17 @@
  *   Furthermore it shows how one can tackle the problem of bit resolution change from 24 bit to 16 bit
  */
 
-#include <alsa/asoundlib.h>
+#include "engine/pcmOutput.hpp"
+#include "engine/bitDepthConv.hpp"
 #include <math.h>
 #include <limits.h>
-#include <arpa/inet.h>
 #include <iterator>
 #include <algorithm>
 
 const char *device = "default";            /* playback device */
 
-uint16_t _buffer[48*1000];
+int32_t _source24[48*1000];               /* one second of the 24 bit source material */
+uint16_t _buffer[48*1000];                 /* the same second truncated to 16 bit - only used with writei access */
 
 const double _samplingRate = 48000.0;
 const double _sineFrequency = 1000.0;
@@ -20,43 +21,36 @@ const double _PI = 3.14159265;
 const unsigned int _simulationDurSec = 20;
 const int32_t INT24_MAX = 8388607;
 
-int16_t getTruncatedSample(const int32_t audioSample24bit)
+/* rounds the 24 bit samples to 16 bit, saturates them and damps them by 1dB to avoid clipping - a whole batch at once */
+audio::BitDepthConverter makeConverter()
 {
-   auto res = audioSample24bit;
+   audio::ConversionOptions options {};
+   options.gainDb = -1.0;
 
-   res = ((res + 128) >> 8);
-
-   if(res < INT16_MIN)
-   {
-      res = INT16_MIN;
-   }
-   else if(res > INT16_MAX)
-   {
-      res = INT16_MAX;
-   }
-
-   // damping by 1dB to avoid clipping
-   res = (res * 29204) / 32768;
-
-   return (int16_t) res;
+   return audio::BitDepthConverter(SND_PCM_FORMAT_S24, SND_PCM_FORMAT_S16, 1, options);
 }
 
-bool runningOnLittleEndianHost()
+/* converts the 24 bit source directly into the area handed out by the engine (the DMA area with mmap access) */
+void convertInto(audio::BitDepthConverter& converter, int16_t* area, snd_pcm_uframes_t frames, size_t& srcPos)
 {
-   return htonl(23) != 23;
-}
+   const size_t srcSize = sizeof(_source24)/sizeof(_source24[0]);
 
-template <typename TVal, size_t size>
-void convToBigEndian(TVal (&buff)[size])
-{
-   std::for_each(std::begin(buff), std::end(buff), [](uint16_t& i) { i = htons(i); });
+   while (frames > 0)
+   {
+      const auto chunk = std::min<size_t>(frames, srcSize - srcPos);
+
+      converter.process(_source24 + srcPos, area, chunk);
+
+      area += chunk;
+      frames -= chunk;
+      srcPos = (srcPos + chunk == srcSize) ? 0 : srcPos + chunk;
+   }
 }
 
-int main(void)
+int main(int argc, char* argv[])
 {
-    int err;
     unsigned int i;
-    snd_pcm_t *handle;
+    audio::PcmOutput output;
     snd_pcm_sframes_t frames;
 
     // putting a 1 kHz sine wave (sampling rate 48 kHz) in to the buffer
@@ -67,54 +61,64 @@ int main(void)
     {
         probedFreq = a * angleIncrement;
         amplitudeVal = sin(probedFreq);
-        _buffer[a] = (short) getTruncatedSample(INT24_MAX * amplitudeVal);
+        _source24[a] = INT24_MAX * amplitudeVal;
     }
 
-    if ((err = snd_pcm_open(&handle, device, SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
-        printf("Playback open error: %s\n", snd_strerror(err));
-        exit(EXIT_FAILURE);
+    audio::PcmFormat format {};
+    format.device = device;
+    format.format = SND_PCM_FORMAT_S16;      /* generated in the host byte order */
+    format.channels = 1;
+    format.sampleRate = 48000;
+    format.config = audio::presets::THROUGHPUT;
+
+    // "mmap" converts straight into the ring buffer of the device, writei stays the fallback
+    if ((argc > 1) && (strcmp(argv[1], "mmap") == 0))
+    {
+        format.access = SND_PCM_ACCESS_MMAP_INTERLEAVED;
     }
 
-    if ((err = snd_pcm_set_params(handle,
-                      SND_PCM_FORMAT_S16_BE,
-                      SND_PCM_ACCESS_RW_INTERLEAVED,
-                      1,
-                      48000,
-                      1,
-                      5000000)) < 0) {   /* 0.5sec */
-        printf("Playback open error: %s\n", snd_strerror(err));
+    if (output.open(format) < 0)
+    {
         exit(EXIT_FAILURE);
     }
 
-   if(runningOnLittleEndianHost())
+    audio::printNegotiated(format.device, output.negotiated());
+
+   const snd_pcm_uframes_t secondFrames = sizeof(_buffer)/sizeof(short);
+   size_t srcPos = 0;
+   auto converter = makeConverter();
+
+   if (!output.usesMmap())
    {
-      convToBigEndian(_buffer);
+      converter.process(_source24, _buffer, secondFrames);
+
+      // only swaps when the device can't take the host byte order
+      output.toDeviceOrder(_buffer, secondFrames);
    }
 
    for (i = 0; i < _simulationDurSec; i++)
    {
-      frames = snd_pcm_writei(handle, _buffer, sizeof(_buffer)/sizeof(short));
-
-      if (frames < 0)
-         frames = snd_pcm_recover(handle, frames, 0);
-      if (frames < 0) {
-         printf("snd_pcm_writei failed: %s\n", snd_strerror(frames));
-         break;
-      }
-      if (frames > 0 && frames < (long)sizeof(_buffer)/sizeof(short))
+      if (output.usesMmap())
       {
-         printf("Short write (expected %li, wrote %li)\n", (long)sizeof(_buffer), frames);
+         frames = output.render(secondFrames, [&converter, &srcPos](void* area, snd_pcm_uframes_t count)
+         {
+            convertInto(converter, static_cast<int16_t*>(area), count, srcPos);
+         });
       }
       else
       {
-         printf("ALL GOOD wrote %li frames.\n", frames);
+         frames = output.write(_buffer, secondFrames);
       }
+
+      if (frames < 0)
+      {
+         break;
+      }
+
+      printf("ALL GOOD wrote %li frames.\n", frames);
    }
 
     /* pass the remaining samples, otherwise they're dropped in close */
-    err = snd_pcm_drain(handle);
-    if (err < 0)
-        printf("snd_pcm_drain failed: %s\n", snd_strerror(err));
-    snd_pcm_close(handle);
+    output.drain();
     return 0;
 }
@@ -0,0 +1,113 @@
+/*
+ *  This small demo plays speaker identification tones on a multichannel device, each speaker its own pitch:
+ *     minPcmChannels.out 7.1                     - the speakers sound one after the other, a second each
+ *     minPcmChannels.out 5.1 all                 - all the tones at once
+ *     minPcmChannels.out 7.1 render=ident.wav    - renders the 8 channel file instead
+ *  The layout is requested through the channel map of the device; when it plays the speakers in another
+ *  order the channels are permuted in the interleaver, the tones are rendered in one pass either way.
+ */
+
+#include "engine/pcmOutput.hpp"
+#include "engine/channelMap.hpp"
+#include "engine/audioSource.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <vector>
+
+const double   TONE_AMPLITUDE = 0.5;
+const double   LFE_FREQ = 55.0;           /* the subwoofer only gets a low tone */
+const double   FIRST_TONE_FREQ = 440.0;   /* the other speakers a whole tone apart from here on */
+const uint32_t PLAYBACK_TIME_SEC = 16;
+
+int main(int argc, char* argv[])
+{
+   audio::PcmOutput output;
+   const audio::ChannelLayout* layout = &audio::layouts::SURROUND_51;
+   bool walk = true;
+
+   audio::PcmFormat format {};
+   format.format = SND_PCM_FORMAT_S16;      /* generated in the host byte order */
+   format.pacing = audio::Pacing::DeviceClock;
+
+   for (int a = 1; a < argc; ++a)
+   {
+      if (strcmp(argv[a], "all") == 0)
+         walk = false;
+      else if (strncmp(argv[a], "render=", 7) == 0)
+         format.renderFile = argv[a] + 7;
+      else if (strncmp(argv[a], "device=", 7) == 0)
+         format.device = argv[a] + 7;
+      else if ((layout = audio::findLayout(argv[a])) == nullptr)
+      {
+         printf("usage: %s [stereo|quad|5.1|7.1] [all] [render=out.wav] [device=name]\n", argv[0]);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   format.channels = layout->channels;
+   if (output.open(format) < 0)
+   {
+      exit(EXIT_FAILURE);
+   }
+
+   audio::printNegotiated(format.device, output.negotiated());
+
+   audio::ChannelRoute route;
+   if (audio::applyChannelMap(output.handle(), *layout, route) < 0)
+   {
+      exit(EXIT_FAILURE);
+   }
+   audio::printRoute(*layout, route);
+
+   // one tone per speaker - a source could just as well feed a group of them (e.g. { SND_CHMAP_RL, SND_CHMAP_RR })
+   audio::ChannelRouter router(*layout, format.format);
+   std::vector<std::unique_ptr<audio::OscillatorSource>> tones;
+   double freq = FIRST_TONE_FREQ;
+
+   for (uint32_t c = 0; c < layout->channels; ++c)
+   {
+      const auto position = layout->positions[c];
+      const double toneFreq = (position == SND_CHMAP_LFE) ? LFE_FREQ : freq;
+      freq *= (position == SND_CHMAP_LFE) ? 1.0 : 1.122462048309373; /* a whole tone up */
+
+      tones.emplace_back(new audio::OscillatorSource(toneFreq, format.sampleRate, TONE_AMPLITUDE));
+      router.assign({ position }, tones.back().get(), (walk && (c > 0)) ? 0.0f : 1.0f);
+      printf("%s: %.0f Hz\n", snd_pcm_chmap_name(static_cast<snd_pcm_chmap_position>(position)), toneFreq);
+   }
+   router.setRoute(route);
+
+   const auto period = output.negotiated().periodFrames;
+   uint64_t written = 0;
+   uint32_t speaker = 0;
+
+   while (written < static_cast<uint64_t>(PLAYBACK_TIME_SEC) * format.sampleRate)
+   {
+      auto frames = output.render(period, [&](void* area, snd_pcm_uframes_t count)
+      {
+         router.render(area, count);
+      });
+
+      if (frames < 0)
+      {
+         break;
+      }
+
+      // the next speaker takes over every second - only gains change, the sources keep running
+      written += frames;
+      if (walk && ((written / format.sampleRate) != ((written - frames) / format.sampleRate)))
+      {
+         router.setGain(layout->positions[speaker], 0.0f);
+         speaker = (speaker + 1) % layout->channels;
+         router.setGain(layout->positions[speaker], 1.0f);
+      }
+
+      if (output.waitForPeriod() < 0)
+      {
+         break;
+      }
+   }
+
+   output.drain();
+   return 0;
+}
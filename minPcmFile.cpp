@@ -0,0 +1,154 @@
+/*
+ *  This small demo plays a WAV or raw PCM file of any size without reading it into RAM:
+ *     minPcmFile.out capture.wav [mmap]
+ *     minPcmFile.out capture.raw S24_3LE 48000 2 [mmap]
+ *  The file is memory mapped and handed to snd_pcm_writei without a copy when the device takes its format,
+ *  otherwise (and with "mmap" access) the periods are copied or converted straight into the device buffer.
+ */
+
+#include "engine/pcmOutput.hpp"
+#include "engine/fileSource.hpp"
+#include "engine/framePool.hpp"
+#include "engine/bitDepthConv.hpp"
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+
+const char *_device = "default";            /* playback device */
+
+int main(int argc, char* argv[])
+{
+   if (argc < 2)
+   {
+      printf("usage: %s <file.wav> [mmap] | %s <file.raw> <format> <rate> <channels> [mmap]\n", argv[0], argv[0]);
+      exit(EXIT_FAILURE);
+   }
+
+   audio::FileSource source;
+   int err;
+   int nextArg = 2;
+
+   if ((argc >= 5) && (snd_pcm_format_value(argv[2]) != SND_PCM_FORMAT_UNKNOWN))
+   {
+      audio::FileInfo info {};
+      info.format = snd_pcm_format_value(argv[2]);
+      info.sampleRate = static_cast<uint32_t>(atoi(argv[3]));
+      info.channels = static_cast<uint32_t>(atoi(argv[4]));
+      err = source.openRaw(argv[1], info);
+      nextArg = 5;
+   }
+   else
+   {
+      err = source.openWav(argv[1]);
+   }
+
+   if (err < 0)
+   {
+      exit(EXIT_FAILURE);
+   }
+
+   const auto& info = source.info();
+   printf("%s: %s, %u Hz, %u channels, %zu frames\n", argv[1], snd_pcm_format_name(info.format), info.sampleRate, info.channels, info.frames);
+
+   audio::PcmOutput output;
+   audio::PcmFormat format {};
+   format.device = _device;
+   format.format = info.format;
+   format.channels = info.channels;
+   format.sampleRate = info.sampleRate;
+   format.config = audio::presets::THROUGHPUT;
+
+   if ((argc > nextArg) && (strcmp(argv[nextArg], "mmap") == 0))
+   {
+      format.access = SND_PCM_ACCESS_MMAP_INTERLEAVED;
+   }
+
+   // the file format is preferred, only when the device refuses it one of the formats the converter
+   // produces is tried - a native FLOAT device can't be fed, the converter has no FLOAT output
+   if (output.open(format) < 0)
+   {
+      const snd_pcm_format_t FALLBACK_FORMATS[] { SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S24, SND_PCM_FORMAT_S16 };
+      bool opened = false;
+
+      for (auto fallback : FALLBACK_FORMATS)
+      {
+         if ((fallback != info.format) && audio::BitDepthConverter::supportedOutput(fallback))
+         {
+            format.format = fallback;
+            if ((opened = (output.open(format) == 0)))
+            {
+               break;
+            }
+         }
+      }
+
+      if (!opened)
+      {
+         printf("%s takes neither %s nor one of S32, S24, S16 the file can be converted to\n", format.device, snd_pcm_format_name(info.format));
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   audio::printNegotiated(format.device, output.negotiated());
+
+   if (source.setOutputFormat(format.format) < 0)
+   {
+      exit(EXIT_FAILURE);
+   }
+
+   const snd_pcm_uframes_t periodFrames = output.negotiated().periodFrames;
+   const bool zeroCopy = !output.usesMmap() && !source.needsConversion() && !output.needsByteSwap();
+
+   // the staging buffer for the converted / swapped writei case
+   audio::FramePool pool(1, periodFrames, output.frameBytes());
+   auto staging = pool.acquire();
+
+   size_t nextReport = info.sampleRate;
+   snd_pcm_sframes_t frames = 0;
+
+   while (source.remaining() > 0)
+   {
+      if (output.usesMmap())
+      {
+         // render() commits the whole area, the frames past the end of the file are silenced
+         const auto frameBytes = output.frameBytes();
+         frames = output.render(std::min<size_t>(periodFrames, source.remaining()), [&](void* area, snd_pcm_uframes_t count)
+         {
+            const auto got = source.readInto(area, count);
+            memset(static_cast<uint8_t*>(area) + (got * frameBytes), 0, (count - got) * frameBytes);
+         });
+      }
+      else if (zeroCopy)
+      {
+         size_t count = periodFrames;
+         const void* data = source.peek(count);
+
+         frames = output.write(data, count);
+         if (frames > 0)
+         {
+            source.advance(frames);
+         }
+      }
+      else
+      {
+         const auto count = source.readInto(staging.data(), periodFrames);
+         output.toDeviceOrder(staging.data(), count);
+         frames = output.write(staging.data(), count);
+      }
+
+      if (frames < 0)
+      {
+         break;
+      }
+
+      if (source.position() >= nextReport)
+      {
+         printf("Played %zu of %zu frames.\n", source.position(), info.frames);
+         nextReport += info.sampleRate;
+      }
+   }
+
+   /* pass the remaining samples, otherwise they're dropped in close */
+   output.drain();
+   return 0;
+}
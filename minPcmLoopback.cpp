@@ -0,0 +1,89 @@
+/*
+ *  This small demo measures the real round-trip latency of a playback and a capture device looped together
+ *  (a cable from the line out to the line in, or the snd-aloop Loopback card):
+ *     minPcmLoopback.out hw:0,0 hw:0,0                         - every buffer preset with a noise burst probe
+ *     minPcmLoopback.out hw:Loopback,0 hw:Loopback,1 low-latency impulse
+ *  The capture is linked to the playback so both start together, the captured probes are cross-correlated and
+ *  the measured round trip and its jitter are printed next to the latency the buffer configuration claims.
+ */
+
+#include "engine/latencyProbe.hpp"
+#include <string.h>
+#include <vector>
+
+const uint32_t SAMPLE_RATE = 48000;        /* sampling rate in Hz */
+const uint32_t CHANNELS = 2;
+
+int main(int argc, char* argv[])
+{
+   if (argc < 3)
+   {
+      printf("usage: %s <playback device> <capture device> [preset ...] [impulse|noise|sine]\n", argv[0]);
+      return 0;
+   }
+
+   audio::ProbeSettings settings {};
+   std::vector<audio::PcmConfig> configs;
+
+   for (int a = 3; a < argc; ++a)
+   {
+      if (strcmp(argv[a], "impulse") == 0)
+         settings.signal = audio::ProbeSignal::Impulse;
+      else if (strcmp(argv[a], "noise") == 0)
+         settings.signal = audio::ProbeSignal::Noise;
+      else if (strcmp(argv[a], "sine") == 0)
+         settings.signal = audio::ProbeSignal::Sine;
+      else if (auto preset = audio::findPreset(argv[a]))
+         configs.push_back(*preset);
+      else
+      {
+         printf("Unknown argument: %s\n", argv[a]);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   if (configs.empty())
+   {
+      configs = { audio::presets::LOW_LATENCY, audio::presets::BALANCED, audio::presets::THROUGHPUT };
+   }
+
+   for (const auto& config : configs)
+   {
+      audio::PcmFormat format {};
+      format.device = argv[1];
+      format.format = SND_PCM_FORMAT_S16;      /* generated in the host byte order */
+      format.channels = CHANNELS;
+      format.sampleRate = SAMPLE_RATE;
+      format.config = config;
+
+      audio::PcmOutput playback;
+      audio::PcmCapture capture;
+
+      if (playback.open(format) < 0)
+      {
+         printf("Skipping %s - the playback device can't be opened\n", config.name);
+         continue;
+      }
+
+      format.device = argv[2];
+      if (capture.open(format) < 0)
+      {
+         printf("Skipping %s - the capture device can't be opened\n", config.name);
+         continue;
+      }
+
+      audio::printNegotiated(argv[1], playback.negotiated());
+      audio::printNegotiated(argv[2], capture.negotiated());
+
+      audio::ProbeResult result {};
+      if (audio::measureRoundTrip(playback, capture, settings, result) < 0)
+      {
+         printf("Measuring %s failed\n", config.name);
+         continue;
+      }
+
+      audio::printProbeResult(config.name, result);
+   }
+
+   return 0;
+}
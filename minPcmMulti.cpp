@@ -0,0 +1,90 @@
+/*
+ *  This small demo plays one 1000 Hz stereo sine on several devices at once for 30 seconds:
+ *     minPcmMulti.out list                                  - prints the playback devices
+ *     minPcmMulti.out hw:0,3 hw:1,0@low-latency plughw:Loopback
+ *  The sine is rendered once - every device gets its own ring and writer thread, a device name may pick
+ *  its ring buffer preset after an '@'. A device that stalls only drops its own blocks.
+ */
+
+#include "engine/multiOutput.hpp"
+#include "engine/deviceList.hpp"
+#include "engine/oscillator.hpp"
+#include "engine/dspChain.hpp"
+#include <string.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+const uint32_t SAMPLE_RATE = 48000;        /* sampling rate in Hz */
+const uint32_t CHANNELS = 2;
+const double   SINE_FREQUENCY = 1000.0;
+const double   DAMPENING_FACTOR = 0.70794578438413791080221494218931; /* damping by 3dB expressed in doubles */
+const unsigned int PLAYBACK_TIME_SEC = 30;
+
+int main(int argc, char* argv[])
+{
+   if ((argc < 2) || (strcmp(argv[1], "list") == 0))
+   {
+      audio::printDevices(audio::listDevices());
+      printf("usage: %s <device>[@preset] [<device>[@preset] ...]\n", argv[0]);
+      return 0;
+   }
+
+   audio::MultiOutput outputs;
+   std::vector<std::string> names;
+   names.reserve(argc);   // PcmFormat keeps pointers to the names
+
+   for (int a = 1; a < argc; ++a)
+   {
+      audio::PcmFormat format {};
+      format.format = SND_PCM_FORMAT_S16;      /* generated in the host byte order */
+      format.channels = CHANNELS;
+      format.sampleRate = SAMPLE_RATE;
+      format.pacing = audio::Pacing::DeviceClock;
+
+      std::string arg = argv[a];
+      auto at = arg.find('@');
+      names.push_back(arg.substr(0, at));
+
+      if (at != std::string::npos)
+      {
+         auto preset = audio::findPreset(arg.c_str() + at + 1);
+         if (preset == nullptr)
+         {
+            printf("Unknown buffer preset: %s\n", arg.c_str() + at + 1);
+            exit(EXIT_FAILURE);
+         }
+         format.config = *preset;
+      }
+
+      format.device = names.back().c_str();
+      if (outputs.addDevice(format) < 0)
+      {
+         printf("Skipping %s\n", format.device);
+      }
+   }
+
+   // full scale sine -> dampening -> s16 duplicated to both channels, fused into a single pass per block
+   audio::WavetableOscillator oscillator(SINE_FREQUENCY, SAMPLE_RATE);
+   auto chain = audio::makeDspChain<1, CHANNELS, int16_t>(audio::dsp::GainNode(DAMPENING_FACTOR));
+
+   outputs.stopAfter(static_cast<uint64_t>(PLAYBACK_TIME_SEC) * SAMPLE_RATE);
+   if (outputs.start([&oscillator, &chain](void* out, size_t frames)
+       {
+          chain.process([&oscillator](float* block, size_t count) { oscillator.render(block, count); },
+                        static_cast<int16_t*>(out), frames);
+       }) < 0)
+   {
+      exit(EXIT_FAILURE);
+   }
+
+   while (!outputs.finished())
+   {
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+      outputs.printReport();
+   }
+
+   outputs.stop();
+   return 0;
+}
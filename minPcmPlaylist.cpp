@@ -0,0 +1,145 @@
+/*
+ *  This small demo plays WAV files back to back on one open device - gapless, or crossfaded at an exact frame:
+ *     minPcmPlaylist.out a.wav b.wav c.wav                 - every clip starts on the frame after the last one
+ *     minPcmPlaylist.out fade=500 a.wav b.wav              - 500 ms equal power crossfades
+ *     minPcmPlaylist.out at=2.5 alert.wav render=out.wav   - the first clip starts 2.5 s from now
+ *  The clips are queued as commands of a SourceScheduler, which switches (or fades) inside a period at the
+ *  scheduled frame; the device is neither reopened nor drained between them and never runs empty.
+ */
+
+#include "engine/pcmOutput.hpp"
+#include "engine/sourceScheduler.hpp"
+#include "engine/fileSource.hpp"
+#include "engine/simdKernels.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <memory>
+
+const uint32_t CHANNELS = 2;
+
+int main(int argc, char* argv[])
+{
+   audio::PcmOutput output;
+   std::vector<std::unique_ptr<audio::FileSource>> clips;
+   double fadeMs = 0.0;
+   double startInSec = 0.0;
+
+   audio::PcmFormat format {};
+   format.format = SND_PCM_FORMAT_S16;      /* generated in the host byte order */
+   format.channels = CHANNELS;
+   format.pacing = audio::Pacing::DeviceClock;
+
+   for (int a = 1; a < argc; ++a)
+   {
+      if (strncmp(argv[a], "fade=", 5) == 0)
+         fadeMs = atof(argv[a] + 5);
+      else if (strncmp(argv[a], "at=", 3) == 0)
+         startInSec = atof(argv[a] + 3);
+      else if (strncmp(argv[a], "render=", 7) == 0)
+         format.renderFile = argv[a] + 7;
+      else if (strncmp(argv[a], "device=", 7) == 0)
+         format.device = argv[a] + 7;
+      else
+      {
+         clips.emplace_back(new audio::FileSource());
+         if ((clips.back()->openWav(argv[a]) < 0) ||
+             ((clips.size() > 1) && (clips.back()->info().sampleRate != clips.front()->info().sampleRate)))
+         {
+            printf("Skipping %s - all the clips need the sample rate of the first one\n", argv[a]);
+            clips.pop_back();
+         }
+      }
+   }
+
+   if (clips.empty())
+   {
+      printf("usage: %s [fade=ms] [at=seconds] [render=out.wav] [device=name] clip.wav ...\n", argv[0]);
+      return 0;
+   }
+
+   format.sampleRate = clips.front()->info().sampleRate;
+   if (output.open(format) < 0)
+   {
+      exit(EXIT_FAILURE);
+   }
+
+   audio::printNegotiated(format.device, output.negotiated());
+
+   const auto period = output.negotiated().periodFrames;
+   const auto fadeFrames = static_cast<uint32_t>((fadeMs * format.sampleRate) / 1000.0);
+   audio::SourceScheduler scheduler(CHANNELS, period);
+   std::vector<float> block(period * CHANNELS);
+
+   // the frame the device plays at the requested wall clock time
+   uint64_t nextStart = 0;
+   if (output.framePosition(audio::monotonicMicros() + static_cast<uint64_t>(startInSec * 1e6), nextStart) < 0)
+   {
+      exit(EXIT_FAILURE);
+   }
+
+   size_t queued = 0;
+   uint64_t lastReport = 0;
+
+   while ((queued < clips.size()) || !scheduler.idle())
+   {
+      // the queue is short - the clips are handed over as it frees up
+      while (queued < clips.size())
+      {
+         const auto& clip = *clips[queued];
+         uint64_t startFrame = nextStart;
+         uint32_t fade = 0;
+
+         if (queued > 0)
+         {
+            // a crossfade starts exactly fadeFrames before the end of the previous clip, otherwise it follows gapless
+            fade = std::min<uint64_t>(fadeFrames, clips[queued - 1]->info().frames);
+            startFrame = (fade > 0) ? nextStart - fade : audio::SourceScheduler::AFTER_CURRENT;
+         }
+
+         if (!scheduler.schedule(clips[queued].get(), startFrame, fade))
+         {
+            break;
+         }
+
+         nextStart = ((startFrame == audio::SourceScheduler::AFTER_CURRENT) ? nextStart : startFrame) + clip.info().frames;
+         printf("Clip %zu: %zu frames, starts at %s%llu\n", queued, clip.info().frames,
+                (startFrame == audio::SourceScheduler::AFTER_CURRENT) ? "the end of the previous one ~" : "",
+                static_cast<unsigned long long>(nextStart - clip.info().frames));
+         ++queued;
+      }
+
+      while (scheduler.retired() != nullptr)
+      {
+         // the clips are owned by the vector, nothing to free
+      }
+
+      auto frames = output.render(period, [&](void* area, snd_pcm_uframes_t count)
+      {
+         scheduler.render(block.data(), count, CHANNELS);
+         audio::kernels::floatToS16(block.data(), static_cast<int16_t*>(area), count * CHANNELS, 32768.0f);
+      });
+
+      if (frames < 0)
+      {
+         break;
+      }
+
+      if (scheduler.position() >= lastReport + format.sampleRate)
+      {
+         lastReport = scheduler.position();
+         printf("Frame %llu, late starts %llu | ", static_cast<unsigned long long>(lastReport),
+                static_cast<unsigned long long>(scheduler.lateStarts()));
+         audio::printStats(output.stats());
+      }
+
+      // the next period is written as soon as the device has room for it
+      if (output.waitForPeriod() < 0)
+      {
+         break;
+      }
+   }
+
+   output.drain();
+   return 0;
+}
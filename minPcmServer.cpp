@@ -0,0 +1,140 @@
+/*
+ *  This small demo plays many sine streams at once from a single process, 10 seconds each:
+ *     minPcmServer.out                       - 32 streams on the ALSA "null" device (paced like a sound card)
+ *     minPcmServer.out 8 dmix                - 8 streams mixed by dmix
+ *     minPcmServer.out 32 null render=/tmp/s - offline, every stream goes to /tmp/s<index>.wav
+ *     minPcmServer.out 32 null shared        - the tones are played from loops in shared memory (signalCache.hpp),
+ *                                              rendered by the first process only - start a few of them at once
+ *  All the streams are non-blocking and share one epoll loop, a small work-stealing pool renders
+ *  whichever stream has room for a period - no thread per stream that sleeps.
+ */
+
+#include "engine/streamServer.hpp"
+#include "engine/oscillator.hpp"
+#include "engine/signalCache.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+
+const uint32_t SAMPLE_RATE = 48000;        /* sampling rate in Hz */
+const uint32_t CHANNELS = 2;
+const uint32_t DEFAULT_STREAMS = 32;
+const uint32_t WORKERS = 4;
+const double   BASE_FREQUENCY = 220.0;     /* stream n plays BASE_FREQUENCY * (1 + n / 8), shared: (1 + (n % 8) / 8) */
+const uint32_t SHARED_TONES = 8;
+const double   AMPLITUDE = 0.2;
+const unsigned int PLAYBACK_TIME_SEC = 10;
+
+int main(int argc, char* argv[])
+{
+   const uint32_t streams = (argc > 1) ? static_cast<uint32_t>(atoi(argv[1])) : DEFAULT_STREAMS;
+   const char* device = (argc > 2) ? argv[2] : "null";
+   const char* renderPrefix = nullptr;
+   bool shared = false;
+
+   for (int a = 3; a < argc; ++a)
+   {
+      if (strncmp(argv[a], "render=", 7) == 0)
+         renderPrefix = argv[a] + 7;
+      else if (strcmp(argv[a], "shared") == 0)
+         shared = true;
+   }
+
+   audio::StreamServerSettings settings {};
+   settings.workers = WORKERS;
+   settings.maxStreams = streams;
+
+   audio::StreamServer server(settings);
+   std::vector<std::unique_ptr<audio::WavetableOscillator>> oscillators;
+   audio::SignalCache signals;
+   std::vector<uint32_t> offsets(streams, 0u);   /* all a stream of a shared loop keeps */
+   std::vector<uint64_t> remaining(streams, static_cast<uint64_t>(PLAYBACK_TIME_SEC) * SAMPLE_RATE);
+   std::vector<std::string> files;
+   files.reserve(streams);   // PcmFormat keeps pointers to the names
+
+   for (uint32_t s = 0; s < streams; ++s)
+   {
+      audio::PcmFormat format {};
+      format.device = device;
+      format.format = SND_PCM_FORMAT_S16;      /* generated in the host byte order */
+      format.channels = CHANNELS;
+      format.sampleRate = SAMPLE_RATE;
+
+      if (renderPrefix != nullptr)
+      {
+         files.push_back(std::string(renderPrefix) + std::to_string(s) + ".wav");
+         format.renderFile = files.back().c_str();
+      }
+
+      auto left = &remaining[s];
+      int res;
+
+      if (shared)
+      {
+         const double frequency = BASE_FREQUENCY * (1.0 + (s % SHARED_TONES) / 8.0);
+         const auto loop = signals.loop(audio::LoopKey::sine(frequency, SAMPLE_RATE, format.format, CHANNELS, AMPLITUDE));
+         if (loop == nullptr)
+         {
+            exit(EXIT_FAILURE);
+         }
+
+         auto offset = &offsets[s];
+         res = server.addStream(format, [loop, offset, left](void* area, snd_pcm_uframes_t frames) -> bool
+         {
+            loop->copy(area, frames, *offset);
+            *left -= std::min<uint64_t>(*left, frames);
+            return *left > 0;
+         });
+      }
+      else
+      {
+         oscillators.emplace_back(new audio::WavetableOscillator(BASE_FREQUENCY * (1.0 + s / 8.0), SAMPLE_RATE, AMPLITUDE));
+         auto oscillator = oscillators.back().get();
+
+         res = server.addStream(format, [oscillator, left](void* area, snd_pcm_uframes_t frames) -> bool
+         {
+            oscillator->renderInterleaved(static_cast<int16_t*>(area), frames, CHANNELS);
+            *left -= std::min<uint64_t>(*left, frames);
+            return *left > 0;
+         });
+      }
+
+      if (res < 0)
+      {
+         printf("Stream %u can't be opened on %s\n", s, device);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   if (shared)
+   {
+      printf("%zu shared loops (%zu KiB mapped), %zu of them rendered by this process\n",
+             signals.loops(), signals.mappedBytes() / 1024, signals.renderedLoops());
+   }
+
+   const auto start = std::chrono::steady_clock::now();
+   if (server.start() < 0)
+   {
+      exit(EXIT_FAILURE);
+   }
+
+   while (!server.finished())
+   {
+      std::this_thread::sleep_for(std::chrono::milliseconds(renderPrefix ? 10 : 1000));
+      if (renderPrefix == nullptr)
+      {
+         server.printReport();
+      }
+   }
+
+   const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+   printf("%u streams of %u s done in %.2f s\n", streams, PLAYBACK_TIME_SEC, elapsed.count());
+
+   server.printReport();
+   server.stop();
+   return 0;
+}
@@ -1,186 +1,160 @@
 /*
- *  This small demo presents a 30 second 1000 Hz stereo sine generation sampled at 48 kHz
- *  The sample delivery rate is configurable by the PROC_SIN_FRAME_SIZE const.
+ *  This small demo presents a 30 second stereo A major chord (440 / 554.37 / 659.26 Hz) sampled at 48 kHz
+ *  The sample delivery rate is the period of the configured preset (1152 frames for "balanced").
+ *  Every note is a wavetable oscillator voice of the mixer, thus any _chordFrequencies can be played.
+ *  The voices, and the WAV files passed as arguments, are rendered and mixed by the worker stages of a pipeline.
+ *  With a "render=out.wav" argument the pipeline renders into the file instead, much faster than realtime.
+ *  A "trace=trace.json" argument writes the trace of the stages (build with "bash buildIt.bash trace") at the end
+ *  and right after every xrun - it opens in chrome://tracing or ui.perfetto.dev.
  */
 
-#include <alsa/asoundlib.h>
-#include <math.h>
+#include "engine/pcmOutput.hpp"
+#include "engine/pipeline.hpp"
+#include "engine/fileSource.hpp"
+#include "engine/trace.hpp"
 #include <limits.h>
+#include <string.h>
 #include <array>
 #include <vector>
+#include <memory>
 #include <algorithm>
+#include <iostream>
+#include <atomic>
 #include <thread>
 #include <chrono>
-#include <iomanip>
-#include <iostream>
-#include <arpa/inet.h>
 
 const char *_device = "default";           /* playback device */
-const size_t BUFFER_SIZE = 48000*2;  /* buffer that fits 1 second of stereo samples - sampling freq = 48 kHz */
-const size_t PROC_SIN_FRAME_SIZE = 1152; /* a single processing frame contains 1152 stereo-samples which is 24 ms when sampling at 48 kHz */
-const size_t PROC_SIN_FRAME_DURATION_MS = 24; /* a single processing contains 24 ms of audio */
+const size_t PIPELINE_DEPTH_PERIODS = 3; /* every stage runs at most 3 periods (72 ms) ahead of the device */
 
-const double DAMPENING_FACTOR = 0.70794578438413791080221494218931; /* damping by 3dB expressed in doubles */
-const int16_t DUMPING_FACTOR_IN_SHORTS = 23198; /* this a part of the sample level damping by 3dB    -3dB = 20*log(23198/32767) */
-
-uint16_t _buffer[BUFFER_SIZE] = {0};
+const double VOICE_GAIN_DB = -3.0; /* every voice is damped by 3dB, the mixer headroom takes care of the sum */
 
 const double _samplingRate = 48000.0;
-const double _sineFrequency = 1000.0;
-const double _PI = 3.14159265;
+const std::array<double, 3> _chordFrequencies { 440.0, 554.37, 659.26 };
 const unsigned int _simulationDurSec = 30;
 
-template<typename T>
-std::string strToInt(T i)
-{
-   std::stringstream stream;
-   stream << i;
-
-   return stream.str();
-}
-
-template <typename TVal, size_t size>
-std::string getCommaSepNumString(TVal (&bytes)[size])
+int main(int argc, char* argv[])
 {
-   std::string res;
-   int i {};
-
-   std::for_each(std::begin(bytes), std::end(bytes), [&res, &i](TVal c) {
-      ++i;
-      res.append(strToInt(c));
-      if(i < size) { res.append(", "); }
-   });
-
-   return res;
-}
-
-bool runningOnLittleEndianHost()
-{
-   return htonl(23) != 23;
-}
-
-template <typename TVal, size_t size>
-void convToBigEndian(TVal (&buff)[size])
-{
-   std::for_each(std::begin(buff), std::end(buff), [](uint16_t& i) { i = htons(i); });
-}
-
-int main(void)
-{
-    int err;
     unsigned int i;
-    snd_pcm_t *handle;
+    audio::PcmOutput output;
     snd_pcm_sframes_t frames;
-
-    int16_t monoSine1kHzLoopUp[48] {}; // contains 1kHz sine - sampled at 48 kHz
-
-    // putting a 1 kHz sine wave (sampling rate 48 kHz) in to the buffer
-    const double angleIncrement = (_sineFrequency/_samplingRate) * 2.0 * _PI;
-    double probedFreq = 0.0;
-    double amplitudeVal = 0.0;
-    for(size_t a = 0,iii = 0; iii < _samplingRate; a=a+2, ++iii)
+    const char* traceFile = nullptr;
+
+    audio::PcmFormat format {};
+    format.device = _device;
+    format.format = SND_PCM_FORMAT_S16;      /* generated in the host byte order */
+    format.channels = 2;
+    format.sampleRate = 48000;
+    format.config = audio::presets::BALANCED;
+    format.pacing = audio::Pacing::DeviceClock;
+
+    // "render=out.wav" renders the same pipeline into a file as fast as possible instead of playing it
+    for (int arg = 1; arg < argc; ++arg)
     {
-      probedFreq = iii * angleIncrement;
-      amplitudeVal = sin(probedFreq);
-      auto tempVal = static_cast<int16_t>(INT16_MAX * (DAMPENING_FACTOR*amplitudeVal));
-
-      if(iii < 48)
-      {
-         monoSine1kHzLoopUp[iii] = tempVal;
-      }
-
-      _buffer[a] = *reinterpret_cast<uint16_t*>(&tempVal);
-      _buffer[a+1] = *reinterpret_cast<uint16_t*>(&tempVal);
+        if (strncmp(argv[arg], "render=", 7) == 0)
+        {
+            format.renderFile = argv[arg] + 7;
+        }
+
+        if (strncmp(argv[arg], "trace=", 6) == 0)
+        {
+            traceFile = argv[arg] + 6;
+        }
     }
 
-    std::cout << "int16_t monoSine1kHzLoopUp[48] { " << getCommaSepNumString(monoSine1kHzLoopUp) << "};" << std::endl;
-
-    if ((err = snd_pcm_open(&handle, _device, SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
-        printf("Playback open error: %s\n", snd_strerror(err));
+    if (output.open(format) < 0)
+    {
         exit(EXIT_FAILURE);
     }
 
-    if ((err = snd_pcm_set_params(handle,
-                      SND_PCM_FORMAT_S16_BE,
-                      SND_PCM_ACCESS_RW_INTERLEAVED,
-                      2,
-                      48000,
-                      1,
-                      5000000)) < 0) {   /* 0.5sec */
-        printf("Playback open error: %s\n", snd_strerror(err));
-        exit(EXIT_FAILURE);
-    }
+    audio::printNegotiated(format.device, output.negotiated());
 
-   if(runningOnLittleEndianHost())
+   const size_t secondFrames = static_cast<size_t>(_samplingRate);
+   const size_t totalFrames = _simulationDurSec * secondFrames;
+
+   // every voice renders on its own worker, the mix stage sums them into the output ring
+   // and this thread (the one owning the PCM handle) only drains the ring into ALSA
+   audio::PipelineSettings pipelineSettings {};
+   pipelineSettings.depthPeriods = PIPELINE_DEPTH_PERIODS;
+   audio::Pipeline pipeline(output, pipelineSettings);
+   std::vector<std::unique_ptr<audio::OscillatorSource>> voices;
+   std::vector<std::unique_ptr<audio::FileSource>> files;
+
+   for (auto frequency : _chordFrequencies)
    {
-      convToBigEndian(_buffer);
+      voices.emplace_back(new audio::OscillatorSource(frequency, static_cast<uint32_t>(_samplingRate)));
+      pipeline.addInput(voices.back().get(), audio::Mixer::dbToGain(VOICE_GAIN_DB));
    }
 
-   auto writeFrameSize = PROC_SIN_FRAME_SIZE; // <-- set how big should the sample chunks be that we send to ALSA
-   std::vector<uint16_t> _tempWriteBuff {};
-   _tempWriteBuff.reserve(writeFrameSize*2);
-   auto buffSampleCount = sizeof(_buffer)/sizeof(uint16_t);
-   uint16_t* currBuffPtr = nullptr;
-   int writePosReminder {0};
-
-   for (i = 0; i < _simulationDurSec; i++)
+   // WAV files given as arguments are streamed from the disk on top of the chord
+   for (int arg = 1; arg < argc; ++arg)
    {
-      int writePos = writePosReminder;
+      if ((strncmp(argv[arg], "render=", 7) == 0) || (strncmp(argv[arg], "trace=", 6) == 0))
+      {
+         continue;
+      }
 
-      for (int j = 0; writePos < buffSampleCount; j++)
+      files.emplace_back(new audio::FileSource());
+      if ((files.back()->openWav(argv[arg]) < 0) || (files.back()->info().sampleRate != format.sampleRate))
       {
-         int nextFramePosEnd = writePos + (writeFrameSize*2);
+         printf("Skipping %s - it has to be a %u Hz WAV file\n", argv[arg], format.sampleRate);
+         continue;
+      }
+      pipeline.addInput(files.back().get(), audio::Mixer::dbToGain(VOICE_GAIN_DB));
+   }
 
-         if(nextFramePosEnd > buffSampleCount)
-         {
-            _tempWriteBuff.clear();
+   pipeline.mixer().setHeadroom(audio::Headroom::Auto);
+   pipeline.mixer().setLimiter(true);
 
-            auto lastBuffSamplesAmount = buffSampleCount - writePos;
+   if (pipeline.start() < 0)
+   {
+      exit(EXIT_FAILURE);
+   }
 
-            std::copy_n(_buffer + writePos, lastBuffSamplesAmount, std::back_inserter(_tempWriteBuff));
+   AUDIO_TRACE_THREAD("pcm writer");
+   size_t consumed = 0;
+   size_t nextReport = secondFrames;
+   i = 0;
 
-            auto firstBuffSamplesAmount = (writeFrameSize*2) - lastBuffSamplesAmount;
+   while ((consumed < totalFrames) && !pipeline.finished())
+   {
+      frames = pipeline.pump(output);
 
-            std::copy_n(_buffer, firstBuffSamplesAmount, std::back_inserter(_tempWriteBuff));
+      if (frames < 0)
+      {
+         break;
+      }
 
-            writePosReminder = firstBuffSamplesAmount;
+      consumed += frames;
 
-            currBuffPtr = _tempWriteBuff.data();
-         }
-         else
-         {
-            currBuffPtr = _buffer + writePos;
-         }
+      if (consumed >= nextReport)
+      {
+         printf("Passed audio-write iterations: %d.\n", ++i);
+         audio::printStats(output.stats());
+         nextReport += secondFrames;
+      }
 
-         frames = snd_pcm_writei(handle, currBuffPtr, writeFrameSize);
+      // the moments before the xrun - the dump takes this writer a few ms, the pipeline rings are deeper than that
+      if ((traceFile != nullptr) && audio::trace::takeXrun())
+      {
+         audio::trace::dumpChromeJson(traceFile);
+      }
 
-         if (frames < 0)
-            frames = snd_pcm_recover(handle, frames, 0);
-         if (frames < 0) {
-            printf("snd_pcm_writei failed: %s\n", snd_strerror(frames));
-            break;
-         }
-         if (frames > 0 && frames < writeFrameSize)
-         {
-            printf("Short write (expected %li, wrote %li)\n", (long)writeFrameSize, frames);
-         }
-         else
-         {
-            //printf("ALL GOOD wrote %li frames.\n", frames);
-         }
+      // the next period is written as soon as the device has room for it - a realistic live-streaming scenario
+      if (output.waitForPeriod() < 0)
+      {
+         break;
+      }
+   }
 
-         writePos += frames*2; //incrementing write position (one frame contains two samples thus x 2 multiplication)
+   pipeline.stop();
+   printf("Periods of silence because the mix stage was late: %zu\n", pipeline.starvedPeriods());
 
-         // adding a thread sleep to make it a more realistic live-streaming scenario
-         std::this_thread::sleep_for (std::chrono::milliseconds(PROC_SIN_FRAME_DURATION_MS));
-      }
-      printf("Passed audio-write iterations: %d.\n", i+1);
+   if (traceFile != nullptr)
+   {
+      audio::trace::dumpChromeJson(traceFile);
    }
 
-    err = snd_pcm_drain(handle);
-    if (err < 0)
-        printf("snd_pcm_drain failed: %s\n", snd_strerror(err));
-    snd_pcm_close(handle);
+    output.drain();
 
     return 0;
 }
@@ -1,20 +1,28 @@
 /*
  *  This small demo presents a 10 second 1000 Hz stereo sine generation sampled at 48 kHz
  *  Presents a more resource efficient way of generating a sine
- *  Example can be usefull in embedded enviorments with limited resources, which are often
- *  compiled using an older C++ standards dissalowing extensive compile-time programming using constexpr
+ *  Example can be usefull in embedded enviorments with limited resources.
+ *  The sine lookup table is generated at compile time from the params below (see engine/sineTable.hpp),
+ *  so there is neither a startup cost nor hand pasted data going stale.
+ *  The device and its negotiated parameters are cached (engine/deviceCache.hpp) for a fast start of the next run,
+ *  the time to the first played sample is reported - "nocache" negotiates from scratch for a comparison.
  */
 
-#include <alsa/asoundlib.h>
+#include "engine/pcmOutput.hpp"
+#include "engine/sampleFormat.hpp"
+#include "engine/rtThread.hpp"
+#include "engine/sineTable.hpp"
+#include "engine/framePool.hpp"
+#include "engine/frameRenderer.hpp"
+#include "engine/deviceList.hpp"
+#include "engine/deviceCache.hpp"
 #include <math.h>
 #include <limits.h>
 #include <array>
-#include <vector>
 #include <algorithm>
+#include <iostream>
 #include <thread>
 #include <chrono>
-#include <iostream>
-#include <arpa/inet.h>
 
 namespace params
 {
@@ -25,8 +33,12 @@ namespace params
    const uint32_t SAMPLES_PER_SINE = SAMPLE_RATE/SINE_FREQ; /* amount of samples of per sine wave of the given frequency */
    const uint32_t PLAYBACK_TIME_SEC = 40;      /* specified the duration of the playback in seconds*/
    const uint32_t PROC_FRAME_SIZE = 1152;      /* a single processing frame contains 1152 stereo-samples which is 24 ms when sampling at 48 kHz */
-   const uint32_t PROC_FRAME_DURATION_MS = 24; /* a single processing contains 24 ms of audio */
+   const uint32_t PROC_FRAME_DURATION_MS = 24; /* a single processing contains 24 ms of audio - paced by the device clock */
    const uint32_t SINES_IN_FRAME = PROC_FRAME_SIZE / SAMPLES_PER_SINE; /* how many sines fit to a single frame - this should be round value*/
+   constexpr double DAMPENING_FACTOR = 0.70794578438413791080221494218931; /* damping by 3dB expressed in doubles */
+   const int      RT_PRIORITY = 80;            /* SCHED_FIFO priority of the render thread, ignored without the rights for it */
+   const int      RT_CPU = -1;                 /* CPU the render thread is pinned to, -1 disables pinning */
+   const uint32_t STATS_REPORT_PERIOD_SEC = 1; /* the main thread prints a stats line this often */
 
    static_assert( SINE_FREQ < SAMPLE_RATE/2 ); /* probed signal frequency should be smaller than half of the sampling frequency (nyquist frequncy) */
 
@@ -34,160 +46,198 @@ namespace params
                                                                        /* Frame size should be a multiple of the sine samples*/
 }
 
-void listdev(char *devname)
+int main(int argc, char* argv[])
 {
-    char** hints;
-    int    err;
-    char** n;
-    char*  name;
-    char*  desc;
-    char*  ioid;
+    const uint64_t startMicros = audio::monotonicMicros();
+    audio::PcmOutput output;
+    snd_pcm_sframes_t frames;
+    bool jsonReport = false;
+    bool useCache = true;
 
-    /* Enumerate sound devices */
-    err = snd_device_name_hint(-1, devname, (void***)&hints);
-    if (err != 0) {
+   // For enviorments with very little memory audio::QuarterSineTable holds only 1/4 of it - 12 samples.
+   constexpr auto monoSine1kHzLoopUp = audio::SineTable<int16_t, params::SAMPLE_RATE, params::SINE_FREQ>::make(params::DAMPENING_FACTOR);
 
-        fprintf(stderr, "*** Cannot get device names\n");
-        exit(1);
+   const auto endianStr = audio::runningOnLittleEndianHost() ? "little endian" : "big endian";
 
+   std::cout << "CPU is using: " << endianStr << std::endl;
+
+    audio::PcmFormat format {};
+    format.device = params::AUD_DEVICE;
+    format.format = SND_PCM_FORMAT_S16;      /* generated in the host byte order */
+    format.channels = params::AUD_CHANNELS;
+    format.sampleRate = params::SAMPLE_RATE;
+    format.config = audio::presets::BALANCED;
+    format.pacing = audio::Pacing::DeviceClock;
+
+    // optionally the ring buffer preset can be picked by name e.g. "low-latency", "balanced" or "throughput"
+    // and "mmap" selects the zero-copy access mode (writei stays the fallback), "json" dumps the stats at the end
+    // and "render=out.wav" renders the whole playback time into a file without any pacing,
+    // "list" prints the playback devices and "device=hw:1,0" picks one of them instead of params::AUD_DEVICE,
+    // "nocache" neither reads nor updates the device cache
+    for (int a = 1; a < argc; ++a)
+    {
+        if (strcmp(argv[a], "mmap") == 0)
+        {
+            format.access = SND_PCM_ACCESS_MMAP_INTERLEAVED;
+            continue;
+        }
+
+        if (strcmp(argv[a], "json") == 0)
+        {
+            jsonReport = true;
+            continue;
+        }
+
+        if (strncmp(argv[a], "render=", 7) == 0)
+        {
+            format.renderFile = argv[a] + 7;
+            continue;
+        }
+
+        if (strncmp(argv[a], "device=", 7) == 0)
+        {
+            format.device = argv[a] + 7;
+            continue;
+        }
+
+        if (strcmp(argv[a], "nocache") == 0)
+        {
+            useCache = false;
+            continue;
+        }
+
+        if (strcmp(argv[a], "list") == 0)
+        {
+            audio::printDevices(audio::listDevices());
+            return 0;
+        }
+
+        auto preset = audio::findPreset(argv[a]);
+        if (preset == nullptr)
+        {
+            printf("Unknown buffer preset: %s\n", argv[a]);
+            exit(EXIT_FAILURE);
+        }
+        format.config = *preset;
     }
-    n = hints;
-    while (*n != NULL) {
-
-        name = snd_device_name_get_hint(*n, "NAME");
-        desc = snd_device_name_get_hint(*n, "DESC");
-        ioid = snd_device_name_get_hint(*n, "IOID");
-
-        printf("Name of device: %s\n", name);
-        printf("Description of device: %s\n", desc);
-        printf("I/O type of device: %s\n", ioid);
-        printf("\n");
-        if (name && strcmp("null", name)) free(name);
-        if (desc && strcmp("null", desc)) free(desc);
-        if (ioid && strcmp("null", ioid)) free(ioid);
-        n++;
 
+    // the devices are only enumerated when asked for ("list") or when neither the requested nor a cached one opens
+    audio::DeviceCache deviceCache;
+    if (useCache && (deviceCache.load() < 0))
+    {
+        printf("Ignoring the unreadable device cache %s\n", deviceCache.path().c_str());
     }
 
-    //Free hint buffer too
-    snd_device_name_free_hint((void**)hints);
-}
+    if ((useCache ? output.open(format, deviceCache) : output.open(format)) < 0)
+    {
+        exit(EXIT_FAILURE);
+    }
 
-bool runningOnLittleEndianHost()
-{
-   return htonl(23) != 23;
-}
+    const uint64_t openMicros = audio::monotonicMicros();
+    audio::printNegotiated(output.format().device, output.negotiated());
 
-template <size_t size>
-std::vector<uint16_t> fillBuffer(int16_t (&monoSigBuff)[size], std::vector<uint16_t>& buf)
-{
-   for (uint32_t i = 0u; i < params::SINES_IN_FRAME; i++)
+   // the write loop specialized for the negotiated format (its byte order included), the channels and the frame size
+   const auto renderer = audio::frameRendererFor(output.negotiated().format, params::AUD_CHANNELS, params::PROC_FRAME_SIZE);
+   if (!renderer.isValid())
    {
-      std::for_each(std::begin(monoSigBuff), std::end(monoSigBuff), [&buf](int16_t& s)
-      {
-         for(auto o = 0u; o < params::AUD_CHANNELS; ++o)
-         {
-            buf.push_back(s);
-         }
-      });
+      printf("There is no write loop for %s\n", snd_pcm_format_name(output.negotiated().format));
+      exit(EXIT_FAILURE);
    }
+   printf("Write loop: %s\n", renderer.isSpecialized() ? "specialized at compile time" : "generic");
 
-   return buf;
-}
-
-std::vector<uint16_t> convToBigEndian(std::vector<uint16_t>& buff)
-{
-   std::for_each(buff.begin(), buff.end(), [](uint16_t& i) { i = htons(i); });
-
-   return buff;
-}
-
-template <size_t size>
-std::vector<uint16_t> prepWriteBuffer(int16_t (&sigBuff)[size])
-{
-   std::vector<uint16_t> buff {};
+   const uint32_t sineSize = static_cast<uint32_t>(monoSine1kHzLoopUp.size());
+   uint32_t sinePos = 0u;
 
-   buff = fillBuffer(sigBuff, buff);
+   // the looped processing frame of the writei path lives in a preallocated pool - no heap use after start-up
+   audio::FramePool framePool(1, params::PROC_FRAME_SIZE, output.frameBytes());
+   auto tempWriteBuff = framePool.acquire();
 
-   if(runningOnLittleEndianHost)
+   if (!output.usesMmap())
    {
-      buff = convToBigEndian(buff);
-   }
-
-   return buff;
-}
-
-int main(void)
-{
-    int err;
-    unsigned int i;
-    snd_pcm_t *handle;
-    snd_pcm_sframes_t frames;
-
-    // For enviorments with very little memory - this sample sine array could contain only 1/4 - 12 samples.
-   int16_t monoSine1kHzLoopUp[48]  { 0, 3027, 6003, 8877, 11598, 14121, 16402, 18403, 20089, 21431, 22406, 22998, 23197, 22998,
-                                     22406, 21431, 20089, 18403, 16402, 14121, 11598, 8877, 6003, 3027, 0, -3027, -6003, -8877,
-                                     -11598, -14121, -16402, -18403, -20089, -21431, -22406, -22998, -23197, -22998, -22406,
-                                     -21431, -20089, -18403, -16402, -14121, -11598, -8877, -6003, -3027};
+      // already in the device byte order, no swap pass follows
+      renderer.render(monoSine1kHzLoopUp.data(), sineSize, sinePos, tempWriteBuff.data(), params::PROC_FRAME_SIZE);
 
-   std::vector<uint16_t> tempWriteBuff {};
+      std::cout << "tempWriteBuff = " << framePool.bufferBytes() << " bytes" << std::endl;
+   }
 
-   //listdev("pcm");
 
-   const auto endianStr = runningOnLittleEndianHost() ? "little endian" : "big endian";
+   audio::RtSettings rtSettings {};
+   rtSettings.priority = params::RT_PRIORITY;
+   rtSettings.cpu = params::RT_CPU;
+   rtSettings.lockMemory = true;
 
-   std::cout << "CPU is using: " << endianStr << std::endl;
+   // In the case if sample rate is not a multitude of the frame - the following loop will deliver slightly less
+   // audio-data than one second - imperfaction left on purpose so to keep it simple and reduce the human cognitive load of the reader
+   const uint32_t framesPerSecond = params::SAMPLE_RATE / params::PROC_FRAME_SIZE;
+   uint32_t passedSeconds = 0u;
+   uint32_t framesInSecond = 0u;
+   uint64_t queuedFrames = 0u;
 
-    if ((err = snd_pcm_open(&handle, params::AUD_DEVICE, SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
-        printf("Playback open error: %s\n", snd_strerror(err));
-        exit(EXIT_FAILURE);
-    }
+   // a single call of the loop body delivers one processing frame, so that it can be paced by the device
+   audio::RenderThread renderThread;
+   renderThread.start(rtSettings, [&]() -> bool
+   {
+      if (output.usesMmap())
+      {
+         // the samples are written straight into the DMA area handed out by ALSA, in two parts when it wraps;
+         // beginWrite / commitWrite instead of render() as the renderer already produces the device byte order
+         frames = 0;
+         while ((frames >= 0) && (frames < static_cast<snd_pcm_sframes_t>(params::PROC_FRAME_SIZE)))
+         {
+            void* area = nullptr;
+            auto count = output.beginWrite(area, params::PROC_FRAME_SIZE - frames);
+            if (count >= 0)
+            {
+               renderer.render(monoSine1kHzLoopUp.data(), sineSize, sinePos, area, count);
+               count = output.commitWrite(count);
+            }
+            frames = (count < 0) ? count : frames + count;
+         }
+      }
+      else
+      {
+         frames = output.write(tempWriteBuff.data(), params::PROC_FRAME_SIZE);
+      }
 
-    if ((err = snd_pcm_set_params(handle,
-                      SND_PCM_FORMAT_S16_BE,
-                      SND_PCM_ACCESS_RW_INTERLEAVED,
-                      params::AUD_CHANNELS,
-                      params::SAMPLE_RATE,
-                      1,
-                      5000000)) < 0) {   /* 0.5sec */
-        printf("Playback open error: %s\n", snd_strerror(err));
-        exit(EXIT_FAILURE);
-    }
+      if (frames < 0)
+      {
+         return false;
+      }
 
-   tempWriteBuff = prepWriteBuffer(monoSine1kHzLoopUp);
+      // the device starts playing once the start threshold is queued
+      const bool started = queuedFrames >= output.negotiated().startThreshold;
+      queuedFrames += frames;
+      if (!started && (queuedFrames >= output.negotiated().startThreshold) && !output.isOffline())
+      {
+         const uint64_t now = audio::monotonicMicros();
+         printf("Time to the first sample: %.1f ms (device open %.1f ms)\n",
+                (now - startMicros) / 1000.0, (openMicros - startMicros) / 1000.0);
+      }
 
-   std::cout << "tempWriteBuff = " << tempWriteBuff.size() << std::endl;
+      if (++framesInSecond == framesPerSecond)
+      {
+         framesInSecond = 0u;
+         printf("Passed audio-write iterations: %u.\n", ++passedSeconds);
+      }
 
+      // the next frame is produced as soon as the device has room for it - a realistic live-streaming scenario
+      return (passedSeconds < params::PLAYBACK_TIME_SEC) && (output.waitForPeriod() >= 0);
+   });
 
-   for (uint32_t i = 0u; i < params::PLAYBACK_TIME_SEC; ++i)
+   // the stats are lock-free - this thread reports them while the render thread keeps writing
+   while (renderThread.running() && !output.isOffline())
    {
-      // In the case if sample rate is not a multitude of the frame - the following loop will deliver slightly less
-      // audio-data than one second - imperfaction left on purpose so to keep it simple and reduce the human cognitive load of the reader
-      for (uint32_t j = 0u; j < (params::SAMPLE_RATE / params::PROC_FRAME_SIZE); ++j)
-      {
-         frames = snd_pcm_writei(handle, tempWriteBuff.data(), params::PROC_FRAME_SIZE);
-
-         if (frames < 0)
-            frames = snd_pcm_recover(handle, frames, 0);
-         if (frames < 0) {
-            printf("snd_pcm_writei failed: %s\n", snd_strerror(frames));
-            break;
-         }
-         if ((frames > 0) && (frames < params::PROC_FRAME_SIZE))
-         {
-            printf("Short write (expected %li, wrote %li)\n", (long)params::PROC_FRAME_SIZE, frames);
-         }
+      std::this_thread::sleep_for(std::chrono::seconds(params::STATS_REPORT_PERIOD_SEC));
+      audio::printStats(output.stats());
+   }
+   renderThread.join();
 
-         // adding a thread sleep to make it a more realistic live-streaming scenario
-         std::this_thread::sleep_for (std::chrono::milliseconds(params::PROC_FRAME_DURATION_MS));
-      }
-      printf("Passed audio-write iterations: %d.\n", i+1);
+   if (jsonReport)
+   {
+      audio::printStats(output.stats(), audio::StatsReport::Json);
    }
 
-    err = snd_pcm_drain(handle);
-    if (err < 0)
-        printf("snd_pcm_drain failed: %s\n", snd_strerror(err));
-    snd_pcm_close(handle);
+    output.drain();
 
     return 0;
 }